@@ -75,8 +75,12 @@ def generate_csv_content(input_data, start_val, end_val, repeat_type):
 
     # --- Repetition Logic ---
 
-    def create_new_row_string(original_row, val):
-        """Helper function to substitute the number in Col 1, 2, 4 and format the row back to CSV string."""
+    # The SCIDX rows are a single multi-output block: the function of the first target row (e.g.,
+    # P_bfm_expand) goes on the first generated row, and "^" on every row after it
+    block_fn = target_rows[0][2] if target_rows else ""
+
+    def create_new_row_string(original_row, val, is_first):
+        """Helper function to substitute the number in Col 1, 2, 4, set the function in Col 3, and format the row back to CSV string."""
         new_row = list(original_row)
         
         # 1. Process the FIRST column (index 0)
@@ -103,6 +107,9 @@ def generate_csv_content(input_data, start_val, end_val, repeat_type):
             new_row[3] = f"{val}{match_col4.group(2)}"
         else:
             print(f"Warning: Value in the fourth column '{new_row[3]}' does not match the expected pattern for substitution.", file=sys.stderr)
+
+        # 4. Process the THIRD column (index 2): the block function, or "^" to continue the block
+        new_row[2] = block_fn if is_first else "^"
         
         # Convert the new row back to CSV format: '"value1","value2",...'
         return ",".join(f'"{item}"' for item in new_row)
@@ -113,6 +120,7 @@ def generate_csv_content(input_data, start_val, end_val, repeat_type):
         
         # We need to preserve the interleave order of non-target lines in the original file.
         current_target_index = 0
+        generated_rows = 0
         
         for original_line in lines:
             if original_line.startswith('"SCIDX: '): 
@@ -122,7 +130,8 @@ def generate_csv_content(input_data, start_val, end_val, repeat_type):
                     
                     # Iterate through the range for this specific row
                     for val in range(start_val, end_val + 1):
-                        output_lines.append(create_new_row_string(original_row, val))
+                        output_lines.append(create_new_row_string(original_row, val, generated_rows == 0))
+                        generated_rows += 1
                         
                     current_target_index += 1
                 # If the line started with "SCIDX: " but wasn't a valid target row, 
@@ -140,7 +149,7 @@ def generate_csv_content(input_data, start_val, end_val, repeat_type):
         # Generate the main block
         for val in range(start_val, end_val + 1):
             for original_row in target_rows:
-                generated_content.append(create_new_row_string(original_row, val))
+                generated_content.append(create_new_row_string(original_row, val, not generated_content))
         
         # Simple Type 1 Logic: All non-target lines + Generated block
         # Find the insertion point for the generated content (i.e., the first target line's position)
@@ -0,0 +1,88 @@
+#ifndef _BPF_H
+#define _BPF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fpnt {
+
+  /** @brief A classic BPF instruction. The opcodes follow <linux/filter.h>; the jump offsets are
+   * wider than 8 bits since programs are only run by BpfProgram, not loaded into the kernel.
+   */
+  struct BpfInsn {
+    uint16_t code = 0;
+    uint32_t jt = 0;
+    uint32_t jf = 0;
+    uint32_t k = 0;
+  };
+
+  /** @brief A validated classic BPF program with a small interpreter, so that no libpcap runtime
+   * is needed to filter capture records. Out-of-bounds loads reject the packet as in libpcap.
+   */
+  class BpfProgram {
+  private:
+    std::vector<BpfInsn> insns;
+
+  public:
+    // false (and the program is cleared) if an instruction is unknown, a jump leaves the program,
+    // the last instruction is not a return or a constant division by zero is found
+    bool assign(std::vector<BpfInsn> program);
+
+    bool empty() const { return insns.empty(); }
+    size_t size() const { return insns.size(); }
+    const std::vector<BpfInsn>& getInsns() const { return insns; }
+
+    // non-zero if the packet is accepted; wirelen is the original length of the packet
+    uint32_t run(const uint8_t* pkt, uint32_t wirelen, uint32_t caplen) const;
+    bool match(const uint8_t* pkt, uint32_t wirelen, uint32_t caplen) const {
+      return run(pkt, wirelen, caplen) != 0;
+    }
+  };
+
+  /** @brief Compile a capture filter into a BPF program for the given link-layer header type.
+   * A subset of the pcap-filter syntax is supported: and/&&, or/||, not/! and parentheses over
+   *   ip, ip6, arp, tcp, udp, icmp, icmp6, ip proto N, ip6 proto N,
+   *   [src|dst] host ADDR (IPv4 or IPv6), [src|dst] net A.B.C.D/LEN,
+   *   [tcp|udp] [src|dst] port N, ether [src|dst|host] MAC, ether proto N,
+   *   len OP N, greater N, less N,
+   *   type T [subtype S], subtype S, wlan (addr1|addr2|addr3|ra|ta) MAC (802.11 only),
+   *   PROTO[OFF] or PROTO[OFF:1|2|4], optionally "& MASK", compared by =, !=, <, <=, > or >= with
+   *   a constant (PROTO is ether, link, wlan, ip, ip6, tcp, udp or icmp).
+   * Like libpcap, VLAN tags and IPv6 extension headers are not skipped. A filter may also be given
+   * as BPF byte code in the `tcpdump -ddd` format, with newlines or commas between instructions.
+   * It returns false with an error message if the filter cannot be compiled.
+   */
+  bool compileBpf(const std::string& filter, uint32_t linktype, BpfProgram& program,
+                  std::string& error);
+
+  /** @brief CapturePrefilter applies config["capture_prefilter"] to the raw records of a capture
+   * file before any decoding, and writes the accepted records to a new capture file which is
+   * decoded instead of the original one. Since tshark only sees the accepted records,
+   * frame.number has to be mapped back with the frame numbers collected by apply().
+   */
+  class CapturePrefilter {
+  private:
+    std::string filter;
+    std::unordered_map<uint32_t, BpfProgram> programs;  // compiled lazily for each linktype
+
+    const BpfProgram& getProgram(uint32_t linktype);
+
+  public:
+    CapturePrefilter(const nlohmann::json& config);
+
+    bool enabled() const { return !filter.empty(); }
+
+    // frame_numbers[i] is the original frame.number of the (i + 1)-th record of out_filepath;
+    // non-packet blocks of a pcapng file are copied as they are
+    void apply(const std::filesystem::path& in_filepath, const std::filesystem::path& out_filepath,
+               std::vector<uint64_t>& frame_numbers);
+  };
+
+}  // namespace fpnt
+
+#endif
@@ -2,17 +2,25 @@
 #define _DISPATCHER_H
 
 #include <fmt/core.h>
+#include <fpnt/bpf.h>
 #include <fpnt/config.h>
+#include <fpnt/hierarchy.h>
 #include <fpnt/loader.h>
 #include <fpnt/mapper.h>
+#include <fpnt/pkt_cache.h>
+#include <fpnt/pkt_table.h>
+#include <fpnt/plan.h>
 #include <fpnt/reader.h>
+#include <fpnt/record_table.h>
 
 #include <cstring>
 #include <csv.hpp>
 #include <filesystem>
+#include <functional>
 // #include <fstream>
 #include <nlohmann/json.hpp>
 #include <set>
+#include <span>
 #include <unordered_map>
 
 namespace fpnt {
@@ -20,6 +28,7 @@ namespace fpnt {
   std::set<std::filesystem::path> get_sorted_pcap_paths(std::string path);
   void chkOutFilepath(const std::filesystem::path& out_filepath);
   std::set<std::string> default_extensions();
+  std::filesystem::path output_relative_path(const std::filesystem::path& rel_path);
 
   // The custom comparator structure for std::set.
   // It determines the sorting order based on its internal state.
@@ -66,6 +75,12 @@ namespace fpnt {
 
   void print_set_details(const SortedPathSet& sorted, const std::string& title);
 
+  // the per-thread counterpart of Dispatcher::idxs and Dispatcher::tmp while records are processed
+  struct ProcessContext {
+    std::vector<size_t> idxs;
+    nlohmann::json tmp;
+  };
+
   class Dispatcher {
   private:
     const nlohmann::json config;
@@ -86,8 +101,14 @@ namespace fpnt {
     // CSVReader reader_outfmt_flowset;
     std::vector<CSVReader> out_readers;
     Loader loader;
+    ExecutionPlan plan;  // compiled from out_maps once in the constructor
 
     std::filesystem::path cur_abs_path;
+    bool streaming = false;  // input_pcap_path is stdin ("-") or a named pipe
+    size_t process_threads = 1;  // threads of process() for granularities with thread-safe steps
+
+    void processRange(const GranularityPlan& g_plan, std::string& granularity, size_t ptr_g,
+                      size_t first, size_t last, ProcessContext& ctx, bool update_idxs);
 
     // std::pair<size_t, size_t> Dispatcher::chk_get_valid(std::string& from, std::string& to);
 
@@ -110,31 +131,36 @@ namespace fpnt {
     // Mapper map_flowset;
     std::unordered_map<std::string, Mapper> out_maps;  // Mapper will be copied from readers...
 
-    std::vector<nlohmann::json> in_pkts;
+    PacketTable in_pkts;  // column idx == field idx of in_map
     // std::vector<nlohmann::json> out_pkts;
     // std::vector<nlohmann::json> out_flows;
     // std::vector<nlohmann::json> out_flowsets;
-    std::unordered_map<std::string, std::unordered_map<std::string, nlohmann::json>>
-        out;  // v0.3 out record는 key로만 접근함
+    // the records of each granularity by ID (or by key) with their keys (see RecordTable); a
+    // record has __<g>_idx, the IDs of its own record and its parent records of each granularity g
+    std::unordered_map<std::string, RecordTable> out;
+    Hierarchy hierarchy;  // the parents and descendants of the records by level and ID
 
     // std::set<std::string> keys_pkt;
     // std::set<std::string> keys_flow;
     // std::set<std::string> keys_flowset;
-    std::unordered_map<std::string, std::set<std::string>> out_keys;                       // v0.3
-    std::unordered_map<std::string, std::vector<std::string>> out_idx2key;                 // v0.3
-    std::unordered_map<std::string, std::unordered_map<std::string, size_t>> out_key2idx;  // v0.3
-    std::unordered_map<std::string, std::unordered_map<std::string, std::vector<std::string>>>
-        out_child_keys;  // v0.3
 
     // std::map<std::string, size_t> flow_idx_from_flow; // get_idx(key, "flow")
     // std::map<std::string, std::vector<size_t>> pkt_idxs_from_flow; // get_idxs(key, "flow",
     // "pkt") std::map<std::string, std::vector<size_t>> pkt_idxs_from_flowset; // get_idxs(key,
     // "flowset", "pkt") std::map<std::string, std::vector<std::string>> flow_keys_from_flowset; //
     // get_keys(key, "flowset", "flow")
-    size_t get_idx(std::string key, std::string from, std::string to = "eq");              // v0.3
-    std::string get_key(std::string key, std::string from, std::string to = "eq");         // v0.3
-    std::vector<size_t> get_idxs(std::string key, std::string from, std::string to);       // v0.3
-    std::vector<std::string> get_keys(std::string key, std::string from, std::string to);  // v0.3
+    // the lookups below only read the dispatcher, so thread-safe P_* functions may call them
+    size_t get_lv(const std::string& granularity) const;  // the level; exits if unknown
+    const RecordTable& get_records(const std::string& granularity) const;  // out, read-only
+    size_t get_idx(std::string key, std::string from, std::string to = "eq") const;       // v0.3
+    std::string get_key(std::string key, std::string from, std::string to = "eq") const;  // v0.3
+    std::vector<size_t> get_idxs(std::string key, std::string from,
+                                 std::string to) const;  // v0.3
+    // the IDs of get_idxs without a copy; valid until the records of the next file are created
+    std::span<const uint32_t> get_idx_span(const std::string& key, const std::string& from,
+                                           const std::string& to) const;
+    std::vector<std::string> get_keys(std::string key, std::string from,
+                                      std::string to) const;  // v0.3
 
     nlohmann::json tmp;
 
@@ -156,10 +182,17 @@ namespace fpnt {
                std::set<std::string> extensions = default_extensions());
 
     void dispatch();
+    // cut the input stream into segment files and pass each of them to run(path, remove_after)
+    void dispatch_stream(const std::function<void(const std::filesystem::path&, bool)>& run);
 
     void process_main(const std::filesystem::path abs_path);
     void process_base();
-    void process(std::string granularity);
+    // concurrent: the granularity runs along with the other granularities of its wave (see
+    // ExecutionPlan), so that idxs of the dispatcher is left untouched
+    void process(std::string granularity, bool concurrent = false);
+    // the context of the calling thread; in the thread-pool mode of process(), idxs and tmp of the
+    // dispatcher are not updated and thread-safe P_* functions must use context() instead
+    static ProcessContext& context();
     // void process_pkt();
     // void process_flow();
     // void process_flowset();
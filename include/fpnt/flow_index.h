@@ -0,0 +1,57 @@
+#ifndef _FLOW_INDEX_H
+#define _FLOW_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace fpnt {
+
+  /** @brief FlowTuple is the canonical (ordered) flow key of a packet in a fixed-width binary form,
+   * filled by a tuple key generator (genKey_x_tuple, see fpnt/loader.h): the addresses (IPv4 uses
+   * the first 4 bytes), the ports and the protocol of the first and the second endpoint of the
+   * key, i.e., 37 bytes of data. Tuples are hashed and compared as bytes, so the unused bytes must
+   * be zero; Dispatcher::process_base clears the tuple before calling the key generator.
+   */
+  struct FlowTuple {
+    static constexpr uint8_t IPV6 = 1;   // flags: the addresses are IPv6 addresses
+    static constexpr uint8_t PROTO = 2;  // flags: proto is a part of the key
+
+    uint8_t addr[2][16];
+    uint16_t port[2];
+    uint8_t proto;
+    uint8_t flags;
+    uint8_t padding[2];
+
+    void clear() { memset(this, 0, sizeof(*this)); }
+    bool operator==(const FlowTuple& other) const {
+      return memcmp(this, &other, sizeof(*this)) == 0;
+    }
+  };
+  static_assert(sizeof(FlowTuple) == 40, "FlowTuple must not have implicit padding");
+
+  /** @brief FlowIndex maps the flow tuples of a granularity to the indices of their records in an
+   * open-addressing hash table (linear probing, at most half full), so that
+   * Dispatcher::process_base finds the record of a packet without formatting its key string; the
+   * key string is formatted by the key generator only for the first packet of a flow.
+   */
+  class FlowIndex {
+  private:
+    std::vector<FlowTuple> tuples;  // by slot
+    std::vector<uint32_t> values;   // the record index + 1 by slot; 0 if the slot is empty
+    size_t no_entries = 0;
+
+    static uint64_t hash(const FlowTuple& tuple);
+    void grow();
+
+  public:
+    size_t find(const FlowTuple& tuple) const;        // (size_t)-1 if absent
+    void insert(const FlowTuple& tuple, size_t idx);  // the tuple must be absent
+    size_t size() const { return no_entries; }
+    void clear();
+  };
+
+}  // namespace fpnt
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef _GLOSSARY_H
+#define _GLOSSARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace fpnt {
+
+  // the description, type and version range columns of a display filter reference row
+  struct GlossaryEntry {
+    std::string desc;
+    std::string type;
+    std::string ver;
+  };
+
+  // extract the three columns from a dfref row starting at id="<field>" (without </tr>)
+  void parseDfrefRow(const std::string& row, GlossaryEntry& entry);
+
+  /** @brief FieldGlossary is a prebuilt index of display filter fields stored in a single
+   * memory-mapped file: the entries are sorted by field name and looked up by binary search, so
+   * that TSharkCSVReader reads one file instead of scanning the dfref HTML files on every start.
+   * The index is generated from the crawled dfref tree (collectDfref) or from
+   * `tshark -G fields` (collectTshark). Its key (the source and the tshark version) is stored in
+   * the file, and open() fails for a different key so that the index is generated again.
+   */
+  class FieldGlossary {
+  private:
+    struct Entry {  // offsets and lengths into the string pool
+      uint32_t name_off, name_len;
+      uint32_t desc_off, desc_len;
+      uint32_t type_off, type_len;
+      uint32_t ver_off, ver_len;
+    };
+
+    int fd = -1;
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+    const Entry* entries = nullptr;
+    size_t no_entries = 0;
+    const char* pool = nullptr;
+    size_t pool_size = 0;
+
+    bool view(uint32_t off, uint32_t len, std::string_view& out) const;
+    void close();
+
+  public:
+    FieldGlossary() = default;
+    FieldGlossary(const FieldGlossary&) = delete;
+    FieldGlossary& operator=(const FieldGlossary&) = delete;
+    ~FieldGlossary() { close(); }
+
+    // false if the index does not exist, is broken or has a different key
+    bool open(const std::filesystem::path& path, const std::string& key);
+    bool is_open() const { return base != nullptr; }
+    size_t size() const { return no_entries; }
+    bool find(const std::string& field, GlossaryEntry& entry) const;
+
+    // write the index atomically (a temporary file is renamed)
+    static bool write(const std::filesystem::path& path, const std::string& key,
+                      const std::map<std::string, GlossaryEntry>& fields);
+
+    static bool collectDfref(const std::filesystem::path& dfref_path,
+                             std::map<std::string, GlossaryEntry>& fields);
+    // tshark -G fields has no version range; "<version> to <version>" is used instead
+    static bool collectTshark(const std::string& tshark_path, const std::string& version,
+                              std::map<std::string, GlossaryEntry>& fields);
+  };
+
+}  // namespace fpnt
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef _HIERARCHY_H
+#define _HIERARCHY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace fpnt {
+
+  /** @brief Hierarchy is the parent/child adjacency of the records of the granularity levels
+   * (Dispatcher::g_lvs) by record ID (see RecordTable). Dispatcher::process_base adds the parent of
+   * each new record, and build() derives for every pair of levels the ancestor of each record (an
+   * array by ID) and the descendants of each record in compressed sparse row (CSR) form: the
+   * descendants of a record at a lower level are a contiguous span of one ID array, ordered by
+   * their parents and, for the same parent, by ID (i.e., in the order of the first packets).
+   * Therefore, Dispatcher::get_idx is an array lookup, and the descendants of a record are read
+   * without a recursion or an allocation.
+   */
+  class Hierarchy {
+  private:
+    struct Csr {
+      std::vector<uint32_t> offsets;  // by the ID of the upper level, and the end
+      std::vector<uint32_t> ids;      // the IDs of the lower level
+    };
+
+    size_t no_levels = 0;
+    std::vector<size_t> no_records;                // by level
+    std::vector<std::vector<uint32_t>> parents;    // by level; the parent IDs (level + 1) by ID
+    std::vector<std::vector<uint32_t>> ancestors;  // by from * no_levels + to (from < to)
+    std::vector<Csr> csrs;                         // by from * no_levels + to (from > to)
+
+  public:
+    void reset(size_t no_levels);  // no records
+    // a new record of the level, added in the order of IDs; parent_id is ignored at the top level
+    void addRecord(size_t level, uint32_t parent_id) {
+      if (level + 1 < no_levels) parents[level].push_back(parent_id);
+      no_records[level]++;
+    }
+    void build();  // after every record is added
+
+    // the ID of the ancestor at level to (>= from) of the record of level from
+    size_t ancestor(size_t from, size_t to, size_t id) const {
+      return from == to ? id : ancestors[from * no_levels + to][id];
+    }
+    // the IDs of the descendants at level to (< from) of the record of level from
+    std::span<const uint32_t> descendants(size_t from, size_t to, size_t id) const {
+      const Csr& csr = csrs[from * no_levels + to];
+      return std::span<const uint32_t>(csr.ids.data() + csr.offsets[id],
+                                       csr.offsets[id + 1] - csr.offsets[id]);
+    }
+  };
+
+}  // namespace fpnt
+
+#endif
@@ -2,17 +2,57 @@
 #define _LOADER_H
 
 #include <dlfcn.h>
+#include <fpnt/flow_index.h>
 #include <fpnt/mapper.h>
+#include <fpnt/pkt_table.h>
 
 #include <iostream>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace fpnt {
   typedef void (*fnptr_PrepFn)(const std::string&, nlohmann::json&, std::string&,
                                const std::string&, const std::string&);
-  typedef const std::string (*fnptr_genKeyFn)(const nlohmann::json&, std::string&, std::string&);
+  typedef const std::string (*fnptr_genKeyFn)(const PktRef&, std::string&, std::string&);
+  // a key generator with direction: genKey_x_dir(pkt, granularity, key, dir) returns the key of
+  // genKey_x and sets dir to 1 (the source of the packet is the first endpoint of the key), -1
+  // (the second one) or 0 (unknown)
+  typedef const std::string (*fnptr_genKeyDirFn)(const PktRef&, std::string&, std::string&, int&);
+  // a tuple key generator: genKey_x_tuple(pkt, granularity, tuple, dir) fills the binary key of
+  // genKey_x (see FlowTuple) and the direction as genKey_x_dir does; false if the packet has no
+  // tuple (e.g., a non-IP packet), whose key is then generated by genKey_x (or genKey_x_dir)
+  typedef bool (*fnptr_genKeyTupleFn)(const PktRef&, std::string&, FlowTuple&, int&);
+
+  // ABI v2: if P_x_init is exported, the option is parsed once into a state by P_x_init, P_x
+  // receives the state instead of the option, and P_x_destroy (optional) releases the state
+  typedef void* (*fnptr_PrepInitFn)(const std::string&);
+  typedef void (*fnptr_PrepStateFn)(void*, nlohmann::json&, std::string&, const std::string&,
+                                    const std::string&);
+  typedef void (*fnptr_PrepDestroyFn)(void*);
+
+  // batch interface: if P_x_batch is exported, it is called once for count consecutive records of
+  // a granularity (records[i] is the record of ID first_idx + i, see RecordTable) instead of
+  // calling P_x for each record; state is nullptr unless P_x_init is exported
+  typedef void (*fnptr_PrepBatchFn)(void*, const std::string&, std::string&, size_t, size_t,
+                                    nlohmann::json* const*, const std::string&);
+
+  // field references: P_x_refs(option, granularity, refs) appends the (granularity, field) pairs
+  // that P_x reads with the option when it computes a field of the granularity; a function
+  // without P_x_refs may read (or write) any field (see ExecutionPlan)
+  typedef void (*fnptr_PrepRefsFn)(const std::string&, const std::string&,
+                                   std::vector<std::pair<std::string, std::string>>&);
+
+  // multi-output: a block of columns, i.e., a column with P_x followed by columns whose
+  // preprocess_fns is "^", is computed by a single call P_x_multi(state, options, record,
+  // granularity, key, fields) which writes every field of the block; options[i] is the option of
+  // fields[i]. The state is returned by P_x_multi_init(options) (nullptr if not exported) and
+  // released by P_x_multi_destroy (optional)
+  typedef void* (*fnptr_PrepMultiInitFn)(const std::vector<std::string>&);
+  typedef void (*fnptr_PrepMultiFn)(void*, const std::vector<std::string>&, nlohmann::json&,
+                                    std::string&, const std::string&,
+                                    const std::vector<std::string>&);
 
   class Loader {
   private:
@@ -21,6 +61,8 @@ namespace fpnt {
     std::map<std::string, fnptr_PrepFn> map_fns;
     std::map<std::string, fnptr_genKeyFn> map_genkeyfns;
 
+    void* getSymbol(const std::string& str_sym);
+
   public:
     Loader(std::string path);
 
@@ -29,10 +71,24 @@ namespace fpnt {
     void* getDispatcherPtr();
 
     fnptr_PrepFn getPrepFn(std::string& str_fn);
+    bool isStatefulPrepFn(const std::string& str_fn);  // P_<str_fn>_init is exported
+    fnptr_PrepInitFn getPrepInitFn(const std::string& str_fn);
+    fnptr_PrepStateFn getPrepStateFn(const std::string& str_fn);
+    fnptr_PrepDestroyFn getPrepDestroyFn(const std::string& str_fn);  // nullptr if not exported
+    fnptr_PrepBatchFn getPrepBatchFn(const std::string& str_fn);      // nullptr if not exported
+    fnptr_PrepRefsFn getPrepRefsFn(const std::string& str_fn);        // nullptr if not exported
+    // P_<str_fn>_multi, P_<str_fn>_multi_init and P_<str_fn>_multi_destroy; nullptr if not exported
+    fnptr_PrepMultiFn getPrepMultiFn(const std::string& str_fn);
+    fnptr_PrepMultiInitFn getPrepMultiInitFn(const std::string& str_fn);
+    fnptr_PrepDestroyFn getPrepMultiDestroyFn(const std::string& str_fn);
+    // P_<str_fn>_threadsafe is exported (see FPNT_THREADSAFE in plugins/dispatcher_ptr.h)
+    bool isThreadSafePrepFn(const std::string& str_fn);
 
     bool validate(const std::string& str_fn);
 
     fnptr_genKeyFn getGenKeyFn(const std::string& str_fn);
+    fnptr_genKeyDirFn getGenKeyDirFn(const std::string& str_fn);  // nullptr if not exported
+    fnptr_genKeyTupleFn getGenKeyTupleFn(const std::string& str_fn);  // nullptr if not exported
 
     void printFns() {
       for (const auto& x : map_fns) std::cout << x.first << std::endl;
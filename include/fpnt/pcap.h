@@ -0,0 +1,298 @@
+#ifndef _PCAP_H
+#define _PCAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fpnt {
+
+  // link-layer header types that can be decoded natively (https://www.tcpdump.org/linktypes.html)
+  enum LinkType : uint32_t {
+    LINKTYPE_NULL = 0,
+    LINKTYPE_ETHERNET = 1,
+    LINKTYPE_RAW = 101,
+    LINKTYPE_LINUX_SLL = 113,
+    LINKTYPE_IPV4 = 228,
+    LINKTYPE_IPV6 = 229,
+    LINKTYPE_LINUX_SLL2 = 276,
+  };
+
+  bool isNativeLinkType(uint32_t linktype);
+
+  // compressed capture files (.gz, .zst and .xz) are decompressed by an external command which
+  // writes to stdout (pigz or gzip, zstd, xz); genDecompressCmd() returns "" for other files
+  std::string genDecompressCmd(const std::filesystem::path& path);
+  bool isCompressedCapture(const std::filesystem::path& path);
+  // ".pcap.gz" for "a.pcap.gz", ".pcap" for "a.pcap"
+  std::string captureExtension(const std::filesystem::path& path);
+
+  /** @brief A packet record of a pcap/pcapng file. data points into the mapped file, so a record
+   * is valid as long as the PcapFile object is alive; for a compressed file, data points into the
+   * stream buffer and is valid until the next call of PcapFile::next().
+   */
+  struct PcapRecord {
+    const uint8_t* data = nullptr;
+    uint32_t caplen = 0;
+    uint32_t len = 0;
+    int64_t ts_sec = 0;
+    uint32_t ts_nsec = 0;
+    uint32_t linktype = 0;
+    size_t offset = 0;  // offset of the record (including its header) in the file
+    size_t size = 0;    // size of the record (including its header)
+  };
+
+  /** @brief PcapStream parses a pcap/pcapng byte stream (stdin or a named pipe) into units that
+   * can be copied into segment files. Each segment file starts with header(): the pcap file
+   * header, or the latest pcapng section header with the interface description and decryption
+   * secrets blocks seen so far, so that every segment is a valid capture file by itself.
+   */
+  class PcapStream {
+  public:
+    enum Unit {
+      UNIT_NONE,    // more data is needed (see fill()), or the stream is malformed (see failed())
+      UNIT_HEADER,  // a part of header(); it is copied only into an already open segment
+      UNIT_PACKET,  // a packet record
+      UNIT_BLOCK,   // any other pcapng block
+    };
+
+  private:
+    int fd = -1;
+    bool owns_fd = true;
+    bool eof = false;
+    bool malformed = false;
+    std::vector<uint8_t> buf;
+    size_t head = 0;  // buf[head, buf.size()) is not parsed yet
+
+    bool pcapng = false;
+    bool swapped = false;
+    bool started = false;  // the file header (or the first section header) has been read
+    std::string segment_header;
+
+    uint32_t rd32(const uint8_t* p) const;
+
+  public:
+    PcapStream() = delete;
+    PcapStream(const std::string& path);  // "-" for stdin
+    PcapStream(int fd);                   // an open descriptor (e.g., a pipe), which is not closed
+    PcapStream(const PcapStream&) = delete;
+    PcapStream& operator=(const PcapStream&) = delete;
+    ~PcapStream();
+
+    bool is_open() const { return fd >= 0; }
+    bool is_pcapng() const { return pcapng; }
+    bool at_end() const { return eof; }
+    bool failed() const { return malformed; }
+    const std::string& header() const { return segment_header; }
+
+    // wait up to timeout_ms (-1: without a limit) for more bytes; false at the end of the stream
+    bool fill(int timeout_ms);
+    // bytes refers to the internal buffer and is valid until the next fill()
+    Unit next(std::string_view& bytes);
+  };
+
+  /** @brief A read-only memory-mapped pcap/pcapng file with a sequential record cursor.
+   * Both byte orders, microsecond/nanosecond pcap and pcapng EPB/SPB/PB blocks (with if_tsresol
+   * and if_tsoffset) are supported. A compressed file (see genDecompressCmd()) cannot be mapped;
+   * the output of its decompressor is read through a PcapStream instead, so only the current
+   * record is kept in memory. Then data() is nullptr, and rewind() restarts the decompressor.
+   */
+  class PcapFile {
+  private:
+    struct Interface {
+      uint32_t linktype;
+      uint32_t snaplen;
+      bool tsresol_pow10;  // true: 10^-tsresol, false: 2^-tsresol
+      uint8_t tsresol;
+      int64_t tsoffset;
+    };
+
+    int fd = -1;
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+    size_t pos = 0;
+    size_t first_record = 0;
+    size_t sections = 0;  // number of pcapng section header blocks visited
+
+    bool pcapng = false;
+    bool swapped = false;
+    bool pcap_nsec = false;
+    std::vector<Interface> interfaces;  // for pcap, interfaces[0] describes the file header
+
+    // the bytes between the previous record and the current one (see skipped())
+    std::string_view gap;
+    size_t record_end = 0;  // the end of the previous record of a mapped file
+
+    // a compressed file
+    std::string decompress_cmd;
+    FILE* pipe = nullptr;  // the output of decompress_cmd
+    std::unique_ptr<PcapStream> stream;
+    size_t stream_pos = 0;  // offset of the next unit of the stream in the file
+    // a unit read ahead by openStream() (the first packet record), if not UNIT_NONE
+    PcapStream::Unit pending_unit = PcapStream::UNIT_NONE;
+    std::string_view pending;
+    std::string_view last_record;  // the bytes of the record returned by next()
+    std::string skipped_units;     // the bytes of the units skipped before it
+    bool skipped_reset = false;    // skipped_units is cleared by the next call of next()
+
+    bool openStream();
+    PcapStream::Unit nextUnit(std::string_view& bytes);
+    bool nextStreamed(PcapRecord& rec);
+    void release();
+
+    uint16_t rd16(const uint8_t* p) const;
+    uint32_t rd32(const uint8_t* p) const;
+    bool parseFileHeader(const uint8_t* data, size_t size);
+    bool parseSHB(const uint8_t* blk, size_t avail);
+    bool parseIDB(const uint8_t* body, size_t body_len);
+    void setTimestamp(PcapRecord& rec, uint32_t iface, uint64_t ts) const;
+    // parse the units of data from pos up to the next packet record
+    bool nextRecord(const uint8_t* data, size_t size, size_t& pos, PcapRecord& rec);
+
+  public:
+    PcapFile() = delete;
+    PcapFile(const std::filesystem::path& path);
+    PcapFile(const PcapFile&) = delete;
+    PcapFile& operator=(const PcapFile&) = delete;
+    ~PcapFile();
+
+    bool is_open() const { return base != nullptr || stream != nullptr; }
+    bool is_pcapng() const { return pcapng; }
+
+    // linktypes of the interfaces described before the first packet record
+    std::vector<uint32_t> linktypes() const;
+
+    const uint8_t* data() const { return base; }
+    size_t size() const { return length; }
+    size_t header_size() const { return first_record; }  // bytes before the first record
+    size_t no_sections() const { return sections; }
+    size_t no_interfaces() const { return interfaces.size(); }
+
+    bool next(PcapRecord& rec);
+    void rewind();
+
+    // the bytes of the file between the previous record and the one returned by next() (the
+    // file header and the non-packet blocks), or up to the end of the file once next() returned
+    // false; like raw(), they are valid until the next call of next()
+    std::string_view skipped() const { return gap; }
+    // the bytes of rec including its header
+    std::string_view raw(const PcapRecord& rec) const;
+  };
+
+  /** @brief A byte range of a capture file that starts at a record boundary; prepending the
+   * file header (PcapFile::header_size() bytes) makes it a valid capture file.
+   */
+  struct PcapChunk {
+    size_t offset = 0;
+    size_t size = 0;
+    uint64_t first_frame = 1;  // frame.number of the first record of the chunk
+    uint64_t no_records = 0;
+  };
+
+  // split the records of pcap into at most n chunks of similar sizes; it returns false if the
+  // file cannot be split (e.g., a pcapng file with several sections or with interface
+  // description blocks after the first record)
+  bool splitPcapFile(PcapFile& pcap, size_t n, std::vector<PcapChunk>& chunks);
+
+  // protocol layers found by decodePkt(); also used as the native display filter mask
+  enum ProtoLayer : uint32_t {
+    LAYER_ETH = 1u << 0,
+    LAYER_VLAN = 1u << 1,
+    LAYER_IP = 1u << 2,
+    LAYER_IPV6 = 1u << 3,
+    LAYER_TCP = 1u << 4,
+    LAYER_UDP = 1u << 5,
+    LAYER_SLL = 1u << 6,
+    LAYER_FRAME = 1u << 7,  // always set
+  };
+
+  /** @brief Header pointers of a decoded packet; every pointer refers to the mapped record data
+   * and is nullptr if the layer is absent or truncated.
+   */
+  struct DecodedPkt {
+    const PcapRecord* rec = nullptr;
+    uint64_t number = 0;  // frame.number, starting from 1
+
+    // timestamps of the first and the previous record for frame.time_relative and
+    // frame.time_delta
+    int64_t first_sec = 0;
+    uint32_t first_nsec = 0;
+    int64_t prev_sec = 0;
+    uint32_t prev_nsec = 0;
+
+    uint32_t layers = 0;
+    const uint8_t* eth = nullptr;
+    uint16_t eth_type = 0;
+    uint16_t vlan_ids[2] = {0, 0};
+    uint8_t n_vlan = 0;
+    const uint8_t* ip4 = nullptr;
+    const uint8_t* ip6 = nullptr;
+    uint8_t l4_proto = 0;
+    uint32_t l4_len = 0;  // transport length derived from the IP header (not from caplen)
+    const uint8_t* tcp = nullptr;
+    const uint8_t* udp = nullptr;
+  };
+
+  void decodePkt(const PcapRecord& rec, DecodedPkt& pkt);
+
+  // native field catalog: tshark display filter field names that decodePkt() can fill
+  enum NativeField : int {
+    NF_NONE = -1,
+    NF_FRAME_NUMBER,
+    NF_FRAME_TIME_EPOCH,
+    NF_FRAME_TIME_RELATIVE,
+    NF_FRAME_TIME_DELTA,
+    NF_FRAME_LEN,
+    NF_FRAME_CAP_LEN,
+    NF_ETH_SRC,
+    NF_ETH_DST,
+    NF_ETH_TYPE,
+    NF_VLAN_ID,
+    NF_IP_VERSION,
+    NF_IP_HDR_LEN,
+    NF_IP_LEN,
+    NF_IP_ID,
+    NF_IP_TTL,
+    NF_IP_PROTO,
+    NF_IP_SRC,
+    NF_IP_DST,
+    NF_IPV6_PLEN,
+    NF_IPV6_NXT,
+    NF_IPV6_HLIM,
+    NF_IPV6_SRC,
+    NF_IPV6_DST,
+    NF_TCP_SRCPORT,
+    NF_TCP_DSTPORT,
+    NF_TCP_PORT,
+    NF_TCP_SEQ_RAW,
+    NF_TCP_ACK_RAW,
+    NF_TCP_HDR_LEN,
+    NF_TCP_LEN,
+    NF_TCP_WINDOW_SIZE_VALUE,
+    NF_UDP_SRCPORT,
+    NF_UDP_DSTPORT,
+    NF_UDP_PORT,
+    NF_UDP_LENGTH,
+    NF_COL_DEF_SRC,
+    NF_COL_DEF_DST,
+  };
+
+  int getNativeField(const std::string& field);
+  bool isFrameField(int native_field);  // frame.* fields do not depend on the link-layer type
+  void formatNativeField(const DecodedPkt& pkt, int native_field, std::string& out);
+
+  // a display filter is natively supported if it is empty or a disjunction ("||" or "or") of
+  // the protocol names eth, vlan, ip, ipv6, tcp, udp and frame
+  bool parseNativeDisplayFilter(const std::string& filter, uint32_t& layer_mask);
+  inline bool matchNativeDisplayFilter(const DecodedPkt& pkt, uint32_t layer_mask) {
+    return layer_mask == 0 || (pkt.layers & layer_mask) != 0;
+  }
+
+}  // namespace fpnt
+
+#endif
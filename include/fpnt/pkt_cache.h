@@ -0,0 +1,52 @@
+#ifndef _PKT_CACHE_H
+#define _PKT_CACHE_H
+
+#include <fpnt/pkt_table.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+namespace fpnt {
+
+  // a fast non-cryptographic 64-bit hash (for cache keys and capture file contents)
+  uint64_t hash64(const void* data, size_t len, uint64_t seed = 0);
+  bool hashFile(const std::filesystem::path& path, uint64_t& hash);
+
+  /** @brief PacketCache stores the decoded packet table of a capture file under
+   * config["decode_cache_path"], so that later runs with the same decoding options read the
+   * table from the cache instead of executing tshark.
+   * The cache key consists of the capture file identity (its content hash if
+   * config["decode_cache_content_hash"] is true; otherwise its absolute path, size and
+   * modification time), the display filter, the tshark options, the tshark version and the fpnt
+   * decoding options. The input fields are not a part of the key: a cached table keeps every
+   * field decoded so far (with frame.number), and only the missing fields are decoded and joined
+   * to it. The full key is stored in each cache file and verified on load, so that a hash
+   * collision is never served.
+   */
+  class PacketCache {
+  private:
+    std::filesystem::path cache_dir;
+    bool content_hash = false;
+    std::string options;  // decoding options which affect the decoded values
+
+    std::string genFileId(const std::filesystem::path& in_filepath) const;
+
+  public:
+    PacketCache(const nlohmann::json& config, const std::string& tshark_version);
+
+    bool enabled() const { return !cache_dir.empty(); }
+
+    std::string genKey(const std::filesystem::path& in_filepath) const;
+    std::filesystem::path getPath(const std::string& key) const;
+
+    // load() returns false on a cache miss; save() only warns on failure
+    bool load(const std::string& key, PacketTable& in_pkts) const;
+    void save(const std::string& key, const PacketTable& in_pkts) const;
+  };
+
+}  // namespace fpnt
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef _PKT_TABLE_H
+#define _PKT_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace fpnt {
+
+  class PacketTable;
+
+  /** @brief A lightweight view of a single packet (row) of a PacketTable; it is what key
+   * generators (genKey_*) receive instead of a per-packet json object.
+   */
+  class PktRef {
+  private:
+    const PacketTable* table;
+    size_t row;
+
+  public:
+    PktRef(const PacketTable& table, size_t row) : table(&table), row(row) {}
+
+    size_t idx() const { return row; }  // the packet index (formerly pkt["idx"])
+    bool contains(const std::string& field) const;
+    std::string operator[](const std::string& field) const;  // "" if the field is absent
+  };
+
+  /** @brief Column-oriented store for the packets decoded from a single input file.
+   * Each column corresponds to a TSharkMapper field (same index). A column starts as a numeric
+   * column holding int64 values and is demoted to a string column when it meets a value that
+   * does not round-trip as a canonical decimal integer (e.g., "0x0303", "1,2" or "01"). String
+   * cells are 8-byte references into a single contiguous arena, so that no per-packet heap
+   * object is allocated.
+   */
+  class PacketTable {
+  private:
+    struct Column {
+      bool numeric = true;
+      std::vector<uint64_t> cells;  // int64 values (numeric) or packed arena references (string)
+    };
+
+    // string reference: 40-bit arena offset and 24-bit length
+    static constexpr unsigned REF_LEN_BITS = 24;
+    static constexpr uint64_t REF_MAX_LEN = (uint64_t(1) << REF_LEN_BITS) - 1;
+    static constexpr uint64_t REF_MAX_OFFSET = (uint64_t(1) << (64 - REF_LEN_BITS)) - 1;
+    static constexpr int64_t NUM_EMPTY = INT64_MIN;  // "" in a numeric column
+
+    std::vector<std::string> fields;
+    std::unordered_map<std::string, size_t> field_to_col;
+    std::vector<Column> columns;
+    std::vector<char> arena;
+    size_t rows = 0;
+
+    uint64_t store(std::string_view value);
+    std::string_view ref2view(uint64_t ref) const {
+      return std::string_view(arena.data() + (ref >> REF_LEN_BITS), ref & REF_MAX_LEN);
+    }
+    void demote(Column& column);
+
+  public:
+    static bool parseCanonicalInt(std::string_view value, int64_t& num);
+
+    void reset(const std::vector<std::string>& fields);
+    size_t addColumn(const std::string& field);  // returns the index of the (existing) column
+    void removeColumn(const std::string& field);
+    void reorder(const std::vector<std::string>& fields);  // fields must be a permutation
+    void shrink_to_fit();
+
+    size_t size() const { return rows; }
+    bool empty() const { return rows == 0; }
+    size_t col(const std::string& field) const;  // (size_t)-1 if absent
+    const std::vector<std::string>& getFields() const { return fields; }
+    size_t memory() const;  // approximate heap usage in bytes
+
+    size_t addRow();  // appends a row whose cells are all ""
+    void set(size_t row, size_t col, std::string_view value);
+    // move the rows of other (with the same fields) to the end of this table
+    void append(PacketTable& other);
+    // add delta to every non-empty cell of a numeric column; false if the column is not numeric
+    bool offsetColumn(size_t col, int64_t delta);
+    // replace every non-empty cell v of a numeric column by values[v - 1]; false if the column is
+    // not numeric or a cell is out of range
+    bool renumberColumn(size_t col, const std::vector<uint64_t>& values);
+    // move the columns of other which are absent in this table; both tables must have the same
+    // rows in the same order, identified by the numeric key_field column (e.g., frame.number)
+    bool join(PacketTable& other, const std::string& key_field);
+    // keep only the given fields in the given order (every field must exist); the arena is
+    // compacted if a column is dropped
+    void project(const std::vector<std::string>& fields);
+
+    bool isNumeric(size_t col) const { return columns[col].numeric; }
+    // false if the column is not numeric or the cell is empty
+    bool getNum(size_t row, size_t col, int64_t& num) const;
+    // buf is used only for numeric cells; the returned view is valid until buf or the table is
+    // modified
+    std::string_view view(size_t row, size_t col, std::string& buf) const;
+    std::string str(size_t row, size_t col) const;
+    std::string str(size_t row, const std::string& field) const;  // "" if the field is absent
+
+    nlohmann::json dump(size_t row) const;  // for debugging
+
+    // binary columnar image of the table in host byte order (see PacketCache)
+    void serialize(std::ostream& os) const;
+    // read an image of len bytes from is; false if the image is malformed or cannot be read
+    bool deserialize(std::istream& is, size_t len);
+
+    PktRef operator[](size_t row) const { return PktRef(*this, row); }
+  };
+
+}  // namespace fpnt
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef _PLAN_H
+#define _PLAN_H
+
+#include <fpnt/loader.h>
+#include <fpnt/mapper.h>
+#include <fpnt/value.h>
+
+#include <cstddef>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fpnt {
+
+  // a preprocessing function resolved from the plugin library with its option; for the ABI v2
+  // functions (see loader.h), state is the option parsed by P_x_init when the plan is built
+  struct PlanStep {
+    std::string name;
+    fnptr_PrepFn fn = nullptr;
+    std::string option;
+    fnptr_PrepStateFn state_fn = nullptr;
+    fnptr_PrepDestroyFn destroy = nullptr;
+    void* state = nullptr;
+    fnptr_PrepBatchFn batch_fn = nullptr;  // preferred if the plugin exports P_x_batch
+    bool threadsafe = false;               // the plugin exports P_x_threadsafe
+    fnptr_PrepMultiFn multi_fn = nullptr;  // the first column of a multi-output block
+    std::vector<std::string> options;      // the options of the fields of the block
+    std::vector<std::string> fields;
+
+    void apply(nlohmann::json& record, std::string& granularity, const std::string& key,
+               const std::string& field) const {
+      if (multi_fn != nullptr) {
+        multi_fn(state, options, record, granularity, key, fields);
+      } else if (state_fn != nullptr) {
+        state_fn(state, record, granularity, key, field);
+      } else {
+        fn(option, record, granularity, key, field);
+      }
+    }
+    void applyBatch(std::string& granularity, size_t first_idx, size_t count,
+                    nlohmann::json* const* records, const std::string& field) const {
+      batch_fn(state, option, granularity, first_idx, count, records, field);
+    }
+  };
+
+  // an output column; slot is the field index in the output mapper. refs are the (granularity,
+  // field) pairs declared by P_x_refs of the steps; a column is opaque if a step does not declare
+  // its references (it is then ordered as in the CSV file, see ExecutionPlan::schedule). A column
+  // whose preprocess_fns is "^" has no steps; it is written by the multi-output function of the
+  // first column of its block (head)
+  struct PlanColumn {
+    std::string field;
+    size_t slot;
+    std::vector<PlanStep> steps;
+    std::vector<std::pair<std::string, std::string>> refs;
+    bool opaque = false;
+    ValueType type = ValueType::TEXT;  // the type column of output_<granularity>.csv
+    size_t head = -1;                  // index of the first column of the block if "^"
+  };
+
+  // the columns order[begin, end) of a granularity, processed column by column over blocks of
+  // records if batched, or record by record otherwise (see Dispatcher::processRange)
+  struct PlanRun {
+    size_t begin;
+    size_t end;
+    bool batched;
+  };
+
+  struct GranularityPlan {
+    std::string granularity;
+    size_t level;  // index in Dispatcher::g_lvs
+    fnptr_genKeyFn genKey;
+    // genKey_x_dir and genKey_x_tuple of genKey_x if exported
+    fnptr_genKeyDirFn genKeyDir = nullptr;
+    fnptr_genKeyTupleFn genKeyTuple = nullptr;
+    std::vector<PlanColumn> columns;  // in the order of output_<granularity>.csv
+    std::vector<size_t> order;        // the needed columns (indices of columns) in the run order
+    std::vector<PlanRun> runs;        // consecutive parts of order
+    bool written = true;              // listed in output_granularities
+    bool batched = false;             // a run is batched
+    bool threadsafe = true;           // every step is thread-safe
+    bool opaque = false;              // a column is opaque
+  };
+
+  // the number of records processed column by column when a granularity has a batch function
+  constexpr size_t PLAN_BATCH_RECORDS = 4096;
+
+  /** @brief ExecutionPlan is compiled once from the output_<granularity>.csv mappers before any
+   * file is processed (and before forking), so that Dispatcher::process only walks resolved
+   * function pointers and pre-split options instead of splitting the `;`-separated strings and
+   * looking up every function by name for every record. The plan is not changed after build().
+   *
+   * build() also derives a dependency graph of the columns of all granularities from the
+   * references declared by the plugins (P_x_refs). Only the columns of the written granularities
+   * and the columns they depend on are computed, and the granularities are grouped into waves:
+   * the granularities of a wave only read the granularities of the previous waves.
+   */
+  class ExecutionPlan {
+  private:
+    std::vector<GranularityPlan> levels;
+    std::unordered_map<std::string, size_t> level_idx;
+    std::vector<std::vector<size_t>> waves;  // levels of the granularities to be processed
+
+    void schedule();
+    void clear();  // the states of ABI v2 functions are destroyed
+
+  public:
+    ExecutionPlan() = default;
+    ExecutionPlan(const ExecutionPlan&) = delete;
+    ExecutionPlan& operator=(const ExecutionPlan&) = delete;
+    ~ExecutionPlan() { clear(); }
+
+    void build(const std::vector<std::string>& g_lvs,
+               std::unordered_map<std::string, Mapper>& out_maps, Loader& loader,
+               const nlohmann::json& config);
+
+    const GranularityPlan& operator[](const std::string& granularity) const;
+    const GranularityPlan& at(size_t level) const { return levels[level]; }
+    size_t size() const { return levels.size(); }
+    const std::vector<std::vector<size_t>>& getWaves() const { return waves; }
+  };
+
+}  // namespace fpnt
+
+#endif
@@ -1,24 +1,38 @@
 #ifndef _READER_H
 #define _READER_H
 
+#include <fcntl.h>
 #include <fmt/core.h>
+#include <fpnt/glossary.h>
 #include <fpnt/loader.h>
 #include <fpnt/mapper.h>
+#include <fpnt/pcap.h>
+#include <fpnt/pkt_table.h>
+#include <fpnt/tsv.h>
 #include <fpnt/util.h>
 #include <pstream.h>
+#include <unistd.h>
 
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
 #include <csv.hpp>
 #include <filesystem>
 #include <fstream>
 #include <locale>
 #include <nlohmann/json.hpp>
+#include <thread>
 #include <unordered_map>
 
 namespace fpnt {
 
+  constexpr int TSHARK_PIPE_SIZE = 1 << 20;           // requested pipe capacity (F_SETPIPE_SZ)
+  constexpr size_t TSHARK_READ_BLOCK_SIZE = 1 << 22;  // initial read buffer of tshark output
+
+  // if input_cmd is given, tshark reads the standard output of input_cmd instead of filepath
   std::string genTsharkCmd(const nlohmann::json config, TSharkMapper& in_map,
-                           std::filesystem::path& filepath, size_t cnt = -1);
+                           std::filesystem::path& filepath, size_t cnt = -1,
+                           const std::string& input_cmd = "");
 
   csv::CSVFormat tshark_csv_fmt(std::vector<std::string> fields);
   csv::CSVFormat default_CSVFormat();
@@ -52,7 +66,10 @@ namespace fpnt {
 
   class TSharkCSVReader : public CSVReader {
   private:
+    std::string tshark_path;
     std::string dfref_path;
+    std::string dfref_index_path;    // empty if the dfref HTML files are scanned
+    std::string dfref_index_source;  // "dfref" or "tshark"
     std::string version;
     int major;
     int minor;
@@ -61,16 +78,26 @@ namespace fpnt {
     bool compareVersion(std::string);
     redi::ipstream in;
 
+    void loadGlossary(FieldGlossary& glossary);
+    std::string findDfrefRow(
+        const std::string& field,
+        std::unordered_map<std::string, std::vector<std::string> >& dfref_dirs);
+
   public:
     TSharkMapper map;
     TSharkCSVReader() = delete;
     TSharkCSVReader(std::string tshark_path, std::string path, std::string dfref_path,
+                    std::string dfref_index_path = "", std::string dfref_index_source = "dfref",
                     csv::CSVFormat format = default_CSVFormat())
         : CSVReader(path, format), in(redi::ipstream(tshark_path + " -v")) {
+      this->tshark_path = tshark_path;
       this->dfref_path = dfref_path;
+      this->dfref_index_path = dfref_index_path;
+      this->dfref_index_source = dfref_index_source;
     }
 
     TSharkMapper& read(Loader* loader = nullptr);
+    std::string getVersion() const { return version; }  // available after read()
   };
 
   class TSharkOutputReader : public Reader {
@@ -78,20 +105,103 @@ namespace fpnt {
     const nlohmann::json config;
     TSharkMapper& map;  // Reader's map is no longer used so hided
     std::string tshark_cmd;
-    redi::ipstream in;
-    csv::CSVFormat tshark_input_format;
-    std::vector<nlohmann::json>& in_pkts;
+    FILE* in;  // tshark's standard output, read in large blocks
+    PacketTable& in_pkts;
+    bool allow_empty;  // a chunk may have no packet passing the display filter
+
+  public:
+    TSharkOutputReader(const nlohmann::json config, TSharkMapper& in_map, PacketTable& in_pkts,
+                       std::filesystem::path in_filepath, size_t counter,
+                       const std::string& input_cmd = "", bool allow_empty = false)
+        : Reader(in_filepath.c_str()),
+          config(config),
+          map(in_map),
+          tshark_cmd(genTsharkCmd(config, in_map, in_filepath, counter, input_cmd)),
+          in(popen(tshark_cmd.c_str(), "re")),
+          in_pkts(in_pkts),
+          allow_empty(allow_empty) {}
+    TSharkOutputReader(const TSharkOutputReader&) = delete;
+    TSharkOutputReader& operator=(const TSharkOutputReader&) = delete;
+    ~TSharkOutputReader() {
+      if (in != nullptr) pclose(in);
+    }
+
+    TSharkMapper& read(Loader* loader = nullptr);
+  };
+
+  /** @brief TSharkChunkReader cuts a pcap/pcapng file at record boundaries into
+   * config["tshark_chunks"] byte ranges, and each range (with the file header) is streamed into
+   * its own tshark process. The decoded chunks are merged in the original order, and frame.number
+   * is renumbered globally. If the file cannot be split, it works as TSharkOutputReader.
+   */
+  class TSharkChunkReader : public Reader {
+  private:
+    const nlohmann::json config;
+    TSharkMapper& map;
+    std::filesystem::path in_filepath;
+    size_t counter;
+    PacketTable& in_pkts;
+
+  public:
+    TSharkChunkReader(const nlohmann::json config, TSharkMapper& in_map, PacketTable& in_pkts,
+                      std::filesystem::path in_filepath, size_t counter)
+        : Reader(in_filepath.c_str()),
+          config(config),
+          map(in_map),
+          in_filepath(in_filepath),
+          counter(counter),
+          in_pkts(in_pkts) {}
+
+    TSharkMapper& read(Loader* loader = nullptr);
+  };
+
+  /** @brief TSharkShardReader splits the fields of in_map into config["tshark_field_shards"]
+   * contiguous groups, and each group (with frame.number) is decoded by its own tshark process
+   * (TSharkChunkReader) on the same file at the same time. The outputs are joined column-wise by
+   * frame.number. With a single shard, it works as TSharkChunkReader.
+   */
+  class TSharkShardReader : public Reader {
+  private:
+    const nlohmann::json config;
+    TSharkMapper& map;
+    std::filesystem::path in_filepath;
+    size_t counter;
+    PacketTable& in_pkts;
+
+  public:
+    TSharkShardReader(const nlohmann::json config, TSharkMapper& in_map, PacketTable& in_pkts,
+                      std::filesystem::path in_filepath, size_t counter)
+        : Reader(in_filepath.c_str()),
+          config(config),
+          map(in_map),
+          in_filepath(in_filepath),
+          counter(counter),
+          in_pkts(in_pkts) {}
+
+    TSharkMapper& read(Loader* loader = nullptr);
+  };
+
+  /** @brief NativePcapReader decodes Ethernet/VLAN/IPv4/IPv6/TCP/UDP headers of a memory-mapped
+   * pcap/pcapng file without tshark. If every field of in_map and the display filter can be
+   * handled natively, tshark is not executed at all; otherwise tshark decodes only the remaining
+   * fields (with frame.number) and the natively decoded fields are joined by frame number.
+   */
+  class NativePcapReader : public Reader {
+  private:
+    const nlohmann::json config;
+    TSharkMapper& map;
+    std::filesystem::path in_filepath;
+    size_t counter;
+    PacketTable& in_pkts;
 
   public:
-    TSharkOutputReader(const nlohmann::json config, TSharkMapper& in_map,
-                       std::vector<nlohmann::json>& in_pkts, std::filesystem::path in_filepath,
-                       size_t counter)
+    NativePcapReader(const nlohmann::json config, TSharkMapper& in_map, PacketTable& in_pkts,
+                     std::filesystem::path in_filepath, size_t counter)
         : Reader(in_filepath.c_str()),
           config(config),
           map(in_map),
-          tshark_cmd(genTsharkCmd(config, in_map, in_filepath, counter)),
-          in(redi::ipstream(tshark_cmd)),
-          tshark_input_format(tshark_csv_fmt(in_map.getFields())),
+          in_filepath(in_filepath),
+          counter(counter),
           in_pkts(in_pkts) {}
 
     TSharkMapper& read(Loader* loader = nullptr);
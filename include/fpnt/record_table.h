@@ -0,0 +1,54 @@
+#ifndef _RECORD_TABLE_H
+#define _RECORD_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fpnt {
+
+  /** @brief RecordTable holds the output records of a granularity (Dispatcher::out) by record ID.
+   * A key is interned once by insert() and gets the next dense ID, which is the index of its
+   * record (__<granularity>_idx); the records are a vector indexed by ID, and the parent and child
+   * records are found by ID as well (see Hierarchy). Every key string is stored only once: the
+   * keys are kept in a deque so that they are never moved, and the map from keys to IDs holds
+   * views of them.
+   *
+   * A record is accessed by ID, or by key (e.g., the key passed to a P_* function); unlike
+   * std::unordered_map, an unknown key is an error instead of a new record, since records are
+   * only created by Dispatcher::process_base.
+   */
+  class RecordTable {
+  private:
+    std::deque<std::string> keys;                        // by ID
+    std::unordered_map<std::string_view, uint32_t> ids;  // views of keys
+    std::vector<nlohmann::json> records;                 // by ID
+
+  public:
+    static constexpr uint32_t NO_ID = UINT32_MAX;
+
+    // the ID of key, and true if the key is new (its record is then created as null)
+    std::pair<uint32_t, bool> insert(const std::string& key);
+    uint32_t find(std::string_view key) const;  // NO_ID if absent
+    uint32_t id(std::string_view key) const;    // exits if absent
+
+    const std::string& key(size_t id) const { return keys[id]; }
+    nlohmann::json& operator[](size_t id) { return records[id]; }
+    nlohmann::json& operator[](const std::string& key) { return records[id(key)]; }
+    // read-only access, e.g., to the records of other keys in a thread-safe P_* function
+    const nlohmann::json& operator[](size_t id) const { return records[id]; }
+    const nlohmann::json& operator[](const std::string& key) const { return records[id(key)]; }
+
+    size_t size() const { return records.size(); }
+    void clear();
+  };
+
+}  // namespace fpnt
+
+#endif
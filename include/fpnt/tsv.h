@@ -0,0 +1,50 @@
+#ifndef _TSV_H
+#define _TSV_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace fpnt {
+
+  /** @brief Find the positions of every '\t' and '\n' in data[0, len), in order, and store them
+   * in delims (grown as delimiters are found); it returns the number of delimiters found. The
+   * scanner is selected once at runtime: AVX2 or SSE2 on x86, otherwise a scalar loop.
+   */
+  size_t scanTsvDelimiters(const char* data, size_t len, std::vector<uint32_t>& delims);
+
+  const char* tsvScannerName();  // "avx2", "sse2" or "scalar", for debugging
+
+  /** @brief TsvReader reads tab-separated lines (e.g., the output of tshark -T fields) from a file
+   * descriptor in large blocks instead of line by line. The delimiters of a block are found by
+   * scanTsvDelimiters, and the fields are views into the block; only the incomplete last line of
+   * a block is carried over to the next read, and the block grows for a longer line. Quotes and
+   * backslashes are not interpreted, a '\r' before a newline is dropped, empty lines are skipped,
+   * and the last line may lack a newline.
+   */
+  class TsvReader {
+  private:
+    int fd;
+    std::vector<char> buf;
+    std::vector<uint32_t> delims;
+    size_t filled = 0;       // bytes in buf
+    size_t start = 0;        // the first byte of the next field
+    size_t next_delim = 0;   // index into delims
+    size_t no_complete = 0;  // delimiters up to the last newline of buf
+    size_t no_bytes = 0;     // bytes read so far
+    bool eof = false;
+
+    void fill();  // read the next block after the complete lines; exits on a read error
+
+  public:
+    TsvReader(int fd, size_t block_size) : fd(fd), buf(block_size) {}
+
+    // the fields of the next line, valid until the next call; false at the end of the input
+    bool next(std::vector<std::string_view>& fields);
+    size_t bytesRead() const { return no_bytes; }
+  };
+
+}  // namespace fpnt
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef _VALUE_H
+#define _VALUE_H
+
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+namespace fpnt {
+
+  /** ValueType is the optional type column of output_<granularity>.csv. The values of a typed
+   * column are converted once from the text computed by its steps to json numbers (int64 or
+   * double; a timestamp is in seconds as double), so that the aggregators read numbers instead of
+   * parsing the same text for every parent record; they are formatted to text only by
+   * Dispatcher::writer. A value that is not a number (e.g., "" or "1,2") is kept as text.
+   *
+   * A sequence (e.g., the packet lengths of a flow) is a json array, whose elements are converted
+   * and formatted by the type of the column as well; it is joined with commas only by the writer.
+   */
+  enum class ValueType { TEXT, INT, DOUBLE, TIMESTAMP };
+
+  // "" or "string", "int", "double" and "timestamp"; false if unknown
+  inline bool parseValueType(const std::string& str, ValueType& type) {
+    if (str == "" || str == "string") {
+      type = ValueType::TEXT;
+    } else if (str == "int") {
+      type = ValueType::INT;
+    } else if (str == "double") {
+      type = ValueType::DOUBLE;
+    } else if (str == "timestamp") {
+      type = ValueType::TIMESTAMP;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  inline void toTyped(nlohmann::json& value, ValueType type) {
+    if (type == ValueType::TEXT) return;
+    if (value.is_array()) {
+      for (auto& element : value) toTyped(element, type);
+    } else if (value.is_string()) {
+      const std::string& str = value.get_ref<const std::string&>();
+      if (str.empty()) return;
+      char* end;
+      if (type == ValueType::INT) {
+        long long x = strtoll(str.c_str(), &end, 10);
+        if (*end == '\0') value = (int64_t)x;
+      } else {
+        double x = strtod(str.c_str(), &end);
+        if (*end == '\0') value = x;
+      }
+    } else if (type == ValueType::INT && value.is_number_float()) {
+      value = (int64_t)value.get<double>();
+    } else if (type != ValueType::INT && value.is_number_integer()) {
+      value = value.get<double>();
+    }
+  }
+
+  // numbers of an untyped column are formatted by std::to_string as the P_* functions did so far,
+  // and the numbers in an untyped sequence as vectorToString (%g) did
+  inline std::string formatValue(const nlohmann::json& value, ValueType type = ValueType::TEXT,
+                                 bool in_sequence = false) {
+    switch (value.type()) {
+      case nlohmann::json::value_t::string:
+        return value.get_ref<const std::string&>();
+      case nlohmann::json::value_t::number_integer:
+        return std::to_string(value.get<int64_t>());
+      case nlohmann::json::value_t::number_unsigned:
+        return std::to_string(value.get<uint64_t>());
+      case nlohmann::json::value_t::number_float:
+        if (type == ValueType::TIMESTAMP) return fmt::format("{:.6f}", value.get<double>());
+        if (type == ValueType::DOUBLE) return fmt::format("{}", value.get<double>());
+        if (in_sequence) return fmt::format("{:g}", value.get<double>());
+        return std::to_string(value.get<double>());
+      case nlohmann::json::value_t::null:
+        return "";
+      case nlohmann::json::value_t::array: {
+        std::string result;
+        bool first = true;
+        for (auto& element : value) {
+          if (!first) result += ",";
+          first = false;
+          result += formatValue(element, type, true);
+        }
+        return result;
+      }
+      default:
+        return value.dump();
+    }
+  }
+
+  // a number of a typed or an untyped column; text is parsed as atof/atoll (0 if not a number)
+  inline double toDouble(const nlohmann::json& value) {
+    if (value.is_number()) return value.get<double>();
+    if (value.is_string()) return atof(value.get_ref<const std::string&>().c_str());
+    return 0;
+  }
+
+  inline long long toInt(const nlohmann::json& value) {
+    if (value.is_number_float()) return (long long)value.get<double>();
+    if (value.is_number()) return value.get<long long>();
+    if (value.is_string()) return atoll(value.get_ref<const std::string&>().c_str());
+    return 0;
+  }
+
+  // the numbers of a sequence (an array, or comma-separated text); empty or non-numeric elements
+  // are skipped
+  inline std::vector<double> toVector(const nlohmann::json& value) {
+    std::vector<double> result;
+    if (value.is_array()) {
+      result.reserve(value.size());
+      for (auto& element : value) {
+        if (element.is_number()) {
+          result.push_back(element.get<double>());
+        } else if (element.is_string() && !element.get_ref<const std::string&>().empty()) {
+          char* end;
+          const char* str = element.get_ref<const std::string&>().c_str();
+          double x = strtod(str, &end);
+          if (end != str) result.push_back(x);
+        }
+      }
+    } else if (value.is_number()) {
+      result.push_back(value.get<double>());
+    } else if (value.is_string()) {
+      const char* str = value.get_ref<const std::string&>().c_str();
+      while (*str != '\0') {
+        char* end;
+        double x = strtod(str, &end);
+        if (end != str) result.push_back(x);
+        while (*end != '\0' && *end != ',') end++;
+        str = (*end == ',') ? end + 1 : end;
+      }
+    }
+    return result;
+  }
+
+}  // namespace fpnt
+
+#endif
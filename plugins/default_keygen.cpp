@@ -3,6 +3,7 @@
 #include <arpa/inet.h>
 #include <fmt/core.h>
 
+#include <charconv>
 #include <cstring>
 
 #include "dispatcher_ptr.h"
@@ -11,9 +12,9 @@
  * just use its record creation order starting from 0
  *
  */
-const std::string genKey_pkt_default(const nlohmann::json& pkt, std::string& granularity,
+const std::string genKey_pkt_default(const fpnt::PktRef& pkt, std::string& granularity,
                                      std::string& key) {
-  return std::to_string(pkt["idx"].get<size_t>());
+  return std::to_string(pkt.idx());
 }
 
 /** @brief Default key generator for "bidirectional" Flow records assuming only TCP/IP, UDP/IP
@@ -23,12 +24,12 @@ const std::string genKey_pkt_default(const nlohmann::json& pkt, std::string& gra
  * is appeared first (to identify well-known service port quickly) and if the port numbers are
  * the same, the host with smaller IP address is appeared first.
  */
-const std::string genKey_flow_default(const nlohmann::json& pkt, std::string& granularity,
-                                      std::string& key) {
+static std::string flow_key_default(const fpnt::PktRef& pkt, int& dir) {
   std::string cur_key;
+  dir = 0;
 
-  std::string cur_srcport = pkt["tcp.srcport"].get<std::string>();
-  std::string cur_dstport = pkt["tcp.dstport"].get<std::string>();
+  std::string cur_srcport = pkt["tcp.srcport"];
+  std::string cur_dstport = pkt["tcp.dstport"];
 
   // Support for Protocol Name
   std::string protocol_name = "TCP";
@@ -40,13 +41,13 @@ const std::string genKey_flow_default(const nlohmann::json& pkt, std::string& gr
     // user to check fpnt is correctly configured. However, in some cases, UDP port information
     // might be missing, especially when analyzing certain types of traffic. To this end, we will
     // set both ports to "0" when they are missing.
-    if (pkt["udp.srcport"].is_null() || pkt["udp.dstport"].is_null()) {
+    if (!pkt.contains("udp.srcport") || !pkt.contains("udp.dstport")) {
       cur_srcport = "0";
       cur_dstport = "0";
     }
 
-    cur_srcport = pkt["udp.srcport"].get<std::string>();
-    cur_dstport = pkt["udp.dstport"].get<std::string>();
+    cur_srcport = pkt["udp.srcport"];
+    cur_dstport = pkt["udp.dstport"];
 
     if (cur_srcport.compare("") == 0 || cur_dstport.compare("") == 0) {
       protocol_name = "etc";
@@ -58,8 +59,8 @@ const std::string genKey_flow_default(const nlohmann::json& pkt, std::string& gr
 
   // end of Support for Protocol Name
 
-  std::string cur_src = pkt["_ws.col.def_src"].get<std::string>();
-  std::string cur_dst = pkt["_ws.col.def_dst"].get<std::string>();
+  std::string cur_src = pkt["_ws.col.def_src"];
+  std::string cur_dst = pkt["_ws.col.def_dst"];
 
   // std::cout << cur_src << "," << cur_dst << std::endl;
 
@@ -95,9 +96,8 @@ const std::string genKey_flow_default(const nlohmann::json& pkt, std::string& gr
       if (inet_pton(AF_INET6, cur_src.c_str(), &src_n) != 1
           || inet_pton(AF_INET6, cur_dst.c_str(), &dst_n) != 1) {
         std::cerr << "Invalid IPv6 address" << std::endl;
-        std::cerr << pkt["idx"].get<std::string>() << ","
-                  << pkt["_ws.col.def_src"].get<std::string>() << ","
-                  << pkt["_ws.col.def_dst"].get<std::string>() << std::endl;
+        std::cerr << pkt.idx() << "," << pkt["_ws.col.def_src"] << "," << pkt["_ws.col.def_dst"]
+                  << std::endl;
         exit(EXIT_FAILURE);
       }
       if (memcmp(&src_n, &dst_n, sizeof(src_n)) >= 0) src_greater_equal = true;
@@ -106,28 +106,42 @@ const std::string genKey_flow_default(const nlohmann::json& pkt, std::string& gr
       if (inet_pton(AF_INET, cur_src.c_str(), &src_n) != 1
           || inet_pton(AF_INET, cur_dst.c_str(), &dst_n) != 1) {
         std::cerr << "Invalid IPv4 address" << std::endl;
-        std::cerr << pkt["idx"].get<std::string>() << ","
-                  << pkt["_ws.col.def_src"].get<std::string>() << ","
-                  << pkt["_ws.col.def_dst"].get<std::string>() << std::endl;
+        std::cerr << pkt.idx() << "," << pkt["_ws.col.def_src"] << "," << pkt["_ws.col.def_dst"]
+                  << std::endl;
         exit(EXIT_FAILURE);
       }
       // Compare in network byte order (Big Endian)
       if (memcmp(&src_n, &dst_n, sizeof(src_n)) >= 0) src_greater_equal = true;
     }
 
+    dir = src_greater_equal ? 1 : -1;
     if (src_greater_equal)  // dst_n is the server
       cur_key = fmt::format("{0}:{1},{2}:{3}", cur_src, cur_srcport, cur_dst, cur_dstport);
     else  // dst_n is the client
       cur_key = fmt::format("{2}:{3},{0}:{1}", cur_src, cur_srcport, cur_dst, cur_dstport);
   } else if (keycomp > 0) {  // srcport > dstport                   dstport is the server
+    dir = 1;
     cur_key = fmt::format("{0}:{1},{2}:{3}", cur_src, cur_srcport, cur_dst, cur_dstport);
   } else {  // srcport < dstport                   dstport is the client
+    dir = -1;
     cur_key = fmt::format("{2}:{3},{0}:{1}", cur_src, cur_srcport, cur_dst, cur_dstport);
   }
 
+  if (cur_src.empty()) dir = 0;  // unexpected value (see P_dir)
   return cur_key;
 }
 
+const std::string genKey_flow_default(const fpnt::PktRef& pkt, std::string& granularity,
+                                      std::string& key) {
+  int dir;
+  return flow_key_default(pkt, dir);
+}
+
+const std::string genKey_flow_default_dir(const fpnt::PktRef& pkt, std::string& granularity,
+                                          std::string& key, int& dir) {
+  return flow_key_default(pkt, dir);
+}
+
 /** @brief Default key generator for "bidirectional" Flow records assuming only TCP/IP, UDP/IP
  * datagrams are available for efficient generation; use the standard "5 tuple" fields
  * (_ws.col.def_src, _ws.col.def_dst, tcp.srcport or udp.srcport, tcp.dstport or udp.dstport,
@@ -137,12 +151,12 @@ const std::string genKey_flow_default(const nlohmann::json& pkt, std::string& gr
  * string is "srcIP:srcPort,dstIP:dstPort/protocol".
  *
  */
-const std::string genKey_flow_default_5tuple(const nlohmann::json& pkt, std::string& granularity,
-                                             std::string& key) {
+static std::string flow_key_default_5tuple(const fpnt::PktRef& pkt, int& dir) {
   std::string cur_key;
+  dir = 0;
 
-  std::string cur_srcport = pkt["tcp.srcport"].get<std::string>();
-  std::string cur_dstport = pkt["tcp.dstport"].get<std::string>();
+  std::string cur_srcport = pkt["tcp.srcport"];
+  std::string cur_dstport = pkt["tcp.dstport"];
 
   // Support for Protocol Name; however, currently this variable is not used.
   std::string protocol_name = "TCP";
@@ -155,13 +169,13 @@ const std::string genKey_flow_default_5tuple(const nlohmann::json& pkt, std::str
     // user to check fpnt is correctly configured. However, in some cases, UDP port information
     // might be missing, especially when analyzing certain types of traffic. To this end, we will
     // set both ports to "0" when they are missing.
-    if (pkt["udp.srcport"].is_null() || pkt["udp.dstport"].is_null()) {
+    if (!pkt.contains("udp.srcport") || !pkt.contains("udp.dstport")) {
       cur_srcport = "0";
       cur_dstport = "0";
     }
 
-    cur_srcport = pkt["udp.srcport"].get<std::string>();
-    cur_dstport = pkt["udp.dstport"].get<std::string>();
+    cur_srcport = pkt["udp.srcport"];
+    cur_dstport = pkt["udp.dstport"];
 
     if (cur_srcport.compare("") == 0 || cur_dstport.compare("") == 0) {
       protocol_name = "etc";  // e.g., ICMP, ...
@@ -173,8 +187,8 @@ const std::string genKey_flow_default_5tuple(const nlohmann::json& pkt, std::str
 
   // end of Support for Protocol Name
 
-  std::string cur_src = pkt["_ws.col.def_src"].get<std::string>();
-  std::string cur_dst = pkt["_ws.col.def_dst"].get<std::string>();
+  std::string cur_src = pkt["_ws.col.def_src"];
+  std::string cur_dst = pkt["_ws.col.def_dst"];
 
   // std::cout << cur_src << "," << cur_dst << std::endl;
 
@@ -201,10 +215,10 @@ const std::string genKey_flow_default_5tuple(const nlohmann::json& pkt, std::str
   //    we assume that the smaller IP address is the server
   // We use the client-first, server-second pair
 
-  std::string ip_proto = pkt["ip.proto"].get<std::string>();
+  std::string ip_proto = pkt["ip.proto"];
 
   if (ip_proto.compare("") == 0) {
-    std::string ipv6_nxt = pkt["ipv6.nxt"].get<std::string>();
+    std::string ipv6_nxt = pkt["ipv6.nxt"];
     ip_proto = ipv6_nxt;
   }
 
@@ -217,9 +231,8 @@ const std::string genKey_flow_default_5tuple(const nlohmann::json& pkt, std::str
       if (inet_pton(AF_INET6, cur_src.c_str(), &src_n) != 1
           || inet_pton(AF_INET6, cur_dst.c_str(), &dst_n) != 1) {
         std::cerr << "Invalid IPv6 address" << std::endl;
-        std::cerr << pkt["idx"].get<std::string>() << ","
-                  << pkt["_ws.col.def_src"].get<std::string>() << ","
-                  << pkt["_ws.col.def_dst"].get<std::string>() << std::endl;
+        std::cerr << pkt.idx() << "," << pkt["_ws.col.def_src"] << "," << pkt["_ws.col.def_dst"]
+                  << std::endl;
         exit(EXIT_FAILURE);
       }
       if (memcmp(&src_n, &dst_n, sizeof(src_n)) >= 0) src_greater_equal = true;
@@ -228,15 +241,15 @@ const std::string genKey_flow_default_5tuple(const nlohmann::json& pkt, std::str
       if (inet_pton(AF_INET, cur_src.c_str(), &src_n) != 1
           || inet_pton(AF_INET, cur_dst.c_str(), &dst_n) != 1) {
         std::cerr << "Invalid IPv4 address" << std::endl;
-        std::cerr << pkt["idx"].get<std::string>() << ","
-                  << pkt["_ws.col.def_src"].get<std::string>() << ","
-                  << pkt["_ws.col.def_dst"].get<std::string>() << std::endl;
+        std::cerr << pkt.idx() << "," << pkt["_ws.col.def_src"] << "," << pkt["_ws.col.def_dst"]
+                  << std::endl;
         exit(EXIT_FAILURE);
       }
       // Compare in network byte order (Big Endian)
       if (memcmp(&src_n, &dst_n, sizeof(src_n)) >= 0) src_greater_equal = true;
     }
 
+    dir = src_greater_equal ? 1 : -1;
     if (src_greater_equal)  // dst_n is the server
       cur_key = fmt::format("{0}:{1},{2}:{3}/{4}", cur_src, cur_srcport, cur_dst, cur_dstport,
                             ip_proto);
@@ -244,16 +257,30 @@ const std::string genKey_flow_default_5tuple(const nlohmann::json& pkt, std::str
       cur_key = fmt::format("{2}:{3},{0}:{1}/{4}", cur_src, cur_srcport, cur_dst, cur_dstport,
                             ip_proto);
   } else if (keycomp > 0) {  // srcport > dstport                   dstport is the server
+    dir = 1;
     cur_key
         = fmt::format("{0}:{1},{2}:{3}/{4}", cur_src, cur_srcport, cur_dst, cur_dstport, ip_proto);
   } else {  // srcport < dstport                   dstport is the client
+    dir = -1;
     cur_key
         = fmt::format("{2}:{3},{0}:{1}/{4}", cur_src, cur_srcport, cur_dst, cur_dstport, ip_proto);
   }
 
+  if (cur_src.empty()) dir = 0;  // unexpected value (see P_dir)
   return cur_key;
 }
 
+const std::string genKey_flow_default_5tuple(const fpnt::PktRef& pkt, std::string& granularity,
+                                             std::string& key) {
+  int dir;
+  return flow_key_default_5tuple(pkt, dir);
+}
+
+const std::string genKey_flow_default_5tuple_dir(const fpnt::PktRef& pkt, std::string& granularity,
+                                                 std::string& key, int& dir) {
+  return flow_key_default_5tuple(pkt, dir);
+}
+
 /** @brief A key generator for "bidirectional" Flow records assuming only TCP/IPv4, UDP/IPv4
  * datagrams are available for efficient generation; use 4 tuple fields
  * (ip.src, ip.dst, tcp.srcport or udp.srcport, tcp.dstport or udp.dstport)
@@ -263,12 +290,12 @@ const std::string genKey_flow_default_5tuple(const nlohmann::json& pkt, std::str
  * address is appeared first.
  *
  */
-const std::string genKey_flow_ipv4(const nlohmann::json& pkt, std::string& granularity,
-                                   std::string& key) {
+static std::string flow_key_ipv4(const fpnt::PktRef& pkt, int& dir) {
   std::string cur_key;
+  dir = 0;
 
-  std::string cur_srcport = pkt["tcp.srcport"].get<std::string>();
-  std::string cur_dstport = pkt["tcp.dstport"].get<std::string>();
+  std::string cur_srcport = pkt["tcp.srcport"];
+  std::string cur_dstport = pkt["tcp.dstport"];
 
   // Support for Protocol Name
   std::string protocol_name = "TCP";
@@ -278,7 +305,7 @@ const std::string genKey_flow_ipv4(const nlohmann::json& pkt, std::string& granu
 
     // When udp.srcport or udp.dstport is null, it was treated as an error to indicate user to check
     // fpnt is correctly configured.
-    if (pkt["udp.srcport"].is_null() || pkt["udp.dstport"].is_null()) {
+    if (!pkt.contains("udp.srcport") || !pkt.contains("udp.dstport")) {
       std::cerr << "getPktKey: the corresponding input json does not collect udp.srcport and/or "
                    "udp.dstport."
                 << std::endl;
@@ -288,8 +315,8 @@ const std::string genKey_flow_ipv4(const nlohmann::json& pkt, std::string& granu
       exit(EXIT_FAILURE);
     }
 
-    cur_srcport = pkt["udp.srcport"].get<std::string>();
-    cur_dstport = pkt["udp.dstport"].get<std::string>();
+    cur_srcport = pkt["udp.srcport"];
+    cur_dstport = pkt["udp.dstport"];
 
     if (cur_srcport.compare("") == 0 || cur_dstport.compare("") == 0) {
       protocol_name = "etc";
@@ -301,8 +328,8 @@ const std::string genKey_flow_ipv4(const nlohmann::json& pkt, std::string& granu
 
   // end of Support for Protocol Name
 
-  std::string cur_src = pkt["ip.src"].get<std::string>();
-  std::string cur_dst = pkt["ip.dst"].get<std::string>();
+  std::string cur_src = pkt["ip.src"];
+  std::string cur_dst = pkt["ip.dst"];
 
   // if IPv6 address is given... ;<
   if (cur_src + cur_dst == "") {
@@ -341,29 +368,144 @@ const std::string genKey_flow_ipv4(const nlohmann::json& pkt, std::string& granu
       std::cerr << "Invalid address" << std::endl;
       exit(EXIT_FAILURE);
     }
+    dir = (src_n.s_addr >= dst_n.s_addr) ? 1 : -1;
     if (src_n.s_addr >= dst_n.s_addr)  // dst_n is the server
       cur_key = fmt::format("{0}:{1},{2}:{3}", cur_src, cur_srcport, cur_dst, cur_dstport);
     else  // dst_n is the client
       cur_key = fmt::format("{2}:{3},{0}:{1}", cur_src, cur_srcport, cur_dst, cur_dstport);
   } else if (keycomp > 0) {  // srcport > dstport                   dstport is the server
+    dir = 1;
     cur_key = fmt::format("{0}:{1},{2}:{3}", cur_src, cur_srcport, cur_dst, cur_dstport);
   } else {  // srcport < dstport                   dstport is the client
+    dir = -1;
     cur_key = fmt::format("{2}:{3},{0}:{1}", cur_src, cur_srcport, cur_dst, cur_dstport);
   }
+  if (cur_src.empty()) dir = 0;  // unexpected value (see P_dir)
   return cur_key;
 }
 
+const std::string genKey_flow_ipv4(const fpnt::PktRef& pkt, std::string& granularity,
+                                   std::string& key) {
+  int dir;
+  return flow_key_ipv4(pkt, dir);
+}
+
+const std::string genKey_flow_ipv4_dir(const fpnt::PktRef& pkt, std::string& granularity,
+                                       std::string& key, int& dir) {
+  return flow_key_ipv4(pkt, dir);
+}
+
+// an address of a key (up to a comma, see the tshark bug above) in binary; false if it is not an
+// IPv4 or IPv6 address
+static bool parse_tuple_addr(std::string text, uint8_t* addr, bool& ipv6) {
+  size_t l;
+  if ((l = text.find(',')) != std::string::npos) text = text.substr(0, l);
+  ipv6 = (text.find(':') != std::string::npos);
+  return inet_pton(ipv6 ? AF_INET6 : AF_INET, text.c_str(), addr) == 1;
+}
+
+// a decimal number without a leading zero (so that the key strings of equal tuples are equal)
+static bool parse_tuple_number(const std::string& text, uint16_t& number) {
+  if (text.size() > 1 && text[0] == '0') return false;
+  const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), number);
+  return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+/** flow_tuple fills the binary key of the bidirectional key generators above from the address
+ * fields src_field and dst_field, with the same endpoint order and direction as their key strings:
+ * with_proto adds ip.proto (or ipv6.nxt) as genKey_flow_default_5tuple does, and ipv4 follows
+ * genKey_flow_ipv4 (IPv4 addresses only, compared as s_addr; udp.srcport and udp.dstport must be
+ * collected). false if the packet has no tuple (e.g., an address is not an IP address); its key
+ * string is then generated by the key generator itself.
+ */
+static bool flow_tuple(const fpnt::PktRef& pkt, const std::string& src_field,
+                       const std::string& dst_field, bool with_proto, bool ipv4,
+                       fpnt::FlowTuple& tuple, int& dir) {
+  std::string cur_srcport = pkt["tcp.srcport"];
+  std::string cur_dstport = pkt["tcp.dstport"];
+  if (cur_srcport.empty() || cur_dstport.empty()) {
+    if (ipv4 && (!pkt.contains("udp.srcport") || !pkt.contains("udp.dstport"))) return false;
+    cur_srcport = pkt["udp.srcport"];
+    cur_dstport = pkt["udp.dstport"];
+    if (cur_srcport.empty() || cur_dstport.empty()) {
+      cur_srcport = "0";
+      cur_dstport = "0";
+    }
+  }
+  uint16_t ports[2];
+  if (!parse_tuple_number(cur_srcport, ports[0]) || !parse_tuple_number(cur_dstport, ports[1])) {
+    return false;
+  }
+
+  uint8_t addrs[2][16] = {};
+  bool ipv6[2];
+  if (!parse_tuple_addr(pkt[src_field], addrs[0], ipv6[0])
+      || !parse_tuple_addr(pkt[dst_field], addrs[1], ipv6[1]) || ipv6[0] != ipv6[1]
+      || (ipv4 && ipv6[0])) {
+    return false;
+  }
+  if (ipv6[0]) tuple.flags |= fpnt::FlowTuple::IPV6;
+
+  if (with_proto) {
+    std::string ip_proto = pkt["ip.proto"];
+    if (ip_proto.empty()) ip_proto = pkt["ipv6.nxt"];
+    if (!ip_proto.empty()) {
+      uint16_t proto;
+      if (!parse_tuple_number(ip_proto, proto) || proto > 255) return false;
+      tuple.proto = proto;
+      tuple.flags |= fpnt::FlowTuple::PROTO;
+    }
+  }
+
+  // the same policy as the key strings: the endpoint with the smaller port number (or the smaller
+  // address if the port numbers are the same) is the server, i.e., the second one
+  bool src_first;
+  if (ports[0] != ports[1]) {
+    src_first = ports[0] > ports[1];
+  } else if (ipv4) {
+    uint32_t src_n, dst_n;
+    memcpy(&src_n, addrs[0], sizeof(src_n));
+    memcpy(&dst_n, addrs[1], sizeof(dst_n));
+    src_first = src_n >= dst_n;
+  } else {
+    src_first = memcmp(addrs[0], addrs[1], ipv6[0] ? 16 : 4) >= 0;
+  }
+
+  const int first = src_first ? 0 : 1;
+  memcpy(tuple.addr[0], addrs[first], sizeof(tuple.addr[0]));
+  memcpy(tuple.addr[1], addrs[1 - first], sizeof(tuple.addr[1]));
+  tuple.port[0] = ports[first];
+  tuple.port[1] = ports[1 - first];
+  dir = src_first ? 1 : -1;
+  return true;
+}
+
+bool genKey_flow_default_tuple(const fpnt::PktRef& pkt, std::string& granularity,
+                               fpnt::FlowTuple& tuple, int& dir) {
+  return flow_tuple(pkt, "_ws.col.def_src", "_ws.col.def_dst", false, false, tuple, dir);
+}
+
+bool genKey_flow_default_5tuple_tuple(const fpnt::PktRef& pkt, std::string& granularity,
+                                      fpnt::FlowTuple& tuple, int& dir) {
+  return flow_tuple(pkt, "_ws.col.def_src", "_ws.col.def_dst", true, false, tuple, dir);
+}
+
+bool genKey_flow_ipv4_tuple(const fpnt::PktRef& pkt, std::string& granularity,
+                            fpnt::FlowTuple& tuple, int& dir) {
+  return flow_tuple(pkt, "ip.src", "ip.dst", false, true, tuple, dir);
+}
+
 /** @brief Default key generator for "directional" Flow records assuming only TCP/IP, UDP/IP
  * datagrams are available for efficient generation; use "4 tuple" fields (_ws.col.def_src,
  * _ws.col.def_dst, tcp.srcport or udp.srcport, tcp.dstport or udp.dstport); suitable for
  * encrypted traffic analysis such as TLS or QUIC; key string is "srcIP:srcPort,dstIP:dstPort".
  */
-const std::string genKey_flow_directional_default(const nlohmann::json& pkt,
-                                                  std::string& granularity, std::string& key) {
+const std::string genKey_flow_directional_default(const fpnt::PktRef& pkt, std::string& granularity,
+                                                  std::string& key) {
   std::string cur_key;
 
-  std::string cur_srcport = pkt["tcp.srcport"].get<std::string>();
-  std::string cur_dstport = pkt["tcp.dstport"].get<std::string>();
+  std::string cur_srcport = pkt["tcp.srcport"];
+  std::string cur_dstport = pkt["tcp.dstport"];
 
   // Support for Protocol Name
   std::string protocol_name = "TCP";
@@ -375,13 +517,13 @@ const std::string genKey_flow_directional_default(const nlohmann::json& pkt,
     // user to check fpnt is correctly configured. However, in some cases, UDP port information
     // might be missing, especially when analyzing certain types of traffic. To this end, we will
     // set both ports to "0" when they are missing.
-    if (pkt["udp.srcport"].is_null() || pkt["udp.dstport"].is_null()) {
+    if (!pkt.contains("udp.srcport") || !pkt.contains("udp.dstport")) {
       cur_srcport = "0";
       cur_dstport = "0";
     }
 
-    cur_srcport = pkt["udp.srcport"].get<std::string>();
-    cur_dstport = pkt["udp.dstport"].get<std::string>();
+    cur_srcport = pkt["udp.srcport"];
+    cur_dstport = pkt["udp.dstport"];
 
     if (cur_srcport.compare("") == 0 || cur_dstport.compare("") == 0) {
       protocol_name = "etc";
@@ -393,8 +535,8 @@ const std::string genKey_flow_directional_default(const nlohmann::json& pkt,
 
   // end of Support for Protocol Name
 
-  std::string cur_src = pkt["_ws.col.def_src"].get<std::string>();
-  std::string cur_dst = pkt["_ws.col.def_dst"].get<std::string>();
+  std::string cur_src = pkt["_ws.col.def_src"];
+  std::string cur_dst = pkt["_ws.col.def_dst"];
 
   // fix a bug in tshark
   // sometimes, ip.src or ip.dst can have unexpected comma due to a bug in tshark. we will use the
@@ -424,12 +566,12 @@ const std::string genKey_flow_directional_default(const nlohmann::json& pkt,
  * IPv4 traffic analysis only; key string is "srcIP:srcPort,dstIP:dstPort".
  * non-IPv4 packets will have flow key string "{file_idx}_NonIPv4".
  */
-const std::string genKey_flow_directional_ipv4(const nlohmann::json& pkt, std::string& granularity,
+const std::string genKey_flow_directional_ipv4(const fpnt::PktRef& pkt, std::string& granularity,
                                                std::string& key) {
   std::string cur_key;
 
-  std::string cur_srcport = pkt["tcp.srcport"].get<std::string>();
-  std::string cur_dstport = pkt["tcp.dstport"].get<std::string>();
+  std::string cur_srcport = pkt["tcp.srcport"];
+  std::string cur_dstport = pkt["tcp.dstport"];
 
   // Support for Protocol Name
   std::string protocol_name = "TCP";
@@ -439,7 +581,7 @@ const std::string genKey_flow_directional_ipv4(const nlohmann::json& pkt, std::s
 
     // When udp.srcport or udp.dstport is null, it was treated as an error to indicate user to check
     // fpnt is correctly configured.
-    if (pkt["udp.srcport"].is_null() || pkt["udp.dstport"].is_null()) {
+    if (!pkt.contains("udp.srcport") || !pkt.contains("udp.dstport")) {
       std::cerr << "getPktKey: the corresponding input json does not collect udp.srcport and/or "
                    "udp.dstport."
                 << std::endl;
@@ -449,8 +591,8 @@ const std::string genKey_flow_directional_ipv4(const nlohmann::json& pkt, std::s
       exit(EXIT_FAILURE);
     }
 
-    cur_srcport = pkt["udp.srcport"].get<std::string>();
-    cur_dstport = pkt["udp.dstport"].get<std::string>();
+    cur_srcport = pkt["udp.srcport"];
+    cur_dstport = pkt["udp.dstport"];
 
     if (cur_srcport.compare("") == 0 || cur_dstport.compare("") == 0) {
       protocol_name = "etc";
@@ -462,8 +604,8 @@ const std::string genKey_flow_directional_ipv4(const nlohmann::json& pkt, std::s
 
   // end of Support for Protocol Name
 
-  std::string cur_src = pkt["ip.src"].get<std::string>();
-  std::string cur_dst = pkt["ip.dst"].get<std::string>();
+  std::string cur_src = pkt["ip.src"];
+  std::string cur_dst = pkt["ip.dst"];
 
   // if IPv6 address is given... ;<
   if (cur_src + cur_dst == "") {
@@ -499,13 +641,13 @@ const std::string genKey_flow_directional_ipv4(const nlohmann::json& pkt, std::s
  * protocol); suitable for encrypted traffic analysis for conventional TCP/IP protocol; key string
  * is "srcIP:srcPort,dstIP:dstPort/protocol".
  */
-const std::string genKey_flow_directional_default_5tuple(const nlohmann::json& pkt,
+const std::string genKey_flow_directional_default_5tuple(const fpnt::PktRef& pkt,
                                                          std::string& granularity,
                                                          std::string& key) {
   std::string cur_key;
 
-  std::string cur_srcport = pkt["tcp.srcport"].get<std::string>();
-  std::string cur_dstport = pkt["tcp.dstport"].get<std::string>();
+  std::string cur_srcport = pkt["tcp.srcport"];
+  std::string cur_dstport = pkt["tcp.dstport"];
 
   // Support for Protocol Name
   std::string protocol_name = "TCP";
@@ -517,13 +659,13 @@ const std::string genKey_flow_directional_default_5tuple(const nlohmann::json& p
     // user to check fpnt is correctly configured. However, in some cases, UDP port information
     // might be missing, especially when analyzing certain types of traffic. To this end, we will
     // set both ports to "0" when they are missing.
-    if (pkt["udp.srcport"].is_null() || pkt["udp.dstport"].is_null()) {
+    if (!pkt.contains("udp.srcport") || !pkt.contains("udp.dstport")) {
       cur_srcport = "0";
       cur_dstport = "0";
     }
 
-    cur_srcport = pkt["udp.srcport"].get<std::string>();
-    cur_dstport = pkt["udp.dstport"].get<std::string>();
+    cur_srcport = pkt["udp.srcport"];
+    cur_dstport = pkt["udp.dstport"];
 
     if (cur_srcport.compare("") == 0 || cur_dstport.compare("") == 0) {
       protocol_name = "etc";
@@ -535,8 +677,8 @@ const std::string genKey_flow_directional_default_5tuple(const nlohmann::json& p
 
   // end of Support for Protocol Name
 
-  std::string cur_src = pkt["_ws.col.def_src"].get<std::string>();
-  std::string cur_dst = pkt["_ws.col.def_dst"].get<std::string>();
+  std::string cur_src = pkt["_ws.col.def_src"];
+  std::string cur_dst = pkt["_ws.col.def_dst"];
 
   // fix a bug in tshark
   // sometimes, ip.src or ip.dst can have unexpected comma due to a bug in tshark. we will use the
@@ -555,10 +697,10 @@ const std::string genKey_flow_directional_default_5tuple(const nlohmann::json& p
     cur_dst = cur_dst.substr(0, l);
   }
 
-  std::string ip_proto = pkt["ip.proto"].get<std::string>();
+  std::string ip_proto = pkt["ip.proto"];
 
   if (ip_proto.compare("") == 0) {
-    std::string ipv6_nxt = pkt["ipv6.nxt"].get<std::string>();
+    std::string ipv6_nxt = pkt["ipv6.nxt"];
     ip_proto = ipv6_nxt;
   }
 
@@ -574,12 +716,12 @@ const std::string genKey_flow_directional_default_5tuple(const nlohmann::json& p
  * IPv4 traffic analysis only; key string is "srcIP:srcPort,dstIP:dstPort".
  * non-IPv4 packets will have flow key string "{file_idx}_NonIPv4".
  */
-const std::string genKey_flow_directional_ipv4_5tuple(const nlohmann::json& pkt,
+const std::string genKey_flow_directional_ipv4_5tuple(const fpnt::PktRef& pkt,
                                                       std::string& granularity, std::string& key) {
   std::string cur_key;
 
-  std::string cur_srcport = pkt["tcp.srcport"].get<std::string>();
-  std::string cur_dstport = pkt["tcp.dstport"].get<std::string>();
+  std::string cur_srcport = pkt["tcp.srcport"];
+  std::string cur_dstport = pkt["tcp.dstport"];
 
   // Support for Protocol Name
   std::string protocol_name = "TCP";
@@ -589,7 +731,7 @@ const std::string genKey_flow_directional_ipv4_5tuple(const nlohmann::json& pkt,
 
     // When udp.srcport or udp.dstport is null, it was treated as an error to indicate user to check
     // fpnt is correctly configured.
-    if (pkt["udp.srcport"].is_null() || pkt["udp.dstport"].is_null()) {
+    if (!pkt.contains("udp.srcport") || !pkt.contains("udp.dstport")) {
       std::cerr << "getPktKey: the corresponding input json does not collect udp.srcport and/or "
                    "udp.dstport."
                 << std::endl;
@@ -599,8 +741,8 @@ const std::string genKey_flow_directional_ipv4_5tuple(const nlohmann::json& pkt,
       exit(EXIT_FAILURE);
     }
 
-    cur_srcport = pkt["udp.srcport"].get<std::string>();
-    cur_dstport = pkt["udp.dstport"].get<std::string>();
+    cur_srcport = pkt["udp.srcport"];
+    cur_dstport = pkt["udp.dstport"];
 
     if (cur_srcport.compare("") == 0 || cur_dstport.compare("") == 0) {
       protocol_name = "etc";
@@ -612,8 +754,8 @@ const std::string genKey_flow_directional_ipv4_5tuple(const nlohmann::json& pkt,
 
   // end of Support for Protocol Name
 
-  std::string cur_src = pkt["ip.src"].get<std::string>();
-  std::string cur_dst = pkt["ip.dst"].get<std::string>();
+  std::string cur_src = pkt["ip.src"];
+  std::string cur_dst = pkt["ip.dst"];
 
   // if IPv6 address is given... ;<
   if (cur_src + cur_dst == "") {
@@ -638,10 +780,10 @@ const std::string genKey_flow_directional_ipv4_5tuple(const nlohmann::json& pkt,
     cur_dst = cur_dst.substr(0, l);
   }
 
-  std::string ip_proto = pkt["ip.proto"].get<std::string>();
+  std::string ip_proto = pkt["ip.proto"];
 
   if (ip_proto.compare("") == 0) {
-    std::string ipv6_nxt = pkt["ipv6.nxt"].get<std::string>();
+    std::string ipv6_nxt = pkt["ipv6.nxt"];
     ip_proto = ipv6_nxt;
   }
 
@@ -657,12 +799,12 @@ const std::string genKey_flow_directional_ipv4_5tuple(const nlohmann::json& pkt,
  * appeared first
  *
  */
-const std::string genKey_flowset_default(const nlohmann::json& pkt, std::string& granularity,
+const std::string genKey_flowset_default(const fpnt::PktRef& pkt, std::string& granularity,
                                          std::string& key) {
   std::string cur_key;
 
-  std::string cur_src = pkt["_ws.col.def_src"].get<std::string>();
-  std::string cur_dst = pkt["_ws.col.def_dst"].get<std::string>();
+  std::string cur_src = pkt["_ws.col.def_src"];
+  std::string cur_dst = pkt["_ws.col.def_dst"];
 
   // fix a bug in tshark
   // sometimes, ip.src or ip.dst can have unexpected comma due to a bug in tshark. we will use the
@@ -714,12 +856,12 @@ const std::string genKey_flowset_default(const nlohmann::json& pkt, std::string&
  * analysis such as TLS or QUIC; note that the host with smaller IP address is appeared first;
  * non-IPv4 packets will have flow key string "{file_idx}_NonIPv4".
  */
-const std::string genKey_flowset_ipv4(const nlohmann::json& pkt, std::string& granularity,
+const std::string genKey_flowset_ipv4(const fpnt::PktRef& pkt, std::string& granularity,
                                       std::string& key) {
   std::string cur_key;
 
-  std::string cur_src = pkt["ip.src"].get<std::string>();
-  std::string cur_dst = pkt["ip.dst"].get<std::string>();
+  std::string cur_src = pkt["ip.src"];
+  std::string cur_dst = pkt["ip.dst"];
 
   // if NonIPv4 address is given... ;<
   if (cur_src + cur_dst == "") {
@@ -761,13 +903,12 @@ const std::string genKey_flowset_ipv4(const nlohmann::json& pkt, std::string& gr
  * 802.11 frame
  *
  */
-const std::string genKey_pkt_cbr(const nlohmann::json& pkt, std::string& granularity,
+const std::string genKey_pkt_cbr(const fpnt::PktRef& pkt, std::string& granularity,
                                  std::string& key) {
-  return std::to_string(pkt["idx"].get<size_t>()) + "_" + pkt["wlan.ra"].get<std::string>() + "_"
-         + pkt["wlan.ta"].get<std::string>();
+  return std::to_string(pkt.idx()) + "_" + pkt["wlan.ra"] + "_" + pkt["wlan.ta"];
 }
 
-const std::string genKey_protocol_default(const nlohmann::json& pkt, std::string& granularity,
+const std::string genKey_protocol_default(const fpnt::PktRef& pkt, std::string& granularity,
                                           std::string& key) {
-  return pkt["_ws.col.protocol"].get<std::string>();
+  return pkt["_ws.col.protocol"];
 }
\ No newline at end of file
@@ -1,36 +1,54 @@
 #pragma once
+#include <fpnt/flow_index.h>
 #include <fpnt/mapper.h>
+#include <fpnt/pkt_table.h>
 
 #include <csv.hpp>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <utility>
 
-extern "C" const std::string genKey_pkt_default(const nlohmann::json& pkt, std::string&,
+extern "C" const std::string genKey_pkt_default(const fpnt::PktRef& pkt, std::string&,
                                                 std::string&);
-extern "C" const std::string genKey_flow_default(const nlohmann::json& pkt, std::string&,
+extern "C" const std::string genKey_flow_default(const fpnt::PktRef& pkt, std::string&,
                                                  std::string&);
-extern "C" const std::string genKey_flowset_default(const nlohmann::json& pkt, std::string&,
+extern "C" const std::string genKey_flowset_default(const fpnt::PktRef& pkt, std::string&,
                                                     std::string&);
-extern "C" const std::string genKey_flow_directional(const nlohmann::json& pkt,
+extern "C" const std::string genKey_flow_directional(const fpnt::PktRef& pkt,
                                                      std::string& granularity, std::string& key);
-extern "C" const std::string genKey_flow_default_5tuple(const nlohmann::json& pkt, std::string&,
+extern "C" const std::string genKey_flow_default_5tuple(const fpnt::PktRef& pkt, std::string&,
                                                         std::string&);
-extern "C" const std::string genKey_flow_directional_default_5tuple(const nlohmann::json& pkt,
+extern "C" const std::string genKey_flow_directional_default_5tuple(const fpnt::PktRef& pkt,
                                                                     std::string& granularity,
                                                                     std::string& key);
 
-extern "C" const std::string genKey_flow_ipv4(const nlohmann::json& pkt, std::string&,
-                                              std::string&);
-extern "C" const std::string genKey_flowset_ipv4(const nlohmann::json& pkt, std::string&,
+extern "C" const std::string genKey_flow_ipv4(const fpnt::PktRef& pkt, std::string&, std::string&);
+
+// key generators with direction: dir is 1 if the source of the packet is the first endpoint of
+// the key, -1 if it is the second one, and 0 if unknown (see Dispatcher::process_base)
+extern "C" const std::string genKey_flow_default_dir(const fpnt::PktRef& pkt, std::string&,
+                                                     std::string&, int& dir);
+extern "C" const std::string genKey_flow_default_5tuple_dir(const fpnt::PktRef& pkt, std::string&,
+                                                            std::string&, int& dir);
+extern "C" const std::string genKey_flow_ipv4_dir(const fpnt::PktRef& pkt, std::string&,
+                                                  std::string&, int& dir);
+
+// tuple key generators: the binary keys of the key generators above (see fpnt/flow_index.h)
+extern "C" bool genKey_flow_default_tuple(const fpnt::PktRef& pkt, std::string&,
+                                          fpnt::FlowTuple& tuple, int& dir);
+extern "C" bool genKey_flow_default_5tuple_tuple(const fpnt::PktRef& pkt, std::string&,
+                                                 fpnt::FlowTuple& tuple, int& dir);
+extern "C" bool genKey_flow_ipv4_tuple(const fpnt::PktRef& pkt, std::string&,
+                                       fpnt::FlowTuple& tuple, int& dir);
+extern "C" const std::string genKey_flowset_ipv4(const fpnt::PktRef& pkt, std::string&,
                                                  std::string&);
-extern "C" const std::string genKey_flow_directional_ipv4(const nlohmann::json& pkt,
+extern "C" const std::string genKey_flow_directional_ipv4(const fpnt::PktRef& pkt,
                                                           std::string& granularity,
                                                           std::string& key);
-extern "C" const std::string genKey_flow_directional_ipv4_5tuple(const nlohmann::json& pkt,
+extern "C" const std::string genKey_flow_directional_ipv4_5tuple(const fpnt::PktRef& pkt,
                                                                  std::string& granularity,
                                                                  std::string& key);
 
-extern "C" const std::string genKey_pkt_cbr(const nlohmann::json& pkt, std::string&, std::string&);
-extern "C" const std::string genKey_protocol_default(const nlohmann::json& pkt,
+extern "C" const std::string genKey_pkt_cbr(const fpnt::PktRef& pkt, std::string&, std::string&);
+extern "C" const std::string genKey_protocol_default(const fpnt::PktRef& pkt,
                                                      std::string& granularity, std::string& key);
\ No newline at end of file
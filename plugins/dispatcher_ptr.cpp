@@ -4,81 +4,56 @@ namespace fpnt {
 
   fpnt::Dispatcher *d;
 
+  // the record access of the plugins goes through the dispatcher (see Dispatcher::out)
   size_t get_idx(std::string key, std::string from, std::string to) {  // v0.3
-    nlohmann::json *cnt_obj = &d->out[from][key];
-    if (to == "eq" || from == to) {
-      return (*cnt_obj)["__" + to + "_idx"].get<size_t>();
-    }
-
-    // chk_get_valid(from, to); not needed
-    if (d->g_lv_idx[from] > d->g_lv_idx[to]) {
-      std::cerr << "please use get_idxs to access lower granuality records!" << std::endl;
-      exit(1);
-    }
-
-    // now g_lv_idx[from] < g_lv_idx[to]
-    return (*cnt_obj)["__" + to + "_idx"].get<size_t>();
+    return d->get_idx(key, from, to);
   }
 
-  /*
-   */
   std::string get_key(std::string key, std::string from, std::string to) {  // v0.3
-    nlohmann::json *cnt_obj = &d->out[from][key];
-    if (to == "eq" || from == to) {
-      return (*cnt_obj)["__" + to + "_key"].get<std::string>();
-    }
-
-    // chk_get_valid(from, to); not needed
-    if (d->g_lv_idx[from] > d->g_lv_idx[to]) {
-      std::cerr << "please use get_idxs to access lower granuality records!" << std::endl;
-      exit(1);
-    }
-
-    // now g_lv_idx[from] < g_lv_idx[to]
-    return (*cnt_obj)["__" + to + "_key"].get<std::string>();
+    return d->get_key(key, from, to);
   }
 
   std::vector<size_t> get_idxs(std::string key, std::string from,
                                std::string to) {  // v0.3
-    if (d->g_lv_idx[from] <= d->g_lv_idx[to]) {
-      std::cerr << "please use get_idx to access higher granuality records!" << std::endl;
-      exit(1);
-    }
-
-    // g_lv_idx[from] > g_lv_idx[to]
-    std::vector<size_t> result;
-    std::vector<std::string> cnt_child_keys = d->out_child_keys[from][key];
-    for (auto &x : cnt_child_keys) {
-      if (d->g_lv_idx[from] == d->g_lv_idx[to] + 1) {
-        result.push_back(d->out_key2idx[to][x]);
-      } else {
-        std::vector<std::size_t> child_result = get_idxs(x, d->g_lvs[d->g_lv_idx[from] - 1], to);
-        result.insert(result.end(), child_result.begin(), child_result.end());
-      }
-    }
+    return d->get_idxs(key, from, to);
+  }
 
-    return result;
+  std::span<const uint32_t> get_idx_span(const std::string &key, const std::string &from,
+                                         const std::string &to) {
+    return d->get_idx_span(key, from, to);
   }
 
   std::vector<std::string> get_keys(std::string key, std::string from,
                                     std::string to) {  // v0.3
-    if (d->g_lv_idx[from] <= d->g_lv_idx[to]) {
-      std::cerr << "please use get_idx to access higher granuality records!" << std::endl;
-      exit(1);
-    }
+    return d->get_keys(key, from, to);
+  }
+
+  std::string child_granularity(const std::string &granularity) {
+    size_t lv = d->get_lv(granularity);
+    return lv == 0 ? "" : d->g_lvs[lv - 1];
+  }
+
+  const RecordTable &records(const std::string &granularity) {
+    return d->get_records(granularity);
+  }
+
+  const nlohmann::json *get_value(const nlohmann::json &record, const std::string &field) {
+    auto it = record.find(field);
+    return (it == record.end() || it->is_null()) ? nullptr : &*it;
+  }
+
+  const std::string *record_key(const nlohmann::json &record, const std::string &granularity) {
+    auto it = record.find("__" + granularity + "_idx");
+    if (it == record.end() || !it->is_number_unsigned()) return nullptr;
+    auto records = d->out.find(granularity);
+    if (records == d->out.end() || it->get<size_t>() >= records->second.size()) return nullptr;
+    return &records->second.key(it->get<size_t>());
+  }
 
-    // g_lv_idx[from] > g_lv_idx[to]
-    std::vector<std::string> result;
-    std::vector<std::string> cnt_child_keys = d->out_child_keys[from][key];
-    for (auto &x : cnt_child_keys) {
-      if (d->g_lv_idx[from] == d->g_lv_idx[to] + 1) {
-        result.push_back(x);
-      } else {
-        std::vector<std::string> child_result = get_keys(x, d->g_lvs[d->g_lv_idx[from] - 1], to);
-        result.insert(result.end(), child_result.begin(), child_result.end());
-      }
-    }
-    return result;
+  long long child_dir(const nlohmann::json &child, const std::string &dir_field) {
+    auto it = child.find(dir_field);
+    if (it == child.end()) it = child.find("__dir");
+    return (it == child.end() || it->is_null()) ? 0 : toInt(*it);
   }
 
 }  // namespace fpnt
\ No newline at end of file
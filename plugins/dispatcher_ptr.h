@@ -2,10 +2,45 @@
 
 #include <fpnt/dispatcher.h>
 
+// FPNT_THREADSAFE(P_x) declares that P_x only reads other records (and the input packets) and
+// writes the current record, so that the records of a granularity can be processed by several
+// threads (see process_threads in config.json); it exports the marker function P_x_threadsafe
+#define FPNT_THREADSAFE(fn) extern "C" void fn##_threadsafe() {}
+
+// FPNT_REFS(P_x, g) exports P_x_refs declaring that P_x reads the field named by its option from
+// the records of granularity g (an expression over granularity, e.g., "pkt" or
+// fpnt::child_granularity(granularity)); FPNT_NO_REFS(P_x) declares that P_x reads no output
+// field. Functions with other references define P_x_refs themselves (see fpnt/loader.h).
+#define FPNT_REFS(fn, g)                                                               \
+  extern "C" void fn##_refs(const std::string& option, const std::string& granularity, \
+                            std::vector<std::pair<std::string, std::string>>& refs) {  \
+    refs.emplace_back(g, option);                                                      \
+  }
+#define FPNT_NO_REFS(fn)                                            \
+  extern "C" void fn##_refs(const std::string&, const std::string&, \
+                            std::vector<std::pair<std::string, std::string>>&) {}
+
 namespace fpnt {
   extern "C" fpnt::Dispatcher *d;
   size_t get_idx(std::string key, std::string from, std::string to);
   std::string get_key(std::string key, std::string from, std::string to);
   std::vector<size_t> get_idxs(std::string key, std::string from, std::string to);
+  // the IDs of get_idxs without a copy (see Dispatcher::get_idx_span)
+  std::span<const uint32_t> get_idx_span(const std::string& key, const std::string& from,
+                                         const std::string& to);
   std::vector<std::string> get_keys(std::string key, std::string from, std::string to);
+  std::string child_granularity(const std::string& granularity);  // "" for the lowest one
+  // the records of the granularity, read-only; thread-safe functions read other records (e.g.,
+  // the children) only through it, since RecordTable and nlohmann::json add a missing key or
+  // field on a non-const access
+  const RecordTable& records(const std::string& granularity);
+  // the field of a record; nullptr if it is absent or null
+  const nlohmann::json* get_value(const nlohmann::json& record, const std::string& field);
+  // the key of the record of the granularity that a record has the ID of in __<granularity>_idx
+  // (its own record or a parent record); nullptr if not available
+  const std::string* record_key(const nlohmann::json& record, const std::string& granularity);
+  // the direction (1, -1 or 0) of a packet (child) record in a record of the granularity: the
+  // __<granularity>_dir field (dir_field) written if its key generator has a direction (see
+  // genKey_x_dir in fpnt/loader.h), otherwise __dir written by P_dir; 0 if neither is available
+  long long child_dir(const nlohmann::json& child, const std::string& dir_field);
 }  // namespace fpnt
\ No newline at end of file
@@ -16,7 +16,7 @@ extern "C" void P_debug(std::string& option, nlohmann::json& record, const std::
     return;
   }
 
-  std::cout << "field (value) : " << record[field].get<std::string>() << "\t";
+  std::cout << "field (value) : " << fpnt::formatValue(record[field]) << "\t";
   std::cout << "field (value; without get) : " << record[field] << "\t";
   std::cout << "Option: " << option << "\t";
   std::cout << "Out Record: " << record.dump() << "\t";
@@ -31,12 +31,12 @@ extern "C" void P_debug(std::string& option, nlohmann::json& record, const std::
   }
   std::cout << "In Packet Index (idx): " << std::to_string(record["__in_idx"].get<size_t>())
             << std::endl;
-  std::cout << "Out Index (idx): " << std::to_string(fpnt::d->out_key2idx[granularity][key])
+  std::cout << "Out Index (idx): " << std::to_string(fpnt::d->out[granularity].id(key))
             << std::endl;
   std::cout << "Dispatcher pointer: " << fpnt::d << std::endl;
   std::cout << "Dispatcher in_pkts size: " << fpnt::d->in_pkts.size() << std::endl;
-  std::cout << "Accessing in_pkts using idx: " << fpnt::d->in_pkts[record["__in_idx"]].dump()
-            << std::endl;
+  std::cout << "Accessing in_pkts using idx: "
+            << fpnt::d->in_pkts.dump(record["__in_idx"].get<size_t>()).dump() << std::endl;
 }
 
 extern "C" void P_cpy(std::string& option, nlohmann::json& record, const std::string& granularity,
@@ -53,10 +53,23 @@ extern "C" void P_cpy(std::string& option, nlohmann::json& record, const std::st
   if (fieldname == "") fieldname = field;
 
   const size_t idx = record["__in_idx"].get<size_t>();
-  if (fpnt::d->in_pkts[idx][fieldname].is_null())
-    record[field] = "";
-  else
-    record[field] = fpnt::d->in_pkts[idx][fieldname].get<std::string>();
+  record[field] = fpnt::d->in_pkts.str(idx, fieldname);  // "" if the field is absent
+}
+FPNT_THREADSAFE(P_cpy)
+FPNT_NO_REFS(P_cpy)
+
+// batch interface: the input column is looked up once for all the given records
+extern "C" void P_cpy_batch(void* state, const std::string& option, std::string& granularity,
+                            size_t first_idx, size_t count, nlohmann::json* const* records,
+                            const std::string& field) {
+  const std::string& fieldname = (option == "") ? field : option;
+  const size_t col = fpnt::d->in_pkts.col(fieldname);
+
+  for (size_t i = 0; i < count; i++) {
+    nlohmann::json& record = *records[i];
+    const size_t idx = record["__in_idx"].get<size_t>();
+    record[field] = (col == (size_t)-1) ? "" : fpnt::d->in_pkts.str(idx, col);
+  }
 }
 
 extern "C" void P_move(std::string& option, nlohmann::json& record, const std::string& granularity,
@@ -64,41 +77,55 @@ extern "C" void P_move(std::string& option, nlohmann::json& record, const std::s
   // if no option, the given fieldname is assumed to be the same as in the input field.
   std::string fieldname = option;
   if (fieldname == "") fieldname = field;
+  // since in_pkts is a packet table, there is nothing to be moved; it is the same as P_cpy
   const size_t idx = record["__in_idx"];
-  record[field] = std::move(fpnt::d->in_pkts[idx][fieldname]);
+  record[field] = fpnt::d->in_pkts.str(idx, fieldname);
 }
+FPNT_THREADSAFE(P_move)
+FPNT_NO_REFS(P_move)
 
-extern "C" void P_diff_d(std::string& option, nlohmann::json& record,
-                         const std::string& granularity, const std::string& key,
-                         const std::string& field) {
-  // parsing
+/** P_diff_d: record[end_key] - record[start_key] as double, where option is "start_key:end_key".
+ * The option is parsed once by P_diff_d_init (ABI v2).
+ */
+struct DiffState {
   std::string start_key;
   std::string end_key;
+};
+
+extern "C" void* P_diff_d_init(const std::string& option) {
   size_t colon_pos = option.find(':');
 
   if (colon_pos == std::string::npos) {
     throw std::invalid_argument("Option string must be in 'start_key:end_key' format.");
   }
 
-  start_key = option.substr(0, colon_pos);
-  end_key = option.substr(colon_pos + 1);
+  return new DiffState{option.substr(0, colon_pos), option.substr(colon_pos + 1)};
+}
+
+extern "C" void P_diff_d_destroy(void* state) { delete (DiffState*)state; }
+
+extern "C" void P_diff_d(void* state, nlohmann::json& record, const std::string& granularity,
+                         const std::string& key, const std::string& field) {
+  const std::string& start_key = ((DiffState*)state)->start_key;
+  const std::string& end_key = ((DiffState*)state)->end_key;
 
   // error check
-  if (record.find(start_key) == record.end() || record.find(end_key) == record.end()) {
+  auto start_it = record.find(start_key);
+  auto end_it = record.find(end_key);
+  if (start_it == record.end() || end_it == record.end()) {
     throw std::runtime_error("One or both keys (" + start_key + ", " + end_key
                              + ") not found in record map.");
   }
 
-  const std::string start_str = record[start_key].get<std::string>();
-  const std::string end_str = record[end_key].get<std::string>();
-
-  // 3. Convert string to double
+  // 3. Convert to double (typed columns already hold numbers)
   double start_time;
   double end_time;
 
   try {
-    start_time = std::stod(start_str);
-    end_time = std::stod(end_str);
+    start_time = start_it->is_number() ? start_it->get<double>()
+                                       : std::stod(start_it->get_ref<const std::string&>());
+    end_time = end_it->is_number() ? end_it->get<double>()
+                                   : std::stod(end_it->get_ref<const std::string&>());
   } catch (const std::exception& e) {
     throw std::runtime_error("Failed to convert one or both values to double: "
                              + std::string(e.what()));
@@ -107,8 +134,16 @@ extern "C" void P_diff_d(std::string& option, nlohmann::json& record,
   // 4. Calculate time difference: end_time - start_time
   double difference = end_time - start_time;
 
-  // 5. Convert result to string and save to record[field]
-  record[field] = std::to_string(difference);
+  // 5. Save the result to record[field]; it is formatted by the writer
+  record[field] = difference;
+}
+FPNT_THREADSAFE(P_diff_d)
+
+extern "C" void P_diff_d_refs(const std::string& option, const std::string& granularity,
+                              std::vector<std::pair<std::string, std::string>>& refs) {
+  size_t colon_pos = option.find(':');
+  refs.emplace_back(granularity, option.substr(0, colon_pos));
+  if (colon_pos != std::string::npos) refs.emplace_back(granularity, option.substr(colon_pos + 1));
 }
 
 /**
@@ -120,20 +155,20 @@ extern "C" void P_childagg(std::string& option, nlohmann::json& record,
                            const std::string& field) {
   // option contains out_pkt field name
   // idx contains flow idx
-  std::string result = "";
-  bool first = true;
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    if (first) {
-      first = false;
-    } else {
-      result += ",";
-    }
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (!cnt[option].is_null()) result += cnt[option].get<std::string>();
+  // the sequence is an array of the child values (see fpnt/value.h)
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  const auto child_ids = fpnt::get_idx_span(key, granularity, child_g);
+  nlohmann::json result = nlohmann::json::array();
+  result.get_ref<nlohmann::json::array_t&>().reserve(child_ids.size());
+  for (uint32_t child_id : child_ids) {
+    const nlohmann::json* value = fpnt::get_value(children[child_id], option);
+    result.push_back(value ? *value : nlohmann::json(""));
   }
-  record[field] = result;
+  record[field] = std::move(result);
 }
+FPNT_THREADSAFE(P_childagg)
+FPNT_REFS(P_childagg, fpnt::child_granularity(granularity))
 
 /**
  * @brief Packet field aggregation for flow, with skipping empty fields
@@ -144,23 +179,17 @@ extern "C" void P_skipchildagg(std::string& option, nlohmann::json& record,
                                const std::string& field) {
   // option contains out_pkt field name
   // idx contains flow idx
-  std::string result = "";
-  bool first = true;
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (!cnt[option].is_null() && cnt[option] != "") {
-      if (first) {
-        first = false;
-      } else {
-        result += ",";
-      }
-
-      result += cnt[option].get<std::string>();
-    }
+  nlohmann::json result = nlohmann::json::array();
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  for (uint32_t child_id : fpnt::get_idx_span(key, granularity, child_g)) {
+    const nlohmann::json* value = fpnt::get_value(children[child_id], option);
+    if (value && *value != "") result.push_back(*value);
   }
-  record[field] = result;
+  record[field] = std::move(result);
 }
+FPNT_THREADSAFE(P_skipchildagg)
+FPNT_REFS(P_skipchildagg, fpnt::child_granularity(granularity))
 
 /**
  * @brief Interarrival Time Sequence for Flow
@@ -173,18 +202,19 @@ extern "C" void P_iat(std::string& option, nlohmann::json& record, const std::st
   std::string result = "";
   std::vector<double> arrival_times;
 
-  for (auto& pkt_key : fpnt::get_keys(key, granularity, "pkt")) {
-    nlohmann::json& cnt = fpnt::d->out["pkt"][pkt_key];
-    if (cnt[option].is_null()) {
+  const fpnt::RecordTable& pkts = fpnt::records("pkt");
+  for (uint32_t pkt_id : fpnt::get_idx_span(key, granularity, "pkt")) {
+    const nlohmann::json* value = fpnt::get_value(pkts[pkt_id], option);
+    if (!value) {
       std::cerr << "P_iat4flow: Empty arrival time value!" << std::endl;
       exit(1);
     }
 
-    double cnt_arrival_time = stod(cnt[option].get<std::string>());
+    double cnt_arrival_time = fpnt::toDouble(*value);
     arrival_times.push_back(cnt_arrival_time);
   }
 
-  std::vector<double> iats;
+  nlohmann::json iats = nlohmann::json::array();
   if (arrival_times.size() > 1) {
     for (size_t i = 1; i < arrival_times.size(); ++i) {
       iats.push_back(arrival_times[i] - arrival_times[i - 1]);
@@ -196,11 +226,13 @@ extern "C" void P_iat(std::string& option, nlohmann::json& record, const std::st
     // }
     // std::cout << std::endl;
 
-    record[field] = vectorToString(iats);
+    record[field] = std::move(iats);
   } else {
     record[field] = "";
   }
 }
+FPNT_THREADSAFE(P_iat)
+FPNT_REFS(P_iat, "pkt")
 
 /**
  * @brief Interarrival Time Sequence for Flowset defined in CBSeq
@@ -214,30 +246,32 @@ extern "C" void P_iat_cbseq(std::string& option, nlohmann::json& record,
   std::string result = "";
   std::vector<double> start_times;
 
-  for (auto& flow_key : fpnt::get_keys(key, granularity, "flow")) {
-    nlohmann::json& cnt = fpnt::d->out["flow"][flow_key];
-    // std::cout << "flowkey: " << flow_key << std::endl;
+  const fpnt::RecordTable& flows = fpnt::records("flow");
+  for (uint32_t flow_id : fpnt::get_idx_span(key, granularity, "flow")) {
+    const nlohmann::json* value = fpnt::get_value(flows[flow_id], option);
+    // std::cout << "flowid: " << flow_id << std::endl;
     // std::cout << "option: " << option << std::endl;
-    // std::cout << "field: " << cnt[option].get<std::string>() << std::endl;
-    if (cnt[option].is_null()) {
+    if (!value) {
       std::cerr << "P_iat_cbseq: Empty arrival time value!" << std::endl;
       exit(1);
     }
 
-    double cnt_start_time = stod(cnt[option].get<std::string>());
+    double cnt_start_time = fpnt::toDouble(*value);
     start_times.push_back(cnt_start_time);
   }
 
-  std::vector<double> iats;
-  iats.push_back(0);
+  nlohmann::json iats = nlohmann::json::array();
+  iats.push_back(0.0);
   if (start_times.size() > 1) {
     for (size_t i = 1; i < start_times.size(); ++i) {
       iats.push_back(start_times[i] - start_times[i - 1]);
     }
   }
 
-  record[field] = vectorToString(iats);
+  record[field] = std::move(iats);
 }
+FPNT_THREADSAFE(P_iat_cbseq)
+FPNT_REFS(P_iat_cbseq, "flow")
 
 /**
  * @brief Return Child count
@@ -246,8 +280,11 @@ extern "C" void P_iat_cbseq(std::string& option, nlohmann::json& record,
 extern "C" void P_childcount(std::string& option, nlohmann::json& record,
                              const std::string& granularity, const std::string& key,
                              const std::string& field) {
-  record[field] = std::to_string(fpnt::d->out_child_keys[granularity][key].size());
+  record[field]
+      = fpnt::get_idx_span(key, granularity, fpnt::child_granularity(granularity)).size();
 }
+FPNT_THREADSAFE(P_childcount)
+FPNT_NO_REFS(P_childcount)
 
 /**
  * @brief Return Child count if the value is true
@@ -260,14 +297,17 @@ extern "C" void P_childcountTrue(std::string& option, nlohmann::json& record,
   // idx contains flow idx
   std::string result = "";
   size_t count = 0;
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (cnt[option] == "True") count++;
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  for (uint32_t child_id : fpnt::get_idx_span(key, granularity, child_g)) {
+    const nlohmann::json* value = fpnt::get_value(children[child_id], option);
+    if (value && *value == "True") count++;
   }
 
-  record[field] = std::to_string(count);
+  record[field] = count;
 }
+FPNT_THREADSAFE(P_childcountTrue)
+FPNT_REFS(P_childcountTrue, fpnt::child_granularity(granularity))
 
 extern "C" void P_childcountFalse(std::string& option, nlohmann::json& record,
                                   const std::string& granularity, const std::string& key,
@@ -276,14 +316,17 @@ extern "C" void P_childcountFalse(std::string& option, nlohmann::json& record,
   // idx contains flow idx
   std::string result = "";
   size_t count = 0;
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (cnt[option] == "False") count++;
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  for (uint32_t child_id : fpnt::get_idx_span(key, granularity, child_g)) {
+    const nlohmann::json* value = fpnt::get_value(children[child_id], option);
+    if (value && *value == "False") count++;
   }
 
-  record[field] = std::to_string(count);
+  record[field] = count;
 }
+FPNT_THREADSAFE(P_childcountFalse)
+FPNT_REFS(P_childcountFalse, fpnt::child_granularity(granularity))
 
 /**
  * @brief Packet count for any granuality (without packet)
@@ -292,8 +335,10 @@ extern "C" void P_childcountFalse(std::string& option, nlohmann::json& record,
 extern "C" void P_pktcount(std::string& option, nlohmann::json& record,
                            const std::string& granularity, const std::string& key,
                            const std::string& field) {
-  record[field] = std::to_string(fpnt::get_keys(key, granularity, "pkt").size());
+  record[field] = fpnt::get_idx_span(key, granularity, "pkt").size();
 }
+FPNT_THREADSAFE(P_pktcount)
+FPNT_NO_REFS(P_pktcount)
 
 /**
  * @brief Packet field aggregation for flowset, without skipping empty fields
@@ -304,19 +349,16 @@ extern "C" void P_pf_agg(std::string& option, nlohmann::json& record,
                          const std::string& field) {
   // option contains out_pkt field name
   // idx contains flow idx
-  std::string result = "";
-  bool first = true;
-  for (auto& pkt_key : fpnt::get_keys(key, granularity, "pkt")) {
-    if (first) {
-      first = false;
-    } else {
-      result += ",";
-    }
-    if (!fpnt::d->out["pkt"][pkt_key][option].is_null())
-      result += fpnt::d->out["pkt"][pkt_key][option].get<std::string>();
+  const fpnt::RecordTable& pkts = fpnt::records("pkt");
+  nlohmann::json result = nlohmann::json::array();
+  for (uint32_t pkt_id : fpnt::get_idx_span(key, granularity, "pkt")) {
+    const nlohmann::json* value = fpnt::get_value(pkts[pkt_id], option);
+    result.push_back(value ? *value : nlohmann::json(""));
   }
-  record[field] = result;
+  record[field] = std::move(result);
 }
+FPNT_THREADSAFE(P_pf_agg)
+FPNT_REFS(P_pf_agg, "pkt")
 
 /**
  * @brief Packet field aggregation for flowset, with skipping empty fields
@@ -327,21 +369,16 @@ extern "C" void P_skip_pf_agg(std::string& option, nlohmann::json& record,
                               const std::string& field) {
   // option contains out_pkt field name
   // idx contains flow idx
-  std::string result = "";
-  bool first = true;
-  for (auto& pkt_key : fpnt::get_keys(key, granularity, "pkt")) {
-    nlohmann::json& cnt = fpnt::d->out["pkt"][pkt_key];
-    if (!cnt[option].is_null() && cnt[option] != "") {
-      if (first) {
-        first = false;
-      } else {
-        result += ",";
-      }
-      result += cnt[option].get<std::string>();
-    }
+  const fpnt::RecordTable& pkts = fpnt::records("pkt");
+  nlohmann::json result = nlohmann::json::array();
+  for (uint32_t pkt_id : fpnt::get_idx_span(key, granularity, "pkt")) {
+    const nlohmann::json* value = fpnt::get_value(pkts[pkt_id], option);
+    if (value && *value != "") result.push_back(*value);
   }
-  record[field] = result;
+  record[field] = std::move(result);
 }
+FPNT_THREADSAFE(P_skip_pf_agg)
+FPNT_REFS(P_skip_pf_agg, "pkt")
 
 /** P_fill1: fill if empty
  *
@@ -349,8 +386,10 @@ extern "C" void P_skip_pf_agg(std::string& option, nlohmann::json& record,
 extern "C" void P_fill1(std::string& option, nlohmann::json& record, const std::string& granularity,
                         const std::string& key, const std::string& field) {
   const size_t idx = record["__in_idx"];
-  if (record[field] == "") record[field] = fpnt::d->in_pkts[idx][option];
+  if (record[field] == "") record[field] = fpnt::d->in_pkts.str(idx, option);
 }
+FPNT_THREADSAFE(P_fill1)
+FPNT_NO_REFS(P_fill1)
 
 /** P_firstcpy4flow: copy the first child's value for flow (typically expecting that the packets in
  * the flow have the same value)
@@ -359,10 +398,14 @@ extern "C" void P_fill1(std::string& option, nlohmann::json& record, const std::
 extern "C" void P_firstcpy(std::string& option, nlohmann::json& record,
                            const std::string& granularity, const std::string& key,
                            const std::string& field) {
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
-  auto& first_child_key = fpnt::d->out_child_keys[granularity][key][0];
-  record[field] = fpnt::d->out[child_g][first_child_key][option];
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  const uint32_t first_child_id = fpnt::get_idx_span(key, granularity, child_g)[0];
+  const nlohmann::json* value = fpnt::get_value(children[first_child_id], option);
+  record[field] = value ? *value : nlohmann::json();
 }
+FPNT_THREADSAFE(P_firstcpy)
+FPNT_REFS(P_firstcpy, fpnt::child_granularity(granularity))
 
 /** P_fillOpt: fill with option value
  *
@@ -372,6 +415,8 @@ extern "C" void P_fillOpt(std::string& option, nlohmann::json& record,
                           const std::string& field) {
   record[field] = option;
 }
+FPNT_THREADSAFE(P_fillOpt)
+FPNT_NO_REFS(P_fillOpt)
 
 /** P_saveKey: save the key corresponding to "option" granularity, of the current record, to the
  * field value Please note this function does not check the availability of such key.
@@ -380,8 +425,11 @@ extern "C" void P_fillOpt(std::string& option, nlohmann::json& record,
 extern "C" void P_saveKey(std::string& option, nlohmann::json& record,
                           const std::string& granularity, const std::string& key,
                           const std::string& field) {
-  record[field] = record["__" + option + "_key"];
+  const std::string* record_key = fpnt::record_key(record, option);
+  if (record_key != nullptr) record[field] = *record_key;
 }
+FPNT_THREADSAFE(P_saveKey)
+FPNT_NO_REFS(P_saveKey)
 
 /** P_saveFlowKey: save the corresponding flow record's key, of the current record, to the field
  * value Please note this function does not check the availability of such key.
@@ -390,8 +438,11 @@ extern "C" void P_saveKey(std::string& option, nlohmann::json& record,
 extern "C" void P_saveFlowKey(std::string& option, nlohmann::json& record,
                               const std::string& granularity, const std::string& key,
                               const std::string& field) {
-  record[field] = record["__flow_key"];
+  const std::string* flow_key = fpnt::record_key(record, "flow");
+  if (flow_key != nullptr) record[field] = *flow_key;
 }
+FPNT_THREADSAFE(P_saveFlowKey)
+FPNT_NO_REFS(P_saveFlowKey)
 
 /** P_saveFlowsetKey: save the corresponding flowset record's key, of the current record, to the
  * field value Please note this function does not check the availability of such key.
@@ -400,8 +451,11 @@ extern "C" void P_saveFlowKey(std::string& option, nlohmann::json& record,
 extern "C" void P_saveFlowsetKey(std::string& option, nlohmann::json& record,
                                  const std::string& granularity, const std::string& key,
                                  const std::string& field) {
-  record[field] = record["__flowset_key"];
+  const std::string* flowset_key = fpnt::record_key(record, "flowset");
+  if (flowset_key != nullptr) record[field] = *flowset_key;
 }
+FPNT_THREADSAFE(P_saveFlowsetKey)
+FPNT_NO_REFS(P_saveFlowsetKey)
 
 /** P_savePktKey: save the corresponding pkt's key, of the current record, to the field value
  * Please note this function does not check the availability of such key, but due to the internal
@@ -411,8 +465,11 @@ extern "C" void P_saveFlowsetKey(std::string& option, nlohmann::json& record,
 extern "C" void P_savePktKey(std::string& option, nlohmann::json& record,
                              const std::string& granularity, const std::string& key,
                              const std::string& field) {
-  record[field] = record["__pkt_key"];
+  const std::string* pkt_key = fpnt::record_key(record, "pkt");
+  if (pkt_key != nullptr) record[field] = *pkt_key;
 }
+FPNT_THREADSAFE(P_savePktKey)
+FPNT_NO_REFS(P_savePktKey)
 
 /** P_saveDir: save the corresponding dir, of the current record, to the field value
  * Please note this function does not check the availability of such key, but due to the internal
@@ -422,7 +479,16 @@ extern "C" void P_savePktKey(std::string& option, nlohmann::json& record,
 extern "C" void P_saveDir(std::string& option, nlohmann::json& record,
                           const std::string& granularity, const std::string& key,
                           const std::string& field) {
-  record[field] = record["__dir"];
+  // __dir is a number (see P_dir); the field keeps the text "+1", "-1" or "0"
+  if (record["__dir"].is_null()) return;
+  const long long dir = fpnt::toInt(record["__dir"]);
+  record[field] = (dir > 0) ? "+1" : (dir < 0) ? "-1" : "0";
+}
+FPNT_THREADSAFE(P_saveDir)
+
+extern "C" void P_saveDir_refs(const std::string& option, const std::string& granularity,
+                               std::vector<std::pair<std::string, std::string>>& refs) {
+  refs.emplace_back(granularity, "__dir");
 }
 
 /** P_dir: calculate packet direction (either +1 or -1) based on genKey_flow_default (a stateless
@@ -433,11 +499,23 @@ extern "C" void P_saveDir(std::string& option, nlohmann::json& record,
  */
 extern "C" void P_dir(std::string& option, nlohmann::json& record, const std::string& granularity,
                       const std::string& key, const std::string& field) {
+  // the direction is stored by a flow key generator with direction (e.g., genKey_flow_default_dir)
+  auto flow_dir = record.find("__flow_dir");
+  if (flow_dir != record.end()) {
+    record["__dir"] = *flow_dir;
+    return;
+  }
+
   const size_t idx = record["__in_idx"];
   // std::cout << record.dump() << std::endl;
-  std::string flow_key = record["__flow_key"].get<std::string>();
+  const std::string* flow_key_ptr = fpnt::record_key(record, "flow");
+  if (flow_key_ptr == nullptr) {
+    record["__dir"] = 0;  // unexpected value
+    return;
+  }
+  const std::string& flow_key = *flow_key_ptr;
 
-  std::string ipsrc = fpnt::d->in_pkts[idx]["_ws.col.def_src"].get<std::string>();
+  std::string ipsrc = fpnt::d->in_pkts.str(idx, "_ws.col.def_src");
 
   size_t l;
   if ((l = ipsrc.find(',')) != std::string::npos) {
@@ -445,7 +523,7 @@ extern "C" void P_dir(std::string& option, nlohmann::json& record, const std::st
   }
 
   if (ipsrc == "") {
-    record["__dir"] = "0";  // unexpected value
+    record["__dir"] = 0;  // unexpected value
     return;
   }
 
@@ -454,30 +532,33 @@ extern "C" void P_dir(std::string& option, nlohmann::json& record, const std::st
   if (ipsrc_first == ipsrc_last) {  // First occurence and last occurence are the same.
                                     // it implies that ipsrc != ipdst
     if (ipsrc_first == 0) {         // this packet's ip.src is firstly located
-      record["__dir"] = "+1";
+      record["__dir"] = 1;
     } else {  // this packet's ip.src is secondly located
-      record["__dir"] = "-1";
+      record["__dir"] = -1;
     }
   } else {  // 'First occurence and last occurence are different' means that this packet is
             // exchanged within the same host.
-    std::string dstport = fpnt::d->in_pkts[idx]["tcp.dstport"];
-    if (fpnt::d->in_pkts[idx]["udp.dstport"] != "") {
-      dstport = fpnt::d->in_pkts[idx]["udp.dstport"];
+    std::string dstport = fpnt::d->in_pkts.str(idx, "tcp.dstport");
+    std::string udp_dstport = fpnt::d->in_pkts.str(idx, "udp.dstport");
+    if (udp_dstport != "") {
+      dstport = udp_dstport;
     }
 
     if (dstport == "") {      // both tcp and udp has empty dstport
-      record["__dir"] = "0";  // unexpected value
+      record["__dir"] = 0;  // unexpected value
       return;
     }
 
     if (flow_key.length() == flow_key.find(dstport) + dstport.length()) {
       // dstport is located in the second
-      record["__dir"] = "+1";
+      record["__dir"] = 1;
     } else {
-      record["__dir"] = "-1";
+      record["__dir"] = -1;
     }
   }
 }
+FPNT_THREADSAFE(P_dir)
+FPNT_NO_REFS(P_dir)  // __dir is not a column (see ExecutionPlan::schedule)
 
 /** P_dir_ipv4: calculate packet direction (either +1 or -1) based on genKey_flow_ipv4 (a stateless
  * flow key generation). That is, the first IP address of the flow key is the smaller one, not the
@@ -488,18 +569,30 @@ extern "C" void P_dir(std::string& option, nlohmann::json& record, const std::st
 extern "C" void P_dir_ipv4(std::string& option, nlohmann::json& record,
                            const std::string& granularity, const std::string& key,
                            const std::string& field) {
+  // the direction is stored by a flow key generator with direction (e.g., genKey_flow_ipv4_dir)
+  auto flow_dir = record.find("__flow_dir");
+  if (flow_dir != record.end()) {
+    record["__dir"] = *flow_dir;
+    return;
+  }
+
   const size_t idx = record["__in_idx"];
   // std::cout << record.dump() << std::endl;
-  std::string flow_key = record["__flow_key"].get<std::string>();
+  const std::string* flow_key_ptr = fpnt::record_key(record, "flow");
+  if (flow_key_ptr == nullptr) {
+    record["__dir"] = 0;  // unexpected value
+    return;
+  }
+  const std::string& flow_key = *flow_key_ptr;
 
   if (flow_key.substr(flow_key.length() - 5, 5) == "_IPv6") {
-    record["__dir"] = "0";  // unexpected value
+    record["__dir"] = 0;  // unexpected value
     return;
   }
 
-  std::string ipsrc = fpnt::d->in_pkts[idx]["ip.src"];
+  std::string ipsrc = fpnt::d->in_pkts.str(idx, "ip.src");
   if (ipsrc == "") {
-    record["__dir"] = "0";  // unexpected value
+    record["__dir"] = 0;  // unexpected value
     return;
   }
 
@@ -508,27 +601,30 @@ extern "C" void P_dir_ipv4(std::string& option, nlohmann::json& record,
   if (ipsrc_first == ipsrc_last) {  // First occurence and last occurence are the same.
                                     // it implies that ipsrc != ipdst
     if (ipsrc_first == 0) {         // this packet's ip.src is firstly located
-      record["__dir"] = "+1";
+      record["__dir"] = 1;
     } else {  // this packet's ip.src is secondly located
-      record["__dir"] = "-1";
+      record["__dir"] = -1;
     }
   } else {  // 'First occurence and last occurence are different' means that this packet is
             // exchanged within the same host.
-    std::string dstport = fpnt::d->in_pkts[idx]["tcp.dstport"];
-    if (fpnt::d->in_pkts[idx]["udp.dstport"] != "") {
-      dstport = fpnt::d->in_pkts[idx]["udp.dstport"];
+    std::string dstport = fpnt::d->in_pkts.str(idx, "tcp.dstport");
+    std::string udp_dstport = fpnt::d->in_pkts.str(idx, "udp.dstport");
+    if (udp_dstport != "") {
+      dstport = udp_dstport;
     }
 
     if (dstport == "") {      // both tcp and udp has empty dstport
-      record["__dir"] = "0";  // unexpected value
+      record["__dir"] = 0;  // unexpected value
       return;
     }
 
     if (flow_key.length() == flow_key.find(dstport) + dstport.length()) {
       // dstport is located in the second
-      record["__dir"] = "+1";
+      record["__dir"] = 1;
     } else {
-      record["__dir"] = "-1";
+      record["__dir"] = -1;
     }
   }
-}
\ No newline at end of file
+}
+FPNT_THREADSAFE(P_dir_ipv4)
+FPNT_NO_REFS(P_dir_ipv4)
\ No newline at end of file
@@ -1,39 +1,59 @@
+#include <charconv>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
 #include <nlohmann/json.hpp>
 #include <regex>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "default_keygen.h"
 #include "dispatcher_ptr.h"
 #include "util_plugins.h"
 
+// a hexadecimal string (with or without 0x) to unsigned int; 0 if it has no hexadecimal digit
+static unsigned int hex2dec(const std::string& hex) {
+  unsigned long long x = strtoull(hex.c_str(), nullptr, 16);
+  return (x > UINT_MAX) ? UINT_MAX : (unsigned int)x;
+}
+
 extern "C" void P_hex2dec(std::string& option, nlohmann::json& record,
                           const std::string& granularity, const std::string& key,
                           const std::string& field) {
-  std::stringstream ss;
-  ss << std::hex << record[field].get<std::string>();
-  unsigned int x;
-  ss >> x;
-  record[field] = std::to_string(x);
+  record[field] = hex2dec(fpnt::formatValue(record[field]));
+}
+FPNT_THREADSAFE(P_hex2dec)
+FPNT_NO_REFS(P_hex2dec)
+
+// batch interface
+extern "C" void P_hex2dec_batch(void* state, const std::string& option, std::string& granularity,
+                                size_t first_idx, size_t count, nlohmann::json* const* records,
+                                const std::string& field) {
+  for (size_t i = 0; i < count; i++) {
+    nlohmann::json& value = (*records[i])[field];
+    value = hex2dec(fpnt::formatValue(value));  // null or a number as P_hex2dec
+  }
 }
 
 extern "C" void P_plus(std::string& option, nlohmann::json& record, const std::string& granularity,
                        const std::string& key, const std::string& field) {
-  std::stringstream ss;
-  ss << record[field].get<std::string>();
-  unsigned int x;
-  ss >> x;
+  unsigned int x = fpnt::toInt(record[field]);  // a number if P_hex2dec is the previous step
   x += std::stoi(option);
 
-  record[field] = std::to_string(x);
+  record[field] = x;
 }
+FPNT_THREADSAFE(P_plus)
+FPNT_NO_REFS(P_plus)
 
 extern "C" void P_cal_no_angles(std::string& option, nlohmann::json& record,
                                 const std::string& granularity, const std::string& key,
                                 const std::string& field) {
-  std::string nc = record["wlan.vht.mimo_control.nc"].get<std::string>();
-  std::string nr = record["wlan.vht.mimo_control.nr"].get<std::string>();
+  std::string nc = fpnt::formatValue(record["wlan.vht.mimo_control.nc"]);
+  std::string nr = fpnt::formatValue(record["wlan.vht.mimo_control.nr"]);
   std::string nr_nc = nr + "_" + nc;
 
   if (nr_nc == "2_1" || nr_nc == "2_2")
@@ -47,11 +67,18 @@ extern "C" void P_cal_no_angles(std::string& option, nlohmann::json& record,
   else if (nr_nc == "4_3" || nr_nc == "4_4")
     record[field] = "12";
 }
+FPNT_THREADSAFE(P_cal_no_angles)
+
+extern "C" void P_cal_no_angles_refs(const std::string& option, const std::string& granularity,
+                                     std::vector<std::pair<std::string, std::string>>& refs) {
+  refs.emplace_back(granularity, "wlan.vht.mimo_control.nc");
+  refs.emplace_back(granularity, "wlan.vht.mimo_control.nr");
+}
 
 extern "C" void P_comma2semicol(std::string& option, nlohmann::json& record,
                                 const std::string& granularity, const std::string& key,
                                 const std::string& field) {
-  std::string no_angles = record[option].get<std::string>();
+  std::string no_angles = fpnt::formatValue(record[option]);
 
   std::stringstream ss;
   unsigned int x;
@@ -72,101 +99,90 @@ extern "C" void P_comma2semicol(std::string& option, nlohmann::json& record,
 
   record[field] = original;
 }
+FPNT_THREADSAFE(P_comma2semicol)
+FPNT_REFS(P_comma2semicol, granularity)
+
+// one "key:value" pair of a subcarrier block in a compressed beamforming report
+struct BfmAngle {
+  long scidx;
+  std::string_view scidx_str;  // e.g., -122
+  std::string_view key;        // e.g., φ11
+  std::string_view value;      // e.g., 41
+};
+
+static std::string_view trim_view(std::string_view str) {
+  const size_t first = str.find_first_not_of(" \t\n\r");
+  if (first == std::string_view::npos) return std::string_view();
+  return str.substr(first, str.find_last_not_of(" \t\n\r") - first + 1);
+}
+
+/** parse_bfm_report splits a report converted by P_comma2semicol, i.e., blocks separated by ";"
+ * consisting of one "scidx," and several "key:value" (e.g., "-122, φ11:41, φ21:34;-121, ..."),
+ * into angles in a single pass without copying; the views refer to report. A pair without a key or
+ * a value is ignored. Returns false if the scidx of a block is not an integer (the block is
+ * skipped).
+ */
+static bool parse_bfm_report(std::string_view report, std::vector<BfmAngle>& angles) {
+  angles.clear();
+  bool valid = true;
+  while (!report.empty()) {
+    const size_t semicolon = report.find(';');
+    std::string_view block = trim_view(report.substr(0, semicolon));
+    report = (semicolon == std::string_view::npos) ? std::string_view()
+                                                   : report.substr(semicolon + 1);
+    if (block.empty()) continue;
+
+    size_t comma = block.find(',');
+    const std::string_view scidx_str = trim_view(block.substr(0, comma));
+    long scidx;
+    const auto [ptr, ec]
+        = std::from_chars(scidx_str.data(), scidx_str.data() + scidx_str.size(), scidx);
+    if (scidx_str.empty() || ec != std::errc()) {
+      valid = false;
+      continue;
+    }
 
-// Helper function: removes leading and trailing whitespace from the string.
-std::string trim2(const std::string& str) {
-  size_t first = str.find_first_not_of(" \t\n\r");
-  if (std::string::npos == first) {
-    return str;
+    while (comma != std::string_view::npos) {
+      block = block.substr(comma + 1);
+      comma = block.find(',');
+      const std::string_view kv_pair = block.substr(0, comma);  // e.g. "φ11:41" " ψ21:6"
+      const size_t colon = kv_pair.find(':');
+      if (colon == std::string_view::npos) continue;  // even if invalid data is available, ignore.
+      const std::string_view param_key = trim_view(kv_pair.substr(0, colon));
+      const std::string_view param_value = trim_view(kv_pair.substr(colon + 1));
+      if (param_key.empty() || param_value.empty()) continue;
+      angles.push_back({scidx, scidx_str, param_key, param_value});
+    }
   }
-  size_t last = str.find_last_not_of(" \t\n\r");
-  return str.substr(first, (last - first + 1));
+  return valid;
 }
 
 extern "C" void P_fast_bfm_fill(std::string& option, nlohmann::json& record,
                                 const std::string& granularity, const std::string& key,
                                 const std::string& field) {
-  std::string original = record[field].get<std::string>();
-  //    std::cout << original << std::endl;
-
-  std::stringstream ss_blocks(original);
-  std::string block;
-
-  // iterate the SCIDX block (e.g., "-122, φ11:41, φ21:34, ...")
-  while (std::getline(ss_blocks, block, ';')) {
-    std::string trimmed_block = trim2(block);
-    if (trimmed_block.empty()) continue;
-
-    // split the parameter block into one SCIDX integer and several key:value pairs.
-    std::stringstream ss_parts(trimmed_block);
-    std::string part;
-
-    std::vector<std::string> parts;
-    while (std::getline(ss_parts, part, ',')) {
-      parts.push_back(trim2(part));
-    }
-
-    if (parts.empty()) continue;
-
-    const std::string scidx_str = parts[0];
-    try {
-      // test whether SCIDX is valid or not
-      std::stoi(scidx_str);
-    } catch (const std::exception& e) {
-      exit(1);
-    }
-
-    // iterate key:value pairs from part[1]
-    for (size_t i = 1; i < parts.size(); ++i) {
-      const std::string& kv_pair = parts[i];  // e.g. "φ11:41" " ψ21:6"
-
-      size_t colon_pos = kv_pair.find(':');
-      if (colon_pos == std::string::npos) {
-        // even if invalid data is available, ignore.
-        continue;
-      }
-
-      // key value extraction
-      std::string param_key = kv_pair.substr(0, colon_pos);
-      std::string param_value_str = kv_pair.substr(colon_pos + 1);
-
-      param_key = trim2(param_key);
-      param_value_str = trim2(param_value_str);
-
-      if (param_key.empty() || param_value_str.empty()) {
-        continue;
-      }
-
-      // int value;
-      // try {
-      //     value = std::stoi(param_value_str);
-      // } catch (const std::exception& e) {
-      //     // even if invalid data is available, ignore.
-      //     continue;
-      // }
-
-      // Create final mapping key: "SCIDX: -122,φ11"
-      std::string final_map_key = "SCIDX: " + scidx_str + "," + param_key;
-
-      // std::cout << "key: " << key << " field " << final_map_key << std::endl;
+  static thread_local std::vector<BfmAngle> angles;
+  if (!parse_bfm_report(record[field].get_ref<const std::string&>(), angles)) {
+    exit(1);  // SCIDX is not valid
+  }
 
-      // 6. Save data
-      // fpnt::d->out["bfm"][key]["SCIDX: -122,φ11"] = 41;
-      fpnt::d->out["bfm"][key][final_map_key] = param_value_str;
-    }
+  nlohmann::json& bfm = fpnt::d->out["bfm"][key];
+  for (auto& angle : angles) {
+    // Create final mapping key: "SCIDX: -122,φ11"
+    std::string final_map_key = "SCIDX: ";
+    final_map_key.append(angle.scidx_str).append(",").append(angle.key);
+    bfm[final_map_key] = std::string(angle.value);
   }
 }
-extern "C" void P_bfm_fill(std::string& option, nlohmann::json& record,
-                           const std::string& granularity, const std::string& key,
-                           const std::string& field) {
-  // std::cout << "P_bfm_find: "  << field << ", " << key << std::endl;
-  const std::string scidx_fieldname = "wlan.vht.compressed_beamforming_report.scidx";
-
-  const std::string& cnt = fpnt::d->out["pkt"][key][scidx_fieldname].get<std::string>();
 
-  // option parsing: extract "SCIDX, Parameter_Name, Index"
-  // for example: option = "-122,phi,11"
+struct BfmFillState {
+  std::regex scidx_block_regex;
+  std::regex param_value_regex;
+};
 
+// option parsing: extract "SCIDX, Parameter_Name, Index" (e.g., option = "-122,phi,11") into the
+// scidx (e.g., -122) and the key to find in the report (e.g., φ11)
+static void parse_bfm_option(const std::string& option, std::string& target_scidx_str,
+                             std::string& target_param_key) {
   std::vector<std::string> option_parts;
   std::stringstream ss(option);
   std::string part;
@@ -183,13 +199,12 @@ extern "C" void P_bfm_fill(std::string& option, nlohmann::json& record,
   // option_parts[1] is parameter name (e.g., phi)
   // option_parts[2] is parameter idx (e.g.: 11)
 
-  const std::string target_scidx_str = option_parts[0];
+  target_scidx_str = option_parts[0];
   const std::string target_param_name = option_parts[1];  // phi or psi
   const std::string target_param_idx = option_parts[2];   // 11, 21, ...
 
   // target_param_key: the key to find in the string 'cnt' (e.g.,: φ11); convert alphabet (phi -> φ,
   // psi -> ψ)
-  std::string target_param_key;
   if (target_param_name == "phi") {  // φ (U+03C6)
     target_param_key = "\u03C6" + target_param_idx;
   } else if (target_param_name == "psi") {  // ψ (U+03C8)
@@ -198,12 +213,31 @@ extern "C" void P_bfm_fill(std::string& option, nlohmann::json& record,
     std::cout << "error 2 " << std::endl;
     exit(1);  // error
   }
+}
+
+// the option is parsed and both regular expressions are compiled once by P_bfm_fill_init (ABI v2)
+extern "C" void* P_bfm_fill_init(const std::string& option) {
+  std::string target_scidx_str, target_param_key;
+  parse_bfm_option(option, target_scidx_str, target_param_key);
 
   // cnt can be split using delimiter ";" and each line consists of one "scidx," and several
   // "key:value". example: ...;-122, φ11:41, φ21:34, ψ21:6, ...;...
+  return new BfmFillState{std::regex("(" + target_scidx_str + ",[\\s]*)(.*?)(;|$)"),
+                          std::regex(target_param_key + ":(\\d+)")};
+}
+
+extern "C" void P_bfm_fill_destroy(void* state) { delete (BfmFillState*)state; }
+
+extern "C" void P_bfm_fill(void* state, nlohmann::json& record, const std::string& granularity,
+                           const std::string& key, const std::string& field) {
+  // std::cout << "P_bfm_find: "  << field << ", " << key << std::endl;
+  const std::string scidx_fieldname = "wlan.vht.compressed_beamforming_report.scidx";
+
+  const nlohmann::json* report = fpnt::get_value(fpnt::records("pkt")[key], scidx_fieldname);
+  const std::string cnt = report ? fpnt::formatValue(*report) : std::string();
 
   // regular expresson to extract
-  std::regex scidx_block_regex("(" + target_scidx_str + ",[\\s]*)(.*?)(;|$)");
+  const std::regex& scidx_block_regex = ((BfmFillState*)state)->scidx_block_regex;
   std::smatch scidx_match;
 
   std::string params_block;
@@ -221,7 +255,7 @@ extern "C" void P_bfm_fill(std::string& option, nlohmann::json& record,
   }
 
   // find target key-value pair from the parameter block
-  std::regex param_value_regex(target_param_key + ":(\\d+)");
+  const std::regex& param_value_regex = ((BfmFillState*)state)->param_value_regex;
   std::smatch value_match;
 
   std::string target_value_str;
@@ -242,4 +276,96 @@ extern "C" void P_bfm_fill(std::string& option, nlohmann::json& record,
     std::cout << "error 5" << std::endl;
     exit(1);  // error
   }
-}
\ No newline at end of file
+}
+FPNT_THREADSAFE(P_bfm_fill)
+
+extern "C" void P_bfm_fill_refs(const std::string& option, const std::string& granularity,
+                                std::vector<std::pair<std::string, std::string>>& refs) {
+  refs.emplace_back("pkt", "wlan.vht.compressed_beamforming_report.scidx");
+}
+
+/** P_bfm_fill_multi computes a block of P_bfm_fill columns (see "^" in README.md) by a single
+ * call: the report is parsed once per frame (see parse_bfm_report), and every field of the block
+ * is looked up by its scidx and key; a field not found in the report is "#N/A" as in P_bfm_fill.
+ */
+struct BfmFillMultiState {
+  // scidx -> (key, index of the field in the block)
+  std::unordered_map<long, std::vector<std::pair<std::string, size_t>>> targets;
+};
+
+extern "C" void* P_bfm_fill_multi_init(const std::vector<std::string>& options) {
+  BfmFillMultiState* state = new BfmFillMultiState;
+  for (size_t i = 0; i < options.size(); i++) {
+    std::string target_scidx_str, target_param_key;
+    parse_bfm_option(options[i], target_scidx_str, target_param_key);
+    long scidx;
+    const std::string_view scidx_str = trim_view(target_scidx_str);
+    const auto [ptr, ec]
+        = std::from_chars(scidx_str.data(), scidx_str.data() + scidx_str.size(), scidx);
+    if (scidx_str.empty() || ec != std::errc()) {
+      std::cout << "error 1 " << std::endl;
+      exit(1);  // error
+    }
+    state->targets[scidx].emplace_back(target_param_key, i);
+  }
+  return state;
+}
+
+extern "C" void P_bfm_fill_multi_destroy(void* state) { delete (BfmFillMultiState*)state; }
+
+// fill the fields of a P_bfm_fill_multi or P_bfm_expand block from the report of the frame; a
+// field not found in the report is set to missing unless it is nullptr
+static void fill_bfm_block(const BfmFillMultiState& s, nlohmann::json& record,
+                           const std::string& key, const std::vector<std::string>& fields,
+                           const char* missing) {
+  static thread_local std::vector<BfmAngle> angles;
+  static thread_local std::vector<char> filled;
+  filled.assign(fields.size(), 0);
+
+  const nlohmann::json* report
+      = fpnt::get_value(fpnt::records("pkt")[key], "wlan.vht.compressed_beamforming_report.scidx");
+  const std::string cnt = report ? fpnt::formatValue(*report) : std::string();
+  parse_bfm_report(cnt, angles);
+  for (auto& angle : angles) {
+    auto targets = s.targets.find(angle.scidx);
+    if (targets == s.targets.end()) continue;
+    for (auto& [param_key, i] : targets->second) {
+      if (filled[i] || param_key != angle.key) continue;
+      record[fields[i]] = std::string(angle.value);
+      filled[i] = 1;
+    }
+  }
+  if (missing == nullptr) return;
+  for (size_t i = 0; i < fields.size(); i++) {
+    if (!filled[i]) record[fields[i]] = missing;
+  }
+}
+
+extern "C" void P_bfm_fill_multi(void* state, const std::vector<std::string>& options,
+                                 nlohmann::json& record, std::string& granularity,
+                                 const std::string& key, const std::vector<std::string>& fields) {
+  fill_bfm_block(*(BfmFillMultiState*)state, record, key, fields, "#N/A");
+}
+
+/** P_bfm_expand fills the "SCIDX: <scidx>,<angle>" columns of config_bfm as a multi-output block
+ * whose options are those of P_bfm_fill (e.g., "-122,phi,11"): the compressed beamforming report
+ * of the frame is parsed once, and a column not found in the report is left empty, as the columns
+ * filled by P_fast_bfm_fill. It has no single-column form.
+ */
+extern "C" void* P_bfm_expand_multi_init(const std::vector<std::string>& options) {
+  return P_bfm_fill_multi_init(options);
+}
+
+extern "C" void P_bfm_expand_multi_destroy(void* state) { delete (BfmFillMultiState*)state; }
+
+extern "C" void P_bfm_expand_multi(void* state, const std::vector<std::string>& options,
+                                   nlohmann::json& record, std::string& granularity,
+                                   const std::string& key, const std::vector<std::string>& fields) {
+  fill_bfm_block(*(BfmFillMultiState*)state, record, key, fields, nullptr);
+}
+FPNT_THREADSAFE(P_bfm_expand)
+
+extern "C" void P_bfm_expand_refs(const std::string& option, const std::string& granularity,
+                                  std::vector<std::pair<std::string, std::string>>& refs) {
+  refs.emplace_back("pkt", "wlan.vht.compressed_beamforming_report.scidx");
+}
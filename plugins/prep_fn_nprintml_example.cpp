@@ -1,7 +1,9 @@
 #include <nlohmann/json.hpp>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "default_keygen.h"
 #include "dispatcher_ptr.h"
@@ -15,9 +17,13 @@
  * "0x001d,0x0017,0x0018", if option is "supported_group,0,6", the result is "0x001d", and if
  *   option is "supported_group,7,13", the result is "0x0017".
  */
-extern "C" void P_getsubstr(std::string& option, nlohmann::json& record,
-                            const std::string& granularity, const std::string& key,
-                            const std::string& field) {
+struct SubstrState {
+  std::string source_field;
+  int start_idx;
+  int end_idx;
+};
+
+static SubstrState parse_substr_option(const std::string& option) {
   size_t first_comma = option.find(',');
   if (first_comma == std::string::npos) {
     std::cerr << "error: invalid option format for P_getsubstr" << std::endl;
@@ -41,37 +47,81 @@ extern "C" void P_getsubstr(std::string& option, nlohmann::json& record,
     exit(1);
   }
 
-  if (record[source_field].is_null()) {
-    record[field] = "";
-    return;
-  }
-
-  std::string val = record[source_field].get<std::string>();
-  if (val.empty()) {
-    record[field] = "";
-    return;
-  }
+  return SubstrState{source_field, start_idx, end_idx};
+}
 
+// val[start_idx, end_idx] clipped to val; "" if the range is empty or out of val
+static std::string substr_by_idx(const std::string& val, int start_idx, int end_idx) {
   if (start_idx < 0) start_idx = 0;
-  if (end_idx < start_idx) {
-    record[field] = "";
-    return;
-  }
+  if (end_idx < start_idx) return "";
 
   size_t start = static_cast<size_t>(start_idx);
   size_t end = static_cast<size_t>(end_idx);
 
-  if (start >= val.length()) {
-    record[field] = "";
-    return;
-  }
+  if (start >= val.length()) return "";
 
   size_t len = end - start + 1;
   if (start + len > val.length()) {
     len = val.length() - start;
   }
 
-  record[field] = val.substr(start, len);
+  return val.substr(start, len);
+}
+
+// the option is parsed once by P_getsubstr_init (ABI v2)
+extern "C" void* P_getsubstr_init(const std::string& option) {
+  return new SubstrState(parse_substr_option(option));
+}
+
+extern "C" void P_getsubstr_destroy(void* state) { delete (SubstrState*)state; }
+
+extern "C" void P_getsubstr(void* state, nlohmann::json& record, const std::string& granularity,
+                            const std::string& key, const std::string& field) {
+  const SubstrState& s = *(SubstrState*)state;
+
+  if (record[s.source_field].is_null()) {
+    record[field] = "";
+    return;
+  }
+
+  record[field] = substr_by_idx(fpnt::formatValue(record[s.source_field]), s.start_idx, s.end_idx);
+}
+FPNT_THREADSAFE(P_getsubstr)
+
+extern "C" void P_getsubstr_refs(const std::string& option, const std::string& granularity,
+                                 std::vector<std::pair<std::string, std::string>>& refs) {
+  refs.emplace_back(granularity, option.substr(0, option.find(',')));
+}
+
+/** P_getsubstr_multi computes a block of P_getsubstr columns (e.g., the nprint-style bytes of a
+ * header, see "^" in README.md) by a single call: a source field is formatted once for the
+ * consecutive columns reading it, instead of once per column.
+ */
+extern "C" void* P_getsubstr_multi_init(const std::vector<std::string>& options) {
+  std::vector<SubstrState>* states = new std::vector<SubstrState>;
+  for (auto& option : options) states->push_back(parse_substr_option(option));
+  return states;
+}
+
+extern "C" void P_getsubstr_multi_destroy(void* state) {
+  delete (std::vector<SubstrState>*)state;
+}
+
+extern "C" void P_getsubstr_multi(void* state, const std::vector<std::string>& options,
+                                  nlohmann::json& record, std::string& granularity,
+                                  const std::string& key, const std::vector<std::string>& fields) {
+  const std::vector<SubstrState>& states = *(std::vector<SubstrState>*)state;
+  const std::string* source_field = nullptr;
+  std::string val;
+  for (size_t i = 0; i < fields.size(); i++) {
+    const SubstrState& s = states[i];
+    if (source_field == nullptr || *source_field != s.source_field) {
+      source_field = &s.source_field;
+      auto it = record.find(s.source_field);
+      val = (it == record.end()) ? "" : fpnt::formatValue(*it);
+    }
+    record[fields[i]] = substr_by_idx(val, s.start_idx, s.end_idx);
+  }
 }
 
 /** P_getsubstr_by_comma retrieves a substring of record[fieldname].get<std::string>() based on the
@@ -83,30 +133,45 @@ extern "C" void P_getsubstr(std::string& option, nlohmann::json& record,
  * "2,11,12,13,14", if option is "handshake_type,0", the result is "2", if option is
  * "handshake_type,1", the result is "11", if option is "handshake_type,5", the result is "".
  */
-extern "C" void P_getsubstr_by_comma(std::string& option, nlohmann::json& record,
-                                     const std::string& granularity, const std::string& key,
-                                     const std::string& field) {
+static void parse_comma_option(const std::string& option, std::string& source_field,
+                               int& target_idx) {
   size_t comma_pos = option.find(',');
   if (comma_pos == std::string::npos) {
     std::cerr << "error: invalid option format for P_getsubstr_by_comma" << std::endl;
     exit(1);
   }
 
-  std::string source_field = option.substr(0, comma_pos);
-  int target_idx;
+  source_field = option.substr(0, comma_pos);
   try {
     target_idx = std::stoi(option.substr(comma_pos + 1));
   } catch (...) {
     std::cerr << "error: invalid index in option for P_getsubstr_by_comma" << std::endl;
     exit(1);
   }
+}
+
+extern "C" void P_getsubstr_by_comma(std::string& option, nlohmann::json& record,
+                                     const std::string& granularity, const std::string& key,
+                                     const std::string& field) {
+  std::string source_field;
+  int target_idx;
+  parse_comma_option(option, source_field, target_idx);
 
   if (record[source_field].is_null()) {
     record[field] = "";
     return;
   }
 
-  std::string val = record[source_field].get<std::string>();
+  // a sequence (see fpnt/value.h) is indexed without being formatted
+  if (record[source_field].is_array()) {
+    const nlohmann::json& seq = record[source_field];
+    record[field] = (target_idx < 0 || (size_t)target_idx >= seq.size())
+                        ? std::string("")
+                        : fpnt::formatValue(seq[target_idx], fpnt::ValueType::TEXT, true);
+    return;
+  }
+
+  std::string val = fpnt::formatValue(record[source_field]);
   if (val.empty() || target_idx < 0) {
     record[field] = "";
     return;
@@ -132,3 +197,62 @@ extern "C" void P_getsubstr_by_comma(std::string& option, nlohmann::json& record
     record[field] = val.substr(start, end - start);
   }
 }
+FPNT_THREADSAFE(P_getsubstr_by_comma)
+
+extern "C" void P_getsubstr_by_comma_refs(const std::string& option,
+                                          const std::string& granularity,
+                                          std::vector<std::pair<std::string, std::string>>& refs) {
+  refs.emplace_back(granularity, option.substr(0, option.find(',')));
+}
+
+/** P_getsubstr_by_comma_multi computes a block of P_getsubstr_by_comma columns (e.g., the
+ * extension types of a TLS handshake, see "^" in README.md) by a single call: a source field is
+ * formatted and split once for the consecutive columns reading it, instead of once per column.
+ */
+struct CommaSubstrState {
+  std::string source_field;
+  int target_idx;
+};
+
+extern "C" void* P_getsubstr_by_comma_multi_init(const std::vector<std::string>& options) {
+  std::vector<CommaSubstrState>* states = new std::vector<CommaSubstrState>(options.size());
+  for (size_t i = 0; i < options.size(); i++) {
+    parse_comma_option(options[i], (*states)[i].source_field, (*states)[i].target_idx);
+  }
+  return states;
+}
+
+extern "C" void P_getsubstr_by_comma_multi_destroy(void* state) {
+  delete (std::vector<CommaSubstrState>*)state;
+}
+
+extern "C" void P_getsubstr_by_comma_multi(void* state, const std::vector<std::string>& options,
+                                           nlohmann::json& record, std::string& granularity,
+                                           const std::string& key,
+                                           const std::vector<std::string>& fields) {
+  const std::vector<CommaSubstrState>& states = *(std::vector<CommaSubstrState>*)state;
+  const std::string* source_field = nullptr;
+  std::string val;
+  std::vector<std::string> parts;  // the substrings of the current source field
+  for (size_t i = 0; i < fields.size(); i++) {
+    const CommaSubstrState& s = states[i];
+    if (source_field == nullptr || *source_field != s.source_field) {
+      source_field = &s.source_field;
+      parts.clear();
+      auto it = record.find(s.source_field);
+      if (it != record.end() && it->is_array()) {
+        for (auto& element : *it) {
+          parts.push_back(fpnt::formatValue(element, fpnt::ValueType::TEXT, true));
+        }
+      } else if (it != record.end() && !(val = fpnt::formatValue(*it)).empty()) {
+        size_t start = 0;
+        for (size_t end; (end = val.find(',', start)) != std::string::npos; start = end + 1) {
+          parts.push_back(val.substr(start, end - start));
+        }
+        parts.push_back(val.substr(start));
+      }
+    }
+    record[fields[i]]
+        = (s.target_idx < 0 || (size_t)s.target_idx >= parts.size()) ? "" : parts[s.target_idx];
+  }
+}
@@ -1,8 +1,12 @@
+#include <algorithm>
+#include <cmath>
 #include <limits>
+#include <map>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "default_keygen.h"
 #include "dispatcher_ptr.h"
@@ -14,9 +18,9 @@
  */
 extern "C" void P_max_d(std::string& option, nlohmann::json& record, const std::string& granularity,
                         const std::string& key, const std::string& field) {
-  nlohmann::json& cnt = fpnt::d->out[granularity][key];
-  std::string vectorString = cnt[option];
-  std::vector<double> values = stringToVector(vectorString);
+  const nlohmann::json* value = fpnt::get_value(record, option);
+  // a sequence or comma-separated text
+  std::vector<double> values = fpnt::toVector(value ? *value : nlohmann::json());
 
   double result = std::numeric_limits<double>::lowest();
   for (const auto& val : values) {
@@ -27,9 +31,11 @@ extern "C" void P_max_d(std::string& option, nlohmann::json& record, const std::
     // No valid values found
     record[field] = "";
   } else {
-    record[field] = std::to_string(result);
+    record[field] = result;
   }
 }
+FPNT_THREADSAFE(P_max_d)
+FPNT_REFS(P_max_d, granularity)
 
 /**
  * @brief Same granularity's field min, assuming double
@@ -37,9 +43,9 @@ extern "C" void P_max_d(std::string& option, nlohmann::json& record, const std::
  */
 extern "C" void P_min_d(std::string& option, nlohmann::json& record, const std::string& granularity,
                         const std::string& key, const std::string& field) {
-  nlohmann::json& cnt = fpnt::d->out[granularity][key];
-  std::string vectorString = cnt[option];
-  std::vector<double> values = stringToVector(vectorString);
+  const nlohmann::json* value = fpnt::get_value(record, option);
+  // a sequence or comma-separated text
+  std::vector<double> values = fpnt::toVector(value ? *value : nlohmann::json());
 
   double result = std::numeric_limits<double>::max();
   for (const auto& val : values) {
@@ -50,22 +56,28 @@ extern "C" void P_min_d(std::string& option, nlohmann::json& record, const std::
     // No valid values found
     record[field] = "";
   } else {
-    record[field] = std::to_string(result);
+    record[field] = result;
   }
 }
+FPNT_THREADSAFE(P_min_d)
+FPNT_REFS(P_min_d, granularity)
 
 /**
  * @brief Child granularity's field sum, skipping empty fields; assuming long long
- *
+ * The option is parsed once by P_childsum_ll_init (ABI v2).
  */
-extern "C" void P_childsum_ll(std::string& option, nlohmann::json& record,
-                              const std::string& granularity, const std::string& key,
-                              const std::string& field) {
+struct ChildSumState {
+  std::string fieldname;
+  bool check_dir;
+  bool dir;
+};
+
+extern "C" void* P_childsum_ll_init(const std::string& option) {
   // option contains out_pkt field name
   // however, postfix '+' or '-' can be possible (assuming that field name does not allow postfix
   // '+' or '-').
-  std::string fieldname = option;
-  bool check_dir, dir;
+  ChildSumState* state = new ChildSumState{option, false, false};
+  std::string& fieldname = state->fieldname;
 
   // check fieldname is empty
   if (fieldname.empty()) {
@@ -76,29 +88,38 @@ extern "C" void P_childsum_ll(std::string& option, nlohmann::json& record,
   char lastChar = fieldname.back();
 
   if (lastChar == '+') {
-    check_dir = true;
-    dir = true;
+    state->check_dir = true;
+    state->dir = true;
     fieldname.pop_back();
   } else if (lastChar == '-') {
-    check_dir = true;
-    dir = false;
+    state->check_dir = true;
+    state->dir = false;
     fieldname.pop_back();
-  } else {  // otherwise
-    check_dir = false;
-    dir = false;
   }
 
+  return state;
+}
+
+extern "C" void P_childsum_ll_destroy(void* state) { delete (ChildSumState*)state; }
+
+extern "C" void P_childsum_ll(void* state, nlohmann::json& record, const std::string& granularity,
+                              const std::string& key, const std::string& field) {
+  const std::string& fieldname = ((ChildSumState*)state)->fieldname;
+  const bool check_dir = ((ChildSumState*)state)->check_dir;
+  const bool dir = ((ChildSumState*)state)->dir;
+
   // idx contains flow idx
   long long result = 0;
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (!cnt[fieldname].is_null()) {
-      std::string val_str = cnt[fieldname].get<std::string>();
-      long long temp = atoll(val_str.c_str());
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  const std::string dir_field = "__" + granularity + "_dir";
+  for (uint32_t child_id : fpnt::get_idx_span(key, granularity, child_g)) {
+    const nlohmann::json& cnt = children[child_id];
+    if (const nlohmann::json* value = fpnt::get_value(cnt, fieldname)) {
+      long long temp = fpnt::toInt(*value);
 
       if (check_dir) {  // we should check direction
-        long long dir_value = atoll(cnt["__dir"].get<std::string>().c_str());
+        long long dir_value = fpnt::child_dir(cnt, dir_field);
         // different direction means no addition
         if (dir && dir_value < 0) {
           temp = 0;
@@ -111,7 +132,19 @@ extern "C" void P_childsum_ll(std::string& option, nlohmann::json& record,
       result += temp;
     }
   }
-  record[field] = std::to_string(result);
+  record[field] = result;
+}
+FPNT_THREADSAFE(P_childsum_ll)
+
+extern "C" void P_childsum_ll_refs(const std::string& option, const std::string& granularity,
+                                   std::vector<std::pair<std::string, std::string>>& refs) {
+  std::string child_g = fpnt::child_granularity(granularity);
+  std::string fieldname = option;
+  if (!fieldname.empty() && (fieldname.back() == '+' || fieldname.back() == '-')) {
+    fieldname.pop_back();
+    refs.emplace_back(child_g, "__dir");
+  }
+  refs.emplace_back(child_g, fieldname);
 }
 
 /**
@@ -124,16 +157,18 @@ extern "C" void P_childsum_d(std::string& option, nlohmann::json& record,
   // option contains out_pkt field name
   // idx contains flow idx
   double result = 0;
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (!cnt[option].is_null()) {
-      std::string val_str = cnt[option].get<std::string>();
-      result += atof(val_str.c_str());
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  for (uint32_t child_id : fpnt::get_idx_span(key, granularity, child_g)) {
+    const nlohmann::json& cnt = children[child_id];
+    if (const nlohmann::json* value = fpnt::get_value(cnt, option)) {
+      result += fpnt::toDouble(*value);
     }
   }
-  record[field] = std::to_string(result);
+  record[field] = result;
 }
+FPNT_THREADSAFE(P_childsum_d)
+FPNT_REFS(P_childsum_d, fpnt::child_granularity(granularity))
 
 /**
  * @brief Child granularity's field aggregation, without skipping empty fields
@@ -145,21 +180,23 @@ extern "C" void P_childmean(std::string& option, nlohmann::json& record,
   // option contains out_pkt field name
   // idx contains flow idx
   double result = 0.0f;
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
   size_t count = 0;
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (!cnt[option].is_null()) {
-      std::string val_str = cnt[option].get<std::string>();
-      result += atof(val_str.c_str());
+  for (uint32_t child_id : fpnt::get_idx_span(key, granularity, child_g)) {
+    const nlohmann::json& cnt = children[child_id];
+    if (const nlohmann::json* value = fpnt::get_value(cnt, option)) {
+      result += fpnt::toDouble(*value);
       count++;
     }
   }
 
   if (count > 0) result /= count;
 
-  record[field] = std::to_string(result);
+  record[field] = result;
 }
+FPNT_THREADSAFE(P_childmean)
+FPNT_REFS(P_childmean, fpnt::child_granularity(granularity))
 
 /**
  * @brief Child granularity's field aggregation, without skipping empty fields
@@ -173,13 +210,13 @@ extern "C" void P_childstdev(std::string& option, nlohmann::json& record,
   double mean = 0.0f;
 
   std::vector<double> stat;
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
   size_t count = 0;
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (!cnt[option].is_null()) {
-      std::string val_str = cnt[option].get<std::string>();
-      double cur_value = atof(val_str.c_str());
+  for (uint32_t child_id : fpnt::get_idx_span(key, granularity, child_g)) {
+    const nlohmann::json& cnt = children[child_id];
+    if (const nlohmann::json* value = fpnt::get_value(cnt, option)) {
+      double cur_value = fpnt::toDouble(*value);
       stat.push_back(cur_value);
       mean += cur_value;
       count++;
@@ -187,7 +224,7 @@ extern "C" void P_childstdev(std::string& option, nlohmann::json& record,
   }
 
   if (count <= 1) {  // undefined value
-    record[field] = std::to_string(-1);
+    record[field] = -1;
     return;
   }
 
@@ -203,8 +240,10 @@ extern "C" void P_childstdev(std::string& option, nlohmann::json& record,
   sampled_standard_deviation /= count - 1;  // sampled!
   sampled_standard_deviation = sqrt(sampled_standard_deviation);
 
-  record[field] = std::to_string(sampled_standard_deviation);
+  record[field] = sampled_standard_deviation;
 }
+FPNT_THREADSAFE(P_childstdev)
+FPNT_REFS(P_childstdev, fpnt::child_granularity(granularity))
 
 /**
  * @brief Child granularity's field max, assuming double
@@ -216,17 +255,19 @@ extern "C" void P_childmax_d(std::string& option, nlohmann::json& record,
   // option contains out_pkt field name
   // idx contains flow idx
   double result = std::numeric_limits<double>::lowest();
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (!cnt[option].is_null()) {
-      std::string val_str = cnt[option].get<std::string>();
-      double cur_value = atof(val_str.c_str());
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  for (uint32_t child_id : fpnt::get_idx_span(key, granularity, child_g)) {
+    const nlohmann::json& cnt = children[child_id];
+    if (const nlohmann::json* value = fpnt::get_value(cnt, option)) {
+      double cur_value = fpnt::toDouble(*value);
       if (cur_value > result) result = cur_value;
     }
   }
-  record[field] = std::to_string(result);
+  record[field] = result;
 }
+FPNT_THREADSAFE(P_childmax_d)
+FPNT_REFS(P_childmax_d, fpnt::child_granularity(granularity))
 
 /**
  * @brief Child granularity's field min, assuming double
@@ -238,17 +279,19 @@ extern "C" void P_childmin_d(std::string& option, nlohmann::json& record,
   // option contains out_pkt field name
   // idx contains flow idx
   double result = std::numeric_limits<double>::max();
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (!cnt[option].is_null()) {
-      std::string val_str = cnt[option].get<std::string>();
-      double cur_value = atof(val_str.c_str());
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  for (uint32_t child_id : fpnt::get_idx_span(key, granularity, child_g)) {
+    const nlohmann::json& cnt = children[child_id];
+    if (const nlohmann::json* value = fpnt::get_value(cnt, option)) {
+      double cur_value = fpnt::toDouble(*value);
       if (cur_value < result) result = cur_value;
     }
   }
-  record[field] = std::to_string(result);
+  record[field] = result;
 }
+FPNT_THREADSAFE(P_childmin_d)
+FPNT_REFS(P_childmin_d, fpnt::child_granularity(granularity))
 
 /**
  * @brief Child granularity's field min, assuming double, update only when non-zero value found
@@ -260,17 +303,19 @@ extern "C" void P_childnzmin_d(std::string& option, nlohmann::json& record,
   // option contains out_pkt field name
   // idx contains flow idx
   double result = std::numeric_limits<double>::max();
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (!cnt[option].is_null()) {
-      std::string val_str = cnt[option].get<std::string>();
-      double cur_value = atof(val_str.c_str());
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  for (uint32_t child_id : fpnt::get_idx_span(key, granularity, child_g)) {
+    const nlohmann::json& cnt = children[child_id];
+    if (const nlohmann::json* value = fpnt::get_value(cnt, option)) {
+      double cur_value = fpnt::toDouble(*value);
       if (cur_value > 0 && cur_value < result) result = cur_value;
     }
   }
-  record[field] = std::to_string(result);
+  record[field] = result;
 }
+FPNT_THREADSAFE(P_childnzmin_d)
+FPNT_REFS(P_childnzmin_d, fpnt::child_granularity(granularity))
 
 /**
  * @brief Child granularity's field min, assuming double
@@ -283,18 +328,20 @@ extern "C" void P_childmaxdiff_d(std::string& option, nlohmann::json& record,
   // idx contains flow idx
   double max = std::numeric_limits<double>::lowest();
   double min = std::numeric_limits<double>::max();
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (!cnt[option].is_null()) {
-      std::string val_str = cnt[option].get<std::string>();
-      double cur_value = atof(val_str.c_str());
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  for (uint32_t child_id : fpnt::get_idx_span(key, granularity, child_g)) {
+    const nlohmann::json& cnt = children[child_id];
+    if (const nlohmann::json* value = fpnt::get_value(cnt, option)) {
+      double cur_value = fpnt::toDouble(*value);
       if (cur_value > max) max = cur_value;
       if (cur_value < min) min = cur_value;
     }
   }
-  record[field] = std::to_string(max - min);
+  record[field] = max - min;
 }
+FPNT_THREADSAFE(P_childmaxdiff_d)
+FPNT_REFS(P_childmaxdiff_d, fpnt::child_granularity(granularity))
 
 /**
  * @brief Child granularity's field max, assuming long long
@@ -306,17 +353,19 @@ extern "C" void P_childmax_ll(std::string& option, nlohmann::json& record,
   // option contains out_pkt field name
   // idx contains flow idx
   long long result = std::numeric_limits<long long>::lowest();
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (!cnt[option].is_null()) {
-      std::string val_str = cnt[option].get<std::string>();
-      long long cur_value = atoll(val_str.c_str());
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  for (uint32_t child_id : fpnt::get_idx_span(key, granularity, child_g)) {
+    const nlohmann::json& cnt = children[child_id];
+    if (const nlohmann::json* value = fpnt::get_value(cnt, option)) {
+      long long cur_value = fpnt::toInt(*value);
       if (cur_value > result) result = cur_value;
     }
   }
-  record[field] = std::to_string(result);
+  record[field] = result;
 }
+FPNT_THREADSAFE(P_childmax_ll)
+FPNT_REFS(P_childmax_ll, fpnt::child_granularity(granularity))
 
 /**
  * @brief Child granularity's field min, assuming long long
@@ -328,14 +377,255 @@ extern "C" void P_childmin_ll(std::string& option, nlohmann::json& record,
   // option contains out_pkt field name
   // idx contains flow idx
   long long result = std::numeric_limits<long long>::max();
-  std::string child_g = fpnt::d->g_lvs[fpnt::d->g_lv_idx[granularity] - 1];
-  for (auto& child_key : fpnt::d->out_child_keys[granularity][key]) {
-    nlohmann::json& cnt = fpnt::d->out[child_g][child_key];
-    if (!cnt[option].is_null()) {
-      std::string val_str = cnt[option].get<std::string>();
-      long long cur_value = atoll(val_str.c_str());
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  for (uint32_t child_id : fpnt::get_idx_span(key, granularity, child_g)) {
+    const nlohmann::json& cnt = children[child_id];
+    if (const nlohmann::json* value = fpnt::get_value(cnt, option)) {
+      long long cur_value = fpnt::toInt(*value);
       if (cur_value < result) result = cur_value;
     }
   }
-  record[field] = std::to_string(result);
+  record[field] = result;
+}
+FPNT_THREADSAFE(P_childmin_ll)
+FPNT_REFS(P_childmin_ll, fpnt::child_granularity(granularity))
+
+/**
+ * @brief Fused child statistics: option is "fieldname[+|-]:stat", where stat is one of count, sum,
+ * sum_ll (as long long), mean, stdev (sampled), min, max, nzmin (non-zero min), range (max - min)
+ * and p<q> (the q-th percentile with linear interpolation, e.g., p95). The child field is gathered
+ * once into a contiguous array, and each statistic is a separate branch-free pass over it (the
+ * deviation by two passes: the mean, then the squared differences), run only if a column needs
+ * it. P_childstats_multi fills a block of P_childstats columns (see "^" in README.md) by a single
+ * call, gathering each child field of the block once. The postfix '+' or '-' keeps only the
+ * children of that direction (see P_childsum_ll). The empty results follow the single functions
+ * (e.g., stdev is -1 for less than two values, and min is the largest double), except that range
+ * is 0 and percentiles are "".
+ */
+enum ChildStat : uint32_t {
+  CS_COUNT,
+  CS_SUM,
+  CS_SUM_LL,
+  CS_MEAN,
+  CS_STDEV,
+  CS_MIN,
+  CS_MAX,
+  CS_NZMIN,
+  CS_RANGE,
+  CS_PERCENTILE,
+};
+
+static constexpr uint32_t cs_bit(ChildStat stat) { return 1u << stat; }
+
+struct ChildStatsSource {
+  std::string fieldname;
+  bool check_dir = false;
+  bool dir = false;
+  uint32_t stats = 0;  // bit mask of the ChildStat of its columns
+};
+
+struct ChildStatsColumn {
+  size_t source;  // index of ChildStatsState::sources
+  ChildStat stat;
+  double q;  // of CS_PERCENTILE
+};
+
+struct ChildStatsState {
+  std::vector<ChildStatsSource> sources;  // the distinct fieldname[+|-] of the columns
+  std::vector<ChildStatsColumn> columns;  // by field
+};
+
+static void addChildStatsColumn(ChildStatsState& state, const std::string& option) {
+  static const std::map<std::string, ChildStat> stats{
+      {"count", CS_COUNT}, {"sum", CS_SUM}, {"sum_ll", CS_SUM_LL},
+      {"mean", CS_MEAN},   {"stdev", CS_STDEV}, {"min", CS_MIN},
+      {"max", CS_MAX},     {"nzmin", CS_NZMIN}, {"range", CS_RANGE}};
+  size_t colon_pos = option.rfind(':');
+  if (colon_pos == std::string::npos || colon_pos == 0) {
+    std::cerr << "P_childstats: option must be in 'fieldname[+|-]:stat' format!" << std::endl;
+    exit(1);
+  }
+
+  ChildStatsSource source;
+  source.fieldname = option.substr(0, colon_pos);
+  char lastChar = source.fieldname.back();
+  if (lastChar == '+' || lastChar == '-') {
+    source.check_dir = true;
+    source.dir = (lastChar == '+');
+    source.fieldname.pop_back();
+  }
+
+  ChildStatsColumn column{0, CS_PERCENTILE, 0};
+  const std::string stat = option.substr(colon_pos + 1);
+  auto it = stats.find(stat);
+  if (it != stats.end()) {
+    column.stat = it->second;
+  } else {
+    char* end = nullptr;
+    if (stat.size() >= 2 && stat[0] == 'p') column.q = strtod(stat.c_str() + 1, &end);
+    if (end == nullptr || *end != '\0' || column.q < 0 || column.q > 100) {
+      std::cerr << "P_childstats: unknown statistic " << stat << "!" << std::endl;
+      exit(1);
+    }
+  }
+
+  while (column.source < state.sources.size()) {
+    const ChildStatsSource& s = state.sources[column.source];
+    if (s.fieldname == source.fieldname && s.check_dir == source.check_dir && s.dir == source.dir)
+      break;
+    column.source++;
+  }
+  if (column.source == state.sources.size()) state.sources.push_back(std::move(source));
+  state.sources[column.source].stats |= cs_bit(column.stat);
+  state.columns.push_back(column);
+}
+
+extern "C" void* P_childstats_init(const std::string& option) {
+  ChildStatsState* state = new ChildStatsState;
+  addChildStatsColumn(*state, option);
+  return state;
+}
+
+extern "C" void P_childstats_destroy(void* state) { delete (ChildStatsState*)state; }
+
+extern "C" void* P_childstats_multi_init(const std::vector<std::string>& options) {
+  ChildStatsState* state = new ChildStatsState;
+  for (auto& option : options) addChildStatsColumn(*state, option);
+  return state;
+}
+
+extern "C" void P_childstats_multi_destroy(void* state) { delete (ChildStatsState*)state; }
+
+// compute the statistics of every source of state, and write the column i into fields[i]
+static void childstats(const ChildStatsState& state, nlohmann::json& record,
+                       const std::string& granularity, const std::string& key,
+                       const std::string* fields) {
+  static thread_local std::vector<double> values;
+  static thread_local std::vector<long long> ints;  // for sum_ll
+  const std::string child_g = fpnt::child_granularity(granularity);
+  const fpnt::RecordTable& children = fpnt::records(child_g);
+  const std::string dir_field = "__" + granularity + "_dir";
+  const auto child_ids = fpnt::get_idx_span(key, granularity, child_g);
+
+  for (size_t source_idx = 0; source_idx < state.sources.size(); source_idx++) {
+    const ChildStatsSource& source = state.sources[source_idx];
+    const bool need_ll = source.stats & cs_bit(CS_SUM_LL);
+
+    // gather: the child records are looked up once, and the values are parsed once
+    values.clear();
+    ints.clear();
+    for (uint32_t child_id : child_ids) {
+      const nlohmann::json& cnt = children[child_id];
+      auto it = cnt.find(source.fieldname);
+      if (it == cnt.end() || it->is_null()) continue;
+      if (source.check_dir) {  // different direction means no addition
+        long long dir_value = fpnt::child_dir(cnt, dir_field);
+        if (source.dir && dir_value < 0) continue;
+        if (!source.dir && dir_value > 0) continue;
+      }
+      values.push_back(fpnt::toDouble(*it));
+      if (need_ll) ints.push_back(fpnt::toInt(*it));
+    }
+
+    // a separate pass for each statistic needed
+    const size_t n = values.size();
+    const double* x = values.data();
+    auto needs = [&](uint32_t bits) { return (source.stats & bits) != 0; };
+    double sum = 0;
+    if (needs(cs_bit(CS_SUM) | cs_bit(CS_MEAN) | cs_bit(CS_STDEV))) {
+      for (size_t i = 0; i < n; i++) sum += x[i];
+    }
+    const double mean = (n > 0) ? sum / n : 0.0;
+    double stdev = -1.0;
+    if (needs(cs_bit(CS_STDEV)) && n > 1) {
+      double sumsq = 0;
+      for (size_t i = 0; i < n; i++) sumsq += (x[i] - mean) * (x[i] - mean);
+      stdev = sqrt(sumsq / (n - 1));
+    }
+    double min = std::numeric_limits<double>::max();
+    double max = std::numeric_limits<double>::lowest();
+    if (needs(cs_bit(CS_MIN) | cs_bit(CS_RANGE))) {
+      for (size_t i = 0; i < n; i++) min = std::min(min, x[i]);
+    }
+    if (needs(cs_bit(CS_MAX) | cs_bit(CS_RANGE))) {
+      for (size_t i = 0; i < n; i++) max = std::max(max, x[i]);
+    }
+    double nzmin = std::numeric_limits<double>::max();
+    if (needs(cs_bit(CS_NZMIN))) {
+      for (size_t i = 0; i < n; i++)
+        nzmin = std::min(nzmin, x[i] > 0 ? x[i] : std::numeric_limits<double>::max());
+    }
+    long long sum_ll = 0;
+    for (size_t i = 0; i < ints.size(); i++) sum_ll += ints[i];
+    if (needs(cs_bit(CS_PERCENTILE)) && n > 0) std::sort(values.begin(), values.end());
+
+    for (size_t i = 0; i < state.columns.size(); i++) {
+      const ChildStatsColumn& column = state.columns[i];
+      if (column.source != source_idx) continue;
+      nlohmann::json& result = record[fields[i]];
+      switch (column.stat) {
+        case CS_COUNT:
+          result = n;
+          break;
+        case CS_SUM:
+          result = sum;
+          break;
+        case CS_SUM_LL:
+          result = sum_ll;
+          break;
+        case CS_MEAN:
+          result = mean;
+          break;
+        case CS_STDEV:
+          result = stdev;
+          break;
+        case CS_MIN:
+          result = min;
+          break;
+        case CS_MAX:
+          result = max;
+          break;
+        case CS_NZMIN:
+          result = nzmin;
+          break;
+        case CS_RANGE:
+          result = (n > 0) ? max - min : 0.0;
+          break;
+        case CS_PERCENTILE:
+          if (n == 0) {
+            result = "";
+          } else {
+            const double pos = column.q / 100 * (n - 1);
+            const size_t lo = (size_t)pos;
+            const size_t hi = std::min(lo + 1, n - 1);
+            result = values[lo] + (values[hi] - values[lo]) * (pos - lo);
+          }
+          break;
+      }
+    }
+  }
+}
+
+extern "C" void P_childstats(void* state, nlohmann::json& record, const std::string& granularity,
+                             const std::string& key, const std::string& field) {
+  childstats(*(ChildStatsState*)state, record, granularity, key, &field);
+}
+FPNT_THREADSAFE(P_childstats)
+
+extern "C" void P_childstats_multi(void* state, const std::vector<std::string>& options,
+                                   nlohmann::json& record, std::string& granularity,
+                                   const std::string& key, const std::vector<std::string>& fields) {
+  childstats(*(ChildStatsState*)state, record, granularity, key, fields.data());
+}
+
+extern "C" void P_childstats_refs(const std::string& option, const std::string& granularity,
+                                  std::vector<std::pair<std::string, std::string>>& refs) {
+  std::string child_g = fpnt::child_granularity(granularity);
+  std::string fieldname = option.substr(0, option.rfind(':'));
+  if (!fieldname.empty() && (fieldname.back() == '+' || fieldname.back() == '-')) {
+    fieldname.pop_back();
+    refs.emplace_back(child_g, "__dir");
+  }
+  refs.emplace_back(child_g, fieldname);
 }
@@ -0,0 +1,1063 @@
+#include <arpa/inet.h>
+#include <fpnt/bpf.h>
+#include <fpnt/pcap.h>
+#include <fpnt/util.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+namespace fpnt {
+
+  namespace {
+    // classic BPF opcodes (see <linux/filter.h>)
+    constexpr uint16_t OP_LD = 0x00, OP_LDX = 0x01, OP_ST = 0x02, OP_STX = 0x03, OP_ALU = 0x04,
+                       OP_JMP = 0x05, OP_RET = 0x06, OP_MISC = 0x07;
+    constexpr uint16_t SZ_W = 0x00, SZ_H = 0x08, SZ_B = 0x10;
+    constexpr uint16_t MODE_IMM = 0x00, MODE_ABS = 0x20, MODE_IND = 0x40, MODE_MEM = 0x60,
+                       MODE_LEN = 0x80, MODE_MSH = 0xa0;
+    constexpr uint16_t ALU_ADD = 0x00, ALU_SUB = 0x10, ALU_MUL = 0x20, ALU_DIV = 0x30,
+                       ALU_OR = 0x40, ALU_AND = 0x50, ALU_LSH = 0x60, ALU_RSH = 0x70,
+                       ALU_NEG = 0x80, ALU_MOD = 0x90, ALU_XOR = 0xa0;
+    constexpr uint16_t JMP_JA = 0x00, JMP_JEQ = 0x10, JMP_JGT = 0x20, JMP_JGE = 0x30,
+                       JMP_JSET = 0x40;
+    constexpr uint16_t SRC_K = 0x00, SRC_X = 0x08;
+    constexpr uint16_t RVAL_K = 0x00, RVAL_X = 0x08, RVAL_A = 0x10;
+    constexpr uint16_t MISC_TAX = 0x00, MISC_TXA = 0x80;
+    constexpr size_t BPF_MEMWORDS = 16;
+    constexpr uint32_t BPF_ACCEPT = 262144;  // the snapshot length returned by tcpdump filters
+
+    constexpr uint32_t LINKTYPE_IEEE802_11 = 105;
+    constexpr uint32_t LINKTYPE_IEEE802_11_RADIOTAP = 127;
+
+    inline uint16_t cls(uint16_t code) { return code & 0x07; }
+
+    bool validCode(uint16_t code) {
+      switch (code) {
+        case OP_LD | SZ_W | MODE_ABS:
+        case OP_LD | SZ_H | MODE_ABS:
+        case OP_LD | SZ_B | MODE_ABS:
+        case OP_LD | SZ_W | MODE_IND:
+        case OP_LD | SZ_H | MODE_IND:
+        case OP_LD | SZ_B | MODE_IND:
+        case OP_LD | SZ_W | MODE_IMM:
+        case OP_LD | SZ_W | MODE_MEM:
+        case OP_LD | SZ_W | MODE_LEN:
+        case OP_LDX | SZ_W | MODE_IMM:
+        case OP_LDX | SZ_W | MODE_MEM:
+        case OP_LDX | SZ_W | MODE_LEN:
+        case OP_LDX | SZ_B | MODE_MSH:
+        case OP_ST:
+        case OP_STX:
+        case OP_ALU | ALU_NEG:
+        case OP_JMP | JMP_JA:
+        case OP_RET | RVAL_K:
+        case OP_RET | RVAL_X:
+        case OP_RET | RVAL_A:
+        case OP_MISC | MISC_TAX:
+        case OP_MISC | MISC_TXA:
+          return true;
+        default:
+          break;
+      }
+      uint16_t op = code & 0xf0, src = code & 0x08;
+      if (cls(code) == OP_ALU && (code & ~0xf8) == OP_ALU)
+        return op <= ALU_XOR && op != ALU_NEG && (src == SRC_K || src == SRC_X);
+      if (cls(code) == OP_JMP && (code & ~0xf8) == OP_JMP)
+        return op >= JMP_JEQ && op <= JMP_JSET;
+      return false;
+    }
+
+    // big-endian load of size bytes at off; false if it is out of the captured bytes
+    inline bool loadBytes(const uint8_t* pkt, uint32_t caplen, uint64_t off, uint32_t size,
+                          uint32_t& value) {
+      if (off + size > caplen) return false;
+      const uint8_t* p = pkt + off;
+      value = (size == 4) ? ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+                                | ((uint32_t)p[2] << 8) | p[3]
+              : (size == 2) ? ((uint32_t)p[0] << 8) | p[1]
+                            : p[0];
+      return true;
+    }
+
+    inline uint32_t loadSize(uint16_t code) {
+      switch (code & 0x18) {
+        case SZ_H:
+          return 2;
+        case SZ_B:
+          return 1;
+        default:
+          return 4;
+      }
+    }
+
+    /* ---- capture filter compiler ---- */
+
+    struct CompileError {
+      std::string message;
+    };
+
+    [[noreturn]] void fail(const std::string& message) { throw CompileError{message}; }
+
+    enum CmpOp { CMP_EQ, CMP_NE, CMP_LT, CMP_LE, CMP_GT, CMP_GE };
+
+    enum LoadBase {
+      BASE_ABS,       // [off]
+      BASE_L4,        // [off] from the transport header after the IPv4 header at hdr
+      BASE_RADIOTAP,  // [off] from the 802.11 header after the radiotap header
+      BASE_LEN,       // the original length of the packet
+    };
+
+    struct Node;
+    typedef std::shared_ptr<Node> NodeP;
+
+    struct Node {
+      enum Kind { AND, OR, NOT, CMP, TRUE, FALSE } kind;
+      NodeP lhs, rhs;
+
+      // CMP: (load & mask) op value
+      LoadBase base = BASE_ABS;
+      uint32_t hdr = 0;
+      uint32_t off = 0;
+      uint32_t size = 1;
+      uint32_t mask = 0xffffffff;
+      CmpOp op = CMP_EQ;
+      uint32_t value = 0;
+    };
+
+    NodeP constNode(bool value) {
+      auto node = std::make_shared<Node>();
+      node->kind = value ? Node::TRUE : Node::FALSE;
+      return node;
+    }
+
+    NodeP andNode(NodeP lhs, NodeP rhs) {
+      if (lhs->kind == Node::FALSE || rhs->kind == Node::TRUE) return lhs;
+      if (lhs->kind == Node::TRUE || rhs->kind == Node::FALSE) return rhs;
+      auto node = std::make_shared<Node>();
+      node->kind = Node::AND;
+      node->lhs = lhs;
+      node->rhs = rhs;
+      return node;
+    }
+
+    NodeP orNode(NodeP lhs, NodeP rhs) {
+      if (lhs->kind == Node::TRUE || rhs->kind == Node::FALSE) return lhs;
+      if (lhs->kind == Node::FALSE || rhs->kind == Node::TRUE) return rhs;
+      auto node = std::make_shared<Node>();
+      node->kind = Node::OR;
+      node->lhs = lhs;
+      node->rhs = rhs;
+      return node;
+    }
+
+    NodeP notNode(NodeP operand) {
+      if (operand->kind == Node::TRUE || operand->kind == Node::FALSE)
+        return constNode(operand->kind == Node::FALSE);
+      auto node = std::make_shared<Node>();
+      node->kind = Node::NOT;
+      node->lhs = operand;
+      return node;
+    }
+
+    NodeP cmpNode(LoadBase base, uint32_t off, uint32_t size, uint32_t value, CmpOp op = CMP_EQ,
+                  uint32_t mask = 0xffffffff, uint32_t hdr = 0) {
+      auto node = std::make_shared<Node>();
+      node->kind = Node::CMP;
+      node->base = base;
+      node->hdr = hdr;
+      node->off = off;
+      node->size = size;
+      node->mask = mask;
+      node->op = op;
+      node->value = value;
+      return node;
+    }
+
+    // code generation with forward-only symbolic labels
+    class CodeGen {
+    private:
+      struct Pending {
+        BpfInsn insn;
+        int jt = -1, jf = -1;  // labels of a conditional jump, or jt only for JA
+      };
+      std::vector<Pending> code;
+      std::vector<size_t> labels;
+
+      void emit(uint16_t op, uint32_t k = 0) {
+        Pending p;
+        p.insn.code = op;
+        p.insn.k = k;
+        code.push_back(p);
+      }
+      void jump(uint16_t op, uint32_t k, int jt, int jf) {
+        Pending p;
+        p.insn.code = op;
+        p.insn.k = k;
+        p.jt = jt;
+        p.jf = jf;
+        code.push_back(p);
+      }
+
+      void genCmp(const Node& node, int lt, int lf) {
+        uint16_t sz = node.size == 4 ? SZ_W : node.size == 2 ? SZ_H : SZ_B;
+        switch (node.base) {
+          case BASE_ABS:
+            emit(OP_LD | sz | MODE_ABS, node.off);
+            break;
+          case BASE_L4:
+            emit(OP_LDX | SZ_B | MODE_MSH, node.hdr);
+            emit(OP_LD | sz | MODE_IND, node.hdr + node.off);
+            break;
+          case BASE_RADIOTAP:  // it_len is a little-endian 16-bit field at offset 2
+            emit(OP_LD | SZ_B | MODE_ABS, 3);
+            emit(OP_ALU | ALU_LSH | SRC_K, 8);
+            emit(OP_MISC | MISC_TAX);
+            emit(OP_LD | SZ_B | MODE_ABS, 2);
+            emit(OP_ALU | ALU_OR | SRC_X);
+            emit(OP_MISC | MISC_TAX);
+            emit(OP_LD | sz | MODE_IND, node.off);
+            break;
+          case BASE_LEN:
+            emit(OP_LD | SZ_W | MODE_LEN);
+            break;
+        }
+        if (node.mask != 0xffffffff) emit(OP_ALU | ALU_AND | SRC_K, node.mask);
+
+        switch (node.op) {
+          case CMP_EQ:
+            jump(OP_JMP | JMP_JEQ | SRC_K, node.value, lt, lf);
+            break;
+          case CMP_NE:
+            jump(OP_JMP | JMP_JEQ | SRC_K, node.value, lf, lt);
+            break;
+          case CMP_GT:
+            jump(OP_JMP | JMP_JGT | SRC_K, node.value, lt, lf);
+            break;
+          case CMP_GE:
+            jump(OP_JMP | JMP_JGE | SRC_K, node.value, lt, lf);
+            break;
+          case CMP_LT:
+            jump(OP_JMP | JMP_JGE | SRC_K, node.value, lf, lt);
+            break;
+          case CMP_LE:
+            jump(OP_JMP | JMP_JGT | SRC_K, node.value, lf, lt);
+            break;
+        }
+      }
+
+    public:
+      int newLabel() {
+        labels.push_back((size_t)-1);
+        return (int)labels.size() - 1;
+      }
+      void place(int label) { labels[label] = code.size(); }
+
+      void gen(const Node& node, int lt, int lf) {
+        switch (node.kind) {
+          case Node::TRUE:
+            jump(OP_JMP | JMP_JA, 0, lt, -1);
+            break;
+          case Node::FALSE:
+            jump(OP_JMP | JMP_JA, 0, lf, -1);
+            break;
+          case Node::CMP:
+            genCmp(node, lt, lf);
+            break;
+          case Node::NOT:
+            gen(*node.lhs, lf, lt);
+            break;
+          case Node::AND: {
+            int next = newLabel();
+            gen(*node.lhs, next, lf);
+            place(next);
+            gen(*node.rhs, lt, lf);
+            break;
+          }
+          case Node::OR: {
+            int next = newLabel();
+            gen(*node.lhs, lt, next);
+            place(next);
+            gen(*node.rhs, lt, lf);
+            break;
+          }
+        }
+      }
+
+      std::vector<BpfInsn> finish(const Node& root) {
+        int accept = newLabel(), reject = newLabel();
+        gen(root, accept, reject);
+        place(accept);
+        emit(OP_RET | RVAL_K, BPF_ACCEPT);
+        place(reject);
+        emit(OP_RET | RVAL_K, 0);
+
+        std::vector<BpfInsn> result;
+        for (size_t pc = 0; pc < code.size(); pc++) {
+          BpfInsn insn = code[pc].insn;
+          if (code[pc].jt >= 0) {
+            size_t jt = labels[code[pc].jt] - (pc + 1);
+            if (insn.code == (OP_JMP | JMP_JA)) {
+              insn.k = (uint32_t)jt;
+            } else {
+              insn.jt = (uint32_t)jt;
+              insn.jf = (uint32_t)(labels[code[pc].jf] - (pc + 1));
+            }
+          }
+          result.push_back(insn);
+        }
+        return result;
+      }
+    };
+
+    const std::vector<std::pair<std::string, uint32_t>>& wlanSubtypes() {
+      // frame control byte & 0xfc: subtype << 4 | type << 2
+      static const std::vector<std::pair<std::string, uint32_t>> result = {
+          {"assoc-req", 0x00},
+          {"assoc-resp", 0x10},
+          {"reassoc-req", 0x20},
+          {"reassoc-resp", 0x30},
+          {"probe-req", 0x40},
+          {"probe-resp", 0x50},
+          {"beacon", 0x80},
+          {"atim", 0x90},
+          {"disassoc", 0xa0},
+          {"auth", 0xb0},
+          {"deauth", 0xc0},
+          {"action", 0xd0},
+          {"action-no-ack", 0xe0},
+          {"bar", 0x84},
+          {"ba", 0x94},
+          {"ps-poll", 0xa4},
+          {"rts", 0xb4},
+          {"cts", 0xc4},
+          {"ack", 0xd4},
+          {"cf-end", 0xe4},
+          {"cf-end-ack", 0xf4},
+          {"data", 0x08},
+          {"data-cf-ack", 0x18},
+          {"data-cf-poll", 0x28},
+          {"data-cf-ack-poll", 0x38},
+          {"null", 0x48},
+          {"cf-ack", 0x58},
+          {"cf-poll", 0x68},
+          {"cf-ack-poll", 0x78},
+          {"qos-data", 0x88},
+          {"qos-data-cf-ack", 0x98},
+          {"qos-data-cf-poll", 0xa8},
+          {"qos-data-cf-ack-poll", 0xb8},
+          {"qos", 0xc8},
+          {"qos-cf-poll", 0xe8},
+          {"qos-cf-ack-poll", 0xf8},
+      };
+      return result;
+    }
+
+    class Parser {
+    private:
+      std::vector<std::string> tokens;
+      size_t pos = 0;
+      uint32_t linktype;
+
+      static bool isWordChar(char c, bool in_brackets) {
+        return std::isalnum((unsigned char)c) || c == '_' || c == '.' || c == '/' || c == '-'
+               || (c == ':' && !in_brackets);
+      }
+
+      void tokenize(const std::string& filter) {
+        int depth = 0;
+        for (size_t i = 0; i < filter.size();) {
+          char c = filter[i];
+          if (std::isspace((unsigned char)c)) {
+            i++;
+          } else if (isWordChar(c, depth > 0)) {
+            size_t start = i;
+            while (i < filter.size() && isWordChar(filter[i], depth > 0)) i++;
+            tokens.push_back(filter.substr(start, i - start));
+          } else {
+            static const char* ops[] = {"&&", "||", "!=", "==", "<=", ">=", "(", ")", "[", "]",
+                                        ":",  "&",  "!",  "=",  "<",  ">"};
+            bool found = false;
+            for (const char* op : ops) {
+              size_t len = strlen(op);
+              if (filter.compare(i, len, op) == 0) {
+                tokens.push_back(op);
+                i += len;
+                found = true;
+                break;
+              }
+            }
+            if (!found) fail(std::string("unexpected character '") + c + "'");
+            if (c == '[') depth++;
+            if (c == ']') depth--;
+          }
+        }
+      }
+
+      bool atEnd() const { return pos >= tokens.size(); }
+      const std::string& peek() const {
+        static const std::string none;
+        return atEnd() ? none : tokens[pos];
+      }
+      bool accept(const std::string& token) {
+        if (atEnd() || tokens[pos] != token) return false;
+        pos++;
+        return true;
+      }
+      const std::string& next(const std::string& what) {
+        if (atEnd()) fail("missing " + what);
+        return tokens[pos++];
+      }
+      void expect(const std::string& token) {
+        if (!accept(token)) fail("'" + token + "' is expected near '" + peek() + "'");
+      }
+
+      uint32_t number(const std::string& what) {
+        const std::string& token = next(what);
+        char* end = nullptr;
+        errno = 0;
+        unsigned long long value = strtoull(token.c_str(), &end, 0);
+        if (token.empty() || *end != '\0' || errno != 0 || value > 0xffffffffULL)
+          fail("invalid " + what + " '" + token + "'");
+        return (uint32_t)value;
+      }
+
+      CmpOp relop() {
+        const std::string& token = next("comparison operator");
+        if (token == "=" || token == "==") return CMP_EQ;
+        if (token == "!=") return CMP_NE;
+        if (token == "<") return CMP_LT;
+        if (token == "<=") return CMP_LE;
+        if (token == ">") return CMP_GT;
+        if (token == ">=") return CMP_GE;
+        fail("invalid comparison operator '" + token + "'");
+      }
+
+      void mac(const std::string& token, uint32_t& hi, uint32_t& lo) {
+        unsigned int b[6];
+        char tail;
+        if (sscanf(token.c_str(), "%2x:%2x:%2x:%2x:%2x:%2x%c", &b[0], &b[1], &b[2], &b[3], &b[4],
+                   &b[5], &tail)
+            != 6)
+          fail("invalid MAC address '" + token + "'");
+        hi = (b[0] << 24) | (b[1] << 16) | (b[2] << 8) | b[3];
+        lo = (b[4] << 8) | b[5];
+      }
+
+      std::string linkName() const { return "linktype " + std::to_string(linktype); }
+
+      /* ---- link-layer dependent tests ---- */
+
+      bool isWlan() const {
+        return linktype == LINKTYPE_IEEE802_11 || linktype == LINKTYPE_IEEE802_11_RADIOTAP;
+      }
+
+      uint32_t etherTypeOffset(const std::string& what) const {
+        switch (linktype) {
+          case LINKTYPE_ETHERNET:
+            return 12;
+          case LINKTYPE_LINUX_SLL:
+            return 14;
+          case LINKTYPE_LINUX_SLL2:
+            return 0;
+          default:
+            fail("'" + what + "' is not supported for " + linkName());
+        }
+      }
+
+      // offset of the network-layer header
+      uint32_t nl(const std::string& what) const {
+        switch (linktype) {
+          case LINKTYPE_ETHERNET:
+            return 14;
+          case LINKTYPE_LINUX_SLL:
+            return 16;
+          case LINKTYPE_LINUX_SLL2:
+            return 20;
+          case LINKTYPE_NULL:
+            return 4;
+          case LINKTYPE_RAW:
+          case LINKTYPE_IPV4:
+          case LINKTYPE_IPV6:
+            return 0;
+          default:
+            fail("'" + what + "' is not supported for " + linkName()
+                 + "; use tshark_displayfilter instead");
+        }
+      }
+
+      NodeP isNetwork(uint16_t ethertype, const std::vector<uint32_t>& families,
+                      uint32_t version, const std::string& what) {
+        switch (linktype) {
+          case LINKTYPE_ETHERNET:
+          case LINKTYPE_LINUX_SLL:
+          case LINKTYPE_LINUX_SLL2:
+            return cmpNode(BASE_ABS, etherTypeOffset(what), 2, ethertype);
+          case LINKTYPE_NULL: {  // the address family in the capturing host's byte order
+            NodeP result = constNode(false);
+            for (uint32_t family : families) {
+              result = orNode(result, cmpNode(BASE_ABS, 0, 4, family));
+              result = orNode(result, cmpNode(BASE_ABS, 0, 4, __builtin_bswap32(family)));
+            }
+            return result;
+          }
+          case LINKTYPE_RAW:
+            return version == 0 ? constNode(false)
+                                : cmpNode(BASE_ABS, 0, 1, version << 4, CMP_EQ, 0xf0);
+          case LINKTYPE_IPV4:
+            return constNode(version == 4);
+          case LINKTYPE_IPV6:
+            return constNode(version == 6);
+          default:
+            nl(what);  // fails
+            return constNode(false);
+        }
+      }
+
+      NodeP isIPv4(const std::string& what = "ip") { return isNetwork(0x0800, {2}, 4, what); }
+      NodeP isIPv6(const std::string& what = "ip6") {
+        return isNetwork(0x86dd, {24, 28, 30}, 6, what);
+      }
+      NodeP isArp() { return isNetwork(0x0806, {}, 0, "arp"); }
+
+      // an IPv4 datagram of the given protocol; the transport header is accessed only in the
+      // first fragment, so l4 adds a fragment offset test
+      NodeP ipv4Proto(uint32_t proto, const std::string& what, bool l4 = false) {
+        uint32_t hdr = nl(what);
+        NodeP result = andNode(isIPv4(what), cmpNode(BASE_ABS, hdr + 9, 1, proto));
+        if (!l4) return result;
+        return andNode(result, cmpNode(BASE_ABS, hdr + 6, 2, 0, CMP_EQ, 0x1fff));
+      }
+      NodeP ipv6Proto(uint32_t proto, const std::string& what) {
+        return andNode(isIPv6(what), cmpNode(BASE_ABS, nl(what) + 6, 1, proto));
+      }
+      NodeP transport(uint32_t proto, const std::string& what) {
+        return orNode(ipv4Proto(proto, what), ipv6Proto(proto, what));
+      }
+
+      NodeP port(const std::string& proto, const std::string& dir, uint32_t value) {
+        if (value > 0xffff) fail("invalid port " + std::to_string(value));
+        std::vector<uint32_t> protos;
+        if (proto != "udp") protos.push_back(6);
+        if (proto != "tcp") protos.push_back(17);
+
+        auto ports = [&](LoadBase base, uint32_t hdr, uint32_t off) {
+          NodeP src = cmpNode(base, off, 2, value, CMP_EQ, 0xffffffff, hdr);
+          NodeP dst = cmpNode(base, off + 2, 2, value, CMP_EQ, 0xffffffff, hdr);
+          return dir == "src" ? src : dir == "dst" ? dst : orNode(src, dst);
+        };
+
+        NodeP result = constNode(false);
+        for (uint32_t p : protos) {
+          uint32_t hdr = nl("port");
+          result = orNode(result, andNode(ipv4Proto(p, "port", true), ports(BASE_L4, hdr, 0)));
+          result = orNode(result, andNode(ipv6Proto(p, "port"), ports(BASE_ABS, 0, hdr + 40)));
+        }
+        return result;
+      }
+
+      NodeP host(const std::string& dir, const std::string& addr) {
+        if (addr.find(':') != std::string::npos) {
+          uint8_t bytes[16];
+          if (inet_pton(AF_INET6, addr.c_str(), bytes) != 1)
+            fail("invalid IPv6 address '" + addr + "'");
+          uint32_t hdr = nl("ip6");
+          auto match = [&](uint32_t off) {
+            NodeP result = constNode(true);
+            for (uint32_t i = 0; i < 16; i += 4) {
+              uint32_t word = ((uint32_t)bytes[i] << 24) | ((uint32_t)bytes[i + 1] << 16)
+                              | ((uint32_t)bytes[i + 2] << 8) | bytes[i + 3];
+              result = andNode(result, cmpNode(BASE_ABS, off + i, 4, word));
+            }
+            return result;
+          };
+          NodeP src = match(hdr + 8), dst = match(hdr + 24);
+          return andNode(isIPv6(), dir == "src"   ? src
+                                   : dir == "dst" ? dst
+                                                  : orNode(src, dst));
+        }
+        return net(dir, addr + "/32");
+      }
+
+      NodeP net(const std::string& dir, const std::string& cidr) {
+        size_t slash = cidr.find('/');
+        std::string addr = cidr.substr(0, slash);
+        uint32_t prefix = 32;
+        if (slash != std::string::npos) {
+          char* end = nullptr;
+          std::string len = cidr.substr(slash + 1);
+          prefix = (uint32_t)strtoul(len.c_str(), &end, 10);
+          if (len.empty() || *end != '\0' || prefix > 32) fail("invalid network '" + cidr + "'");
+        }
+        struct in_addr in;
+        if (inet_pton(AF_INET, addr.c_str(), &in) != 1)
+          fail("invalid IPv4 address '" + addr + "'");
+        uint32_t value = ntohl(in.s_addr);
+        uint32_t mask = prefix == 0 ? 0 : 0xffffffffU << (32 - prefix);
+        if ((value & ~mask) != 0) fail("non-network bits set in '" + cidr + "'");
+
+        uint32_t hdr = nl("ip");
+        NodeP src = cmpNode(BASE_ABS, hdr + 12, 4, value, CMP_EQ, mask);
+        NodeP dst = cmpNode(BASE_ABS, hdr + 16, 4, value, CMP_EQ, mask);
+        return andNode(isIPv4(), dir == "src"   ? src
+                                 : dir == "dst" ? dst
+                                                : orNode(src, dst));
+      }
+
+      NodeP ether(const std::string& dir, const std::string& addr) {
+        if (linktype != LINKTYPE_ETHERNET) fail("'ether' is not supported for " + linkName());
+        uint32_t hi, lo;
+        mac(addr, hi, lo);
+        auto match = [&](uint32_t off) {
+          return andNode(cmpNode(BASE_ABS, off, 4, hi), cmpNode(BASE_ABS, off + 4, 2, lo));
+        };
+        NodeP src = match(6), dst = match(0);
+        return dir == "src" ? src : dir == "dst" ? dst : orNode(src, dst);
+      }
+
+      NodeP wlan(uint32_t off, uint32_t size, uint32_t value, CmpOp op = CMP_EQ,
+                 uint32_t mask = 0xffffffff) {
+        if (!isWlan()) fail("802.11 primitives are not supported for " + linkName());
+        LoadBase base = linktype == LINKTYPE_IEEE802_11 ? BASE_ABS : BASE_RADIOTAP;
+        return cmpNode(base, off, size, value, op, mask);
+      }
+
+      uint32_t wlanType(const std::string& name) {
+        if (name == "mgt") return 0x00;
+        if (name == "ctl") return 0x04;
+        if (name == "data") return 0x08;
+        fail("unknown 802.11 type '" + name + "'");
+      }
+
+      uint32_t wlanSubtype(const std::string& name, int type) {
+        for (const auto& [subtype, value] : wlanSubtypes()) {
+          if (subtype == name && (type < 0 || (value & 0x0c) == (uint32_t)type)) return value;
+        }
+        fail("unknown 802.11 subtype '" + name + "'");
+      }
+
+      // PROTO[OFF(:SIZE)] (& MASK) OP VALUE
+      NodeP access(const std::string& proto) {
+        expect("[");
+        uint32_t off = number("offset");
+        uint32_t size = 1;
+        if (accept(":")) size = number("size");
+        if (size != 1 && size != 2 && size != 4) fail("invalid size " + std::to_string(size));
+        expect("]");
+        uint32_t mask = 0xffffffff;
+        if (accept("&")) mask = number("mask");
+        CmpOp op = relop();
+        uint32_t value = number("value");
+
+        if (proto == "link" || proto == "ether") {
+          if (proto == "ether" && linktype != LINKTYPE_ETHERNET)
+            fail("'ether' is not supported for " + linkName());
+          return cmpNode(BASE_ABS, off, size, value, op, mask);
+        }
+        if (proto == "wlan") return wlan(off, size, value, op, mask);
+        if (proto == "ip")
+          return andNode(isIPv4(), cmpNode(BASE_ABS, nl(proto) + off, size, value, op, mask));
+        if (proto == "ip6")
+          return andNode(isIPv6(), cmpNode(BASE_ABS, nl(proto) + off, size, value, op, mask));
+
+        uint32_t ip_proto = proto == "tcp" ? 6 : proto == "udp" ? 17 : proto == "icmp" ? 1 : 0;
+        if (ip_proto == 0) fail("unknown protocol '" + proto + "'");
+        return andNode(ipv4Proto(ip_proto, proto, true),
+                       cmpNode(BASE_L4, off, size, value, op, mask, nl(proto)));
+      }
+
+      NodeP primitive() {
+        std::string word = next("primitive");
+        if (peek() == "[") return access(word);
+
+        std::string dir;
+        if (word == "src" || word == "dst") {
+          dir = word;
+          word = next("'host', 'net' or 'port'");
+        }
+
+        if (word == "host") return host(dir, next("address"));
+        if (word == "net") return net(dir, next("network"));
+        if (word == "port") return port("", dir, number("port"));
+        if (!dir.empty()) fail("'host', 'net' or 'port' is expected after '" + dir + "'");
+
+        if (word == "ip") return accept("proto") ? ipv4Proto(number("protocol"), word) : isIPv4();
+        if (word == "ip6") return accept("proto") ? ipv6Proto(number("protocol"), word) : isIPv6();
+        if (word == "arp") return isArp();
+        if (word == "icmp") return ipv4Proto(1, word);
+        if (word == "icmp6") return ipv6Proto(58, word);
+        if (word == "tcp" || word == "udp") {
+          if (peek() == "src" || peek() == "dst") {
+            dir = next("direction");
+            if (peek() != "port") fail("'port' is expected after '" + word + " " + dir + "'");
+          }
+          if (accept("port")) return port(word, dir, number("port"));
+          return transport(word == "tcp" ? 6 : 17, word);
+        }
+
+        if (word == "ether") {
+          std::string qualifier = next("'src', 'dst', 'host' or 'proto'");
+          if (qualifier == "proto")
+            return cmpNode(BASE_ABS, etherTypeOffset("ether proto"), 2, number("ether type"));
+          if (qualifier == "host") return ether("", next("MAC address"));
+          if (qualifier == "src" || qualifier == "dst") {
+            accept("host");
+            return ether(qualifier, next("MAC address"));
+          }
+          fail("unknown qualifier 'ether " + qualifier + "'");
+        }
+
+        if (word == "len") {
+          CmpOp op = relop();
+          return cmpNode(BASE_LEN, 0, 4, number("length"), op);
+        }
+        if (word == "greater") return cmpNode(BASE_LEN, 0, 4, number("length"), CMP_GE);
+        if (word == "less") return cmpNode(BASE_LEN, 0, 4, number("length"), CMP_LE);
+
+        if (word == "type") {
+          uint32_t type = wlanType(next("802.11 type"));
+          if (accept("subtype"))
+            return wlan(0, 1, wlanSubtype(next("802.11 subtype"), type), CMP_EQ, 0xfc);
+          return wlan(0, 1, type, CMP_EQ, 0x0c);
+        }
+        if (word == "subtype")
+          return wlan(0, 1, wlanSubtype(next("802.11 subtype"), -1), CMP_EQ, 0xfc);
+        if (word == "wlan") {
+          std::string qualifier = next("802.11 address qualifier");
+          uint32_t off = (qualifier == "addr1" || qualifier == "ra")   ? 4
+                         : (qualifier == "addr2" || qualifier == "ta") ? 10
+                         : (qualifier == "addr3")                      ? 16
+                                                                       : 0;
+          if (off == 0) fail("unknown qualifier 'wlan " + qualifier + "'");
+          uint32_t hi, lo;
+          mac(next("MAC address"), hi, lo);
+          return andNode(wlan(off, 4, hi), wlan(off + 4, 2, lo));
+        }
+
+        fail("unknown primitive '" + word + "'");
+      }
+
+      NodeP unary() {
+        if (accept("not") || accept("!")) return notNode(unary());
+        if (accept("(")) {
+          NodeP result = disjunction();
+          expect(")");
+          return result;
+        }
+        return primitive();
+      }
+
+      NodeP conjunction() {
+        NodeP result = unary();
+        while (accept("and") || accept("&&")) result = andNode(result, unary());
+        return result;
+      }
+
+      NodeP disjunction() {
+        NodeP result = conjunction();
+        while (accept("or") || accept("||")) result = orNode(result, conjunction());
+        return result;
+      }
+
+    public:
+      Parser(const std::string& filter, uint32_t linktype) : linktype(linktype) {
+        tokenize(filter);
+      }
+
+      NodeP parse() {
+        NodeP result = disjunction();
+        if (!atEnd()) fail("unexpected '" + peek() + "'");
+        return result;
+      }
+    };
+
+    // "N,code jt jf k,..." as printed by tcpdump -ddd (one instruction per line)
+    bool parseByteCode(const std::string& filter, std::vector<BpfInsn>& program) {
+      if (filter.find_first_not_of("0123456789 \t\r\n,") != std::string::npos) return false;
+      std::vector<uint64_t> values;
+      for (size_t i = 0; i < filter.size();) {
+        if (!std::isdigit((unsigned char)filter[i])) {
+          i++;
+          continue;
+        }
+        size_t start = i;
+        while (i < filter.size() && std::isdigit((unsigned char)filter[i])) i++;
+        values.push_back(strtoull(filter.substr(start, i - start).c_str(), nullptr, 10));
+      }
+      if (values.empty() || values.size() != 1 + 4 * values[0]) return false;
+      for (size_t i = 1; i < values.size(); i += 4) {
+        if (values[i] > 0xffff || values[i + 1] > 0xff || values[i + 2] > 0xff
+            || values[i + 3] > 0xffffffffULL)
+          return false;
+        BpfInsn insn;
+        insn.code = (uint16_t)values[i];
+        insn.jt = (uint32_t)values[i + 1];
+        insn.jf = (uint32_t)values[i + 2];
+        insn.k = (uint32_t)values[i + 3];
+        program.push_back(insn);
+      }
+      return true;
+    }
+  }  // namespace
+
+  bool BpfProgram::assign(std::vector<BpfInsn> program) {
+    insns.clear();
+    if (program.empty() || cls(program.back().code) != OP_RET) return false;
+    for (size_t pc = 0; pc < program.size(); pc++) {
+      const BpfInsn& insn = program[pc];
+      if (!validCode(insn.code)) return false;
+      size_t remaining = program.size() - pc - 1;
+      switch (cls(insn.code)) {
+        case OP_JMP:
+          if (insn.code == (OP_JMP | JMP_JA)) {
+            if (insn.k >= remaining) return false;
+          } else if (insn.jt >= remaining || insn.jf >= remaining) {
+            return false;
+          }
+          break;
+        case OP_LD:
+        case OP_LDX:
+          if ((insn.code & 0xe0) == MODE_MEM && insn.k >= BPF_MEMWORDS) return false;
+          break;
+        case OP_ST:
+        case OP_STX:
+          if (insn.k >= BPF_MEMWORDS) return false;
+          break;
+        case OP_ALU:
+          if (((insn.code & 0xf0) == ALU_DIV || (insn.code & 0xf0) == ALU_MOD)
+              && (insn.code & SRC_X) == SRC_K && insn.k == 0)
+            return false;
+          break;
+        default:
+          break;
+      }
+    }
+    insns = std::move(program);
+    return true;
+  }
+
+  // every jump is forward (checked by assign()), so the loop always terminates
+  uint32_t BpfProgram::run(const uint8_t* pkt, uint32_t wirelen, uint32_t caplen) const {
+    uint32_t A = 0, X = 0;
+    uint32_t M[BPF_MEMWORDS] = {0};
+
+    for (size_t pc = 0; pc < insns.size(); pc++) {
+      const BpfInsn& insn = insns[pc];
+      const uint16_t code = insn.code;
+      switch (cls(code)) {
+        case OP_RET:
+          return (code & 0x18) == RVAL_A ? A : (code & 0x18) == RVAL_X ? X : insn.k;
+
+        case OP_LD:
+          switch (code & 0xe0) {
+            case MODE_ABS:
+              if (!loadBytes(pkt, caplen, insn.k, loadSize(code), A)) return 0;
+              break;
+            case MODE_IND:
+              if (!loadBytes(pkt, caplen, (uint64_t)X + insn.k, loadSize(code), A)) return 0;
+              break;
+            case MODE_IMM:
+              A = insn.k;
+              break;
+            case MODE_MEM:
+              A = M[insn.k];
+              break;
+            case MODE_LEN:
+              A = wirelen;
+              break;
+          }
+          break;
+
+        case OP_LDX:
+          switch (code & 0xe0) {
+            case MODE_IMM:
+              X = insn.k;
+              break;
+            case MODE_MEM:
+              X = M[insn.k];
+              break;
+            case MODE_LEN:
+              X = wirelen;
+              break;
+            case MODE_MSH:
+              if (insn.k >= caplen) return 0;
+              X = (pkt[insn.k] & 0x0f) * 4;
+              break;
+          }
+          break;
+
+        case OP_ST:
+          M[insn.k] = A;
+          break;
+        case OP_STX:
+          M[insn.k] = X;
+          break;
+
+        case OP_ALU: {
+          uint32_t v = (code & SRC_X) ? X : insn.k;
+          switch (code & 0xf0) {
+            case ALU_ADD:
+              A += v;
+              break;
+            case ALU_SUB:
+              A -= v;
+              break;
+            case ALU_MUL:
+              A *= v;
+              break;
+            case ALU_DIV:
+              if (v == 0) return 0;
+              A /= v;
+              break;
+            case ALU_MOD:
+              if (v == 0) return 0;
+              A %= v;
+              break;
+            case ALU_OR:
+              A |= v;
+              break;
+            case ALU_AND:
+              A &= v;
+              break;
+            case ALU_XOR:
+              A ^= v;
+              break;
+            case ALU_LSH:
+              A = v < 32 ? A << v : 0;
+              break;
+            case ALU_RSH:
+              A = v < 32 ? A >> v : 0;
+              break;
+            case ALU_NEG:
+              A = 0 - A;
+              break;
+          }
+          break;
+        }
+
+        case OP_JMP: {
+          uint32_t v = (code & SRC_X) ? X : insn.k;
+          bool cond = false;
+          switch (code & 0xf0) {
+            case JMP_JA:
+              pc += insn.k;
+              continue;
+            case JMP_JEQ:
+              cond = (A == v);
+              break;
+            case JMP_JGT:
+              cond = (A > v);
+              break;
+            case JMP_JGE:
+              cond = (A >= v);
+              break;
+            case JMP_JSET:
+              cond = (A & v) != 0;
+              break;
+          }
+          pc += cond ? insn.jt : insn.jf;
+          break;
+        }
+
+        case OP_MISC:
+          if ((code & 0xf8) == MISC_TAX)
+            X = A;
+          else
+            A = X;
+          break;
+      }
+    }
+    return 0;
+  }
+
+  bool compileBpf(const std::string& filter, uint32_t linktype, BpfProgram& program,
+                  std::string& error) {
+    std::vector<BpfInsn> insns;
+    if (parseByteCode(filter, insns)) {
+      if (!program.assign(std::move(insns))) {
+        error = "invalid BPF byte code";
+        return false;
+      }
+      return true;
+    }
+
+    try {
+      Parser parser(filter, linktype);
+      NodeP root = parser.parse();
+      CodeGen gen;
+      insns = gen.finish(*root);
+    } catch (const CompileError& e) {
+      error = e.message;
+      return false;
+    }
+
+    if (!program.assign(std::move(insns))) {
+      error = "internal error: the compiled program is invalid";
+      return false;
+    }
+    return true;
+  }
+
+  CapturePrefilter::CapturePrefilter(const nlohmann::json& config) {
+    if (config.contains("capture_prefilter"))
+      filter = trim_copy(config["capture_prefilter"].get<std::string>());
+  }
+
+  const BpfProgram& CapturePrefilter::getProgram(uint32_t linktype) {
+    auto it = programs.find(linktype);
+    if (it != programs.end()) return it->second;
+
+    BpfProgram program;
+    std::string error;
+    if (!compileBpf(filter, linktype, program, error)) {
+      std::cerr << "capture_prefilter: cannot compile \"" << filter << "\" for linktype "
+                << linktype << ": " << error << std::endl;
+      exit(1);
+    }
+    return programs[linktype] = std::move(program);
+  }
+
+  void CapturePrefilter::apply(const std::filesystem::path& in_filepath,
+                               const std::filesystem::path& out_filepath,
+                               std::vector<uint64_t>& frame_numbers) {
+    frame_numbers.clear();
+    PcapFile pcap(in_filepath);
+    if (!pcap.is_open()) {
+      std::cerr << "capture_prefilter: " << in_filepath << " is not a pcap/pcapng file!"
+                << std::endl;
+      exit(1);
+    }
+
+    std::ofstream os(out_filepath, std::ios::binary | std::ios::trunc);
+    auto write = [&](std::string_view bytes) { os.write(bytes.data(), bytes.size()); };
+
+    // the bytes between records (the file header and pcapng blocks other than packets) are kept
+    // as they are; a compressed file is read record by record as well
+    uint64_t frame_number = 0;
+    PcapRecord rec;
+    while (pcap.next(rec)) {
+      frame_number++;
+      write(pcap.skipped());
+      if (getProgram(rec.linktype).match(rec.data, rec.len, rec.caplen)) {
+        write(pcap.raw(rec));
+        frame_numbers.push_back(frame_number);
+      }
+    }
+    write(pcap.skipped());  // the bytes after the last record
+
+    os.close();
+    if (!os) {
+      std::cerr << "capture_prefilter: failed to write " << out_filepath << std::endl;
+      exit(1);
+    }
+
+#ifndef NDEBUG
+    std::cout << "capture_prefilter: " << frame_numbers.size() << " of " << frame_number
+              << " records of " << in_filepath << " are decoded" << std::endl;
+#endif
+  }
+
+}  // namespace fpnt
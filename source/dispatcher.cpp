@@ -4,10 +4,14 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <chrono>
 #include <csignal>
+#include <cstdlib>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <thread>
+#include <tuple>
 
 namespace fpnt {
   unsigned int max_concurrency = std::thread::hardware_concurrency();
@@ -18,6 +22,18 @@ namespace fpnt {
     std::set<std::string> result;
     result.insert(".pcap");
     result.insert(".pcapng");
+    for (std::string compression : {".gz", ".zst", ".xz"}) {
+      result.insert(".pcap" + compression);
+      result.insert(".pcapng" + compression);
+    }
+    return result;
+  }
+
+  // the output files of a compressed capture are named without the compression suffix (e.g.,
+  // a.pcap.gz -> a.pcap -> a.<granularity>.csv)
+  std::filesystem::path output_relative_path(const std::filesystem::path& rel_path) {
+    auto result = rel_path;
+    if (isCompressedCapture(result)) result.replace_extension();
     return result;
   }
 
@@ -34,6 +50,52 @@ namespace fpnt {
     }
   }
 
+  namespace {
+    // the temporary files of this process, removed at exit() (see TempFileGuard)
+    std::mutex temp_files_mutex;
+    std::set<std::filesystem::path> temp_files;
+
+    void remove_temp_files() {
+      std::lock_guard<std::mutex> lock(temp_files_mutex);
+      std::error_code ec;
+      for (auto& path : temp_files) std::filesystem::remove(path, ec);
+      temp_files.clear();
+    }
+
+    /** TempFileGuard removes a temporary file when it goes out of scope. Since exit() (e.g., when
+     * a reader fails) does not destroy the local objects, the file is also removed by an atexit
+     * handler while the guard holds it.
+     */
+    class TempFileGuard {
+    private:
+      std::filesystem::path path;
+
+    public:
+      TempFileGuard() = default;
+      TempFileGuard(const TempFileGuard&) = delete;
+      TempFileGuard& operator=(const TempFileGuard&) = delete;
+      ~TempFileGuard() { reset(); }
+
+      void set(const std::filesystem::path& temp_path) {
+        reset();
+        static std::once_flag registered;
+        std::call_once(registered, []() { std::atexit(remove_temp_files); });
+        std::lock_guard<std::mutex> lock(temp_files_mutex);
+        path = temp_path;
+        temp_files.insert(path);
+      }
+
+      void reset() {
+        if (path.empty()) return;
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        std::lock_guard<std::mutex> lock(temp_files_mutex);
+        temp_files.erase(path);
+        path.clear();
+      }
+    };
+  }  // namespace
+
   Dispatcher::Dispatcher(const nlohmann::json config, std::set<std::string> extensions)
       : config(config),
         extensions(extensions),
@@ -42,7 +104,13 @@ namespace fpnt {
         out_path(config["output_path"].get<std::string>()),
         sorted(PathComparator(config["sort_by_filesize"].get<bool>())),
         in_reader(config["tshark_path"].get<std::string>(), csv_path + "input_tshark.csv",
-                  config["dfref_path"].get<std::string>()),
+                  config["dfref_path"].get<std::string>(),
+                  config.contains("dfref_index_path")
+                      ? config["dfref_index_path"].get<std::string>()
+                      : "",
+                  config.contains("dfref_index_source")
+                      ? config["dfref_index_source"].get<std::string>()
+                      : "dfref"),
         loader{config["plugins_path"].get<std::string>()} {
     file_idx = -1;
     in_pkt_idx = -1;
@@ -55,16 +123,14 @@ namespace fpnt {
     out.clear();
     out_readers.clear();
     out_maps.clear();
-    out_keys.clear();
-    out_idx2key.clear();
-    out_key2idx.clear();
-    out_child_keys.clear();
     for (size_t i = 0; i < g_lvs.size(); i++) {
       g_lv_idx[g_lvs[i]] = i;
       idxs.push_back(-1);
       out_readers.push_back(CSVReader(csv_path + "output_" + g_lvs[i] + ".csv"));
       out_maps[g_lvs[i]] = out_readers[i].read(&loader);
-      out_keys[g_lvs[i]] = std::set<std::string>();
+    }
+    if (config.contains("process_threads") && config["process_threads"].get<int>() > 0) {
+      process_threads = config["process_threads"].get<int>();
     }
 
     force_remove = config["force_remove"].get<bool>();
@@ -72,6 +138,8 @@ namespace fpnt {
 
     Dispatcher** d = (Dispatcher**)loader.getDispatcherPtr();
     *d = this;
+    // after the dispatcher pointer is set, since P_x_refs may look up the granularities
+    plan.build(g_lvs, out_maps, loader, config);
 
     chkOutputDir(out_path, force_remove);
 
@@ -83,29 +151,22 @@ namespace fpnt {
     std::cout << "Sort by Filesize setting " << config["sort_by_filesize"].get<bool>() << std::endl;
 #endif
 
-    // sort_paths
-    set_sorted_pcap_paths(in_path);
+    // sort_paths; stdin ("-") and named pipes are processed as a stream of segments
+    streaming = (in_path == "-" || std::filesystem::is_fifo(in_path));
+    if (!streaming) set_sorted_pcap_paths(in_path);
   }
 
   void Dispatcher::process_main(const std::filesystem::path abs_path) {
     // clear the current state to the dispatcher
     file_idx = counter;
     in_pkt_idx = -1;
-    in_pkts.clear();
+    in_pkts.reset({});
 
+    // out_maps and the execution plan are kept; only the records of the previous file are cleared
     idxs.clear();
     out.clear();
-    out_readers.clear();
-    out_maps.clear();
-    out_keys.clear();
-    out_idx2key.clear();
-    out_key2idx.clear();
-    out_child_keys.clear();
     for (size_t i = 0; i < g_lvs.size(); i++) {
       idxs.push_back(-1);
-      out_readers.push_back(CSVReader(csv_path + "output_" + g_lvs[i] + ".csv"));
-      out_maps[g_lvs[i]] = out_readers[i].read(&loader);
-      out_keys[g_lvs[i]] = std::set<std::string>();
     }
 
     tmp.clear();
@@ -120,18 +181,117 @@ namespace fpnt {
       }
     }
 
-    TSharkOutputReader reader_out_tshark(config, in_map, in_pkts, get_in_filepath(),
-                                         ctr_bool ? getpid() : -1);
+    bool native_decoder = false;
+    if (config.contains("native_decoder")) native_decoder = config["native_decoder"].get<bool>();
+
+    // with capture_prefilter, the accepted records are written to a temporary capture file once
+    // (at the first decode()), and it is decoded instead of the current file
+    CapturePrefilter prefilter(config);
+    std::filesystem::path decode_filepath = get_in_filepath();
+    std::vector<uint64_t> prefilter_frames;  // original frame.number of each accepted record
+    if (prefilter.enabled()) {
+      // the temporary file is not compressed even if the input is
+      std::string ext = output_relative_path(get_in_filepath()).extension().string();
+      decode_filepath = std::filesystem::temp_directory_path()
+                        / fmt::format("fpnt_prefilter_{}_{}{}", getpid(), file_idx, ext);
+    }
+    bool prefiltered = false;
+    TempFileGuard prefilter_file;  // removed even if a reader exits
+
+    // decode the fields of map from the current file into pkts by invoking read()
+    auto decode = [&](TSharkMapper& map, PacketTable& pkts) {
+      if (prefilter.enabled() && !prefiltered) {
+        prefilter_file.set(decode_filepath);
+        prefilter.apply(get_in_filepath(), decode_filepath, prefilter_frames);
+        prefiltered = true;
+      }
+
+      if (native_decoder) {
+        NativePcapReader reader_native(config, map, pkts, decode_filepath,
+                                       ctr_bool ? getpid() : -1);
+        reader_native.read();
+      } else {
+        TSharkShardReader reader_tshark(config, map, pkts, decode_filepath,
+                                        ctr_bool ? getpid() : -1);
+        reader_tshark.read();
+      }
+
+      size_t frame_number_col = pkts.col("frame.number");
+      if (prefilter.enabled() && frame_number_col != (size_t)-1
+          && !pkts.renumberColumn(frame_number_col, prefilter_frames)) {
+        std::cerr << "capture_prefilter: frame.number of " << get_in_filepath()
+                  << " cannot be mapped to the original frames!" << std::endl;
+        exit(1);
+      }
+    };
+
+    // in_pkts will be filled by the decode cache and/or by decode().
+    // the segments of a stream are never decoded again, so they are not cached
+    PacketCache cache(config, in_reader.getVersion());
+    if (streaming || !cache.enabled()) {
+      decode(in_map, in_pkts);
+    } else {
+      // the cached table may have been decoded with a different field list; the fields absent
+      // in the cache are decoded with frame.number and joined to the cached table
+      std::string frame_number_field = "frame.number";
+      std::string cache_key = cache.genKey(get_in_filepath());
+      bool cached = cache.load(cache_key, in_pkts);
+
+      TSharkMapper missing_map;
+      auto fields = in_map.getFields();
+      for (size_t i = 0; i < fields.size(); i++) {
+        if (cached && in_pkts.col(fields[i]) != (size_t)-1) continue;
+        missing_map.addField(fields[i], in_map.getName(i), in_map.getDesc(i), in_map.getType(i),
+                             in_map.getVer(i));
+      }
+      if (missing_map[frame_number_field] == (size_t)-1)
+        missing_map.addField(frame_number_field, frame_number_field);
+
+      if (!cached) {
+        decode(missing_map, in_pkts);
+        cache.save(cache_key, in_pkts);
+      } else if (missing_map.getFields().size() > 1) {
+#ifndef NDEBUG
+        std::cout << "decode cache: " << missing_map.getFields().size() - 1
+                  << " fields are decoded additionally" << std::endl;
+#endif
+        PacketTable missing_pkts;
+        decode(missing_map, missing_pkts);
+        if (!in_pkts.join(missing_pkts, frame_number_field)) {
+          std::cerr << "decode cache: the cached packets of " << get_in_filepath()
+                    << " are inconsistent; every field is decoded again." << std::endl;
+          missing_map = in_map;
+          if (missing_map[frame_number_field] == (size_t)-1)
+            missing_map.addField(frame_number_field, frame_number_field);
+          decode(missing_map, in_pkts);
+        }
+        cache.save(cache_key, in_pkts);
+      }
+
+      in_pkts.project(fields);  // column idx == field idx of in_map
+    }
 
-    reader_out_tshark.read();  // in_pkts will be filled by invoking this function.
+    prefilter_file.reset();  // the decoded packets are in in_pkts
 
     process_base();
-    for (size_t i = 0; i < g_lvs.size(); i++) {
-      process(g_lvs[i]);
+    for (auto& g : g_lvs) out[g];  // not inserted while the granularities run concurrently
+    for (auto& wave : plan.getWaves()) {
+      // the granularities of a wave do not read each other; they run concurrently if their steps
+      // are thread-safe and declare their references
+      std::vector<std::thread> threads;
+      for (size_t level : wave) {
+        const GranularityPlan& g_plan = plan.at(level);
+        if (process_threads > 1 && wave.size() > 1 && g_plan.threadsafe && !g_plan.opaque) {
+          threads.emplace_back([this, level]() { process(g_lvs[level], true); });
+        } else {
+          process(g_lvs[level]);
+        }
+      }
+      for (auto& thread : threads) thread.join();
     }
 
     for (size_t i = 0; i < g_lvs.size(); i++) {
-      writer(g_lvs[i]);
+      if (plan.at(i).written) writer(g_lvs[i]);
     }
 
     // print_buf_pkt(out_pkt_filepath.c_str());
@@ -161,7 +321,9 @@ namespace fpnt {
       // Do Nothing
     }
 
-    for (auto abs_filepath : sorted) {
+    // process a file (in a child process if multiprocessing is on); remove_after is used for the
+    // temporary segment files of a stream
+    auto run = [this](const std::filesystem::path& abs_filepath, bool remove_after) {
       if (multiprocessing == true) {
         int rc = fork();
 
@@ -188,10 +350,19 @@ namespace fpnt {
           std::cout << "child" << std::endl;
 #endif
           process_main(abs_filepath);
+          if (remove_after) std::filesystem::remove(abs_filepath);
           exit(0);
         }
-      } else
+      } else {
         process_main(abs_filepath);
+        if (remove_after) std::filesystem::remove(abs_filepath);
+      }
+    };
+
+    if (streaming) {
+      dispatch_stream(run);
+    } else {
+      for (auto abs_filepath : sorted) run(abs_filepath, false);
     }
 
     // std::cout << "parent multiprocessing no_processes " << multiprocessing << " " <<
@@ -214,12 +385,109 @@ namespace fpnt {
     }
   }
 
+  void Dispatcher::dispatch_stream(
+      const std::function<void(const std::filesystem::path&, bool)>& run) {
+    PcapStream stream(in_path);
+    if (!stream.is_open()) {
+      std::cerr << "dispatch_stream: cannot open " << in_path << std::endl;
+      exit(1);
+    }
+
+    // a segment is closed when it has stream_segment_pkts packets (the hard cap on the packets
+    // to be decoded at once) or when stream_segment_seconds have passed since its first packet
+    size_t max_pkts = 100000;
+    if (config.contains("stream_segment_pkts"))
+      max_pkts = config["stream_segment_pkts"].get<size_t>();
+    if (max_pkts == 0) max_pkts = 1;
+    double max_seconds = 0;
+    if (config.contains("stream_segment_seconds"))
+      max_seconds = config["stream_segment_seconds"].get<double>();
+
+    std::string name = (in_path == "-") ? "stdin" : std::filesystem::path(in_path).stem().string();
+    size_t segment_idx = 0;
+    std::filesystem::path segment_path;
+    std::ofstream segment;
+    size_t segment_pkts = 0;
+    auto deadline = std::chrono::steady_clock::now();
+
+    auto open_segment = [&]() {
+      segment_path = std::filesystem::temp_directory_path()
+                     / fmt::format("fpnt_stream_{}_{}{}", getpid(), segment_idx,
+                                   stream.is_pcapng() ? ".pcapng" : ".pcap");
+      segment.open(segment_path, std::ios::binary | std::ios::trunc);
+      segment.write(stream.header().data(), stream.header().size());
+      segment_pkts = 0;
+      deadline = std::chrono::steady_clock::now()
+                 + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                     std::chrono::duration<double>(max_seconds));
+    };
+
+    auto close_segment = [&]() {
+      if (!segment.is_open()) return;
+      segment.close();
+      if (!segment) {
+        std::cerr << "dispatch_stream: failed to write " << segment_path << std::endl;
+        exit(1);
+      }
+      if (segment_pkts == 0) {  // only non-packet blocks
+        std::filesystem::remove(segment_path);
+        return;
+      }
+      // outputs are named after the stream, e.g., stdin_000000.<granularity>.csv
+      relative_path[segment_path] = fmt::format("{}_{:06}{}", name, segment_idx,
+                                                segment_path.extension().string());
+      segment_idx++;
+      run(segment_path, true);
+      // the segment is processed (or a child process has its own copy of the entry)
+      relative_path.erase(segment_path);
+    };
+
+    while (true) {
+      std::string_view bytes;
+      PcapStream::Unit unit;
+      while ((unit = stream.next(bytes)) != PcapStream::UNIT_NONE) {
+        if (unit == PcapStream::UNIT_HEADER) {
+          if (segment.is_open()) segment.write(bytes.data(), bytes.size());
+          continue;
+        }
+        if (!segment.is_open()) open_segment();
+        segment.write(bytes.data(), bytes.size());
+        if (unit == PcapStream::UNIT_PACKET && ++segment_pkts >= max_pkts) close_segment();
+      }
+
+      if (stream.failed()) {
+        std::cerr << "dispatch_stream: " << in_path << " is not a valid pcap/pcapng stream!"
+                  << std::endl;
+        break;
+      }
+      if (stream.at_end()) break;
+
+      int timeout_ms = -1;
+      if (segment.is_open() && max_seconds > 0) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+          close_segment();
+          continue;
+        }
+        timeout_ms = (int)std::min<int64_t>(remaining.count(), INT32_MAX);
+      }
+      stream.fill(timeout_ms);
+    }
+    close_segment();
+
+#ifndef NDEBUG
+    std::cout << "dispatch_stream: " << segment_idx << " segments of " << in_path
+              << " are dispatched" << std::endl;
+#endif
+  }
+
   void Dispatcher::print_buf_pkt(std::string out_pkt_filepath) {
-    for (auto& it : in_pkts) {
+    for (size_t idx = 0; idx < in_pkts.size(); idx++) {
       std::cout << "File [" << out_pkt_filepath << "]: ";
       for (auto& col_name : in_map.getFields()) {
         // cout << col_name << endl;
-        std::cout << it[col_name].get<std::string>() << "\t";
+        std::cout << in_pkts.str(idx, col_name) << "\t";
       }
       std::cout << std::endl;
     }
@@ -232,117 +500,234 @@ namespace fpnt {
       idxs[i] = -1;
     }
 
-    // preparation of key generation
+    // preparation of key generation; the direction of a packet in the record of a granularity
+    // whose key generator has a direction is stored as __<granularity>_dir in the packet record
     std::vector<fnptr_genKeyFn> genKeyFns;
+    std::vector<fnptr_genKeyDirFn> genKeyDirFns;
+    std::vector<fnptr_genKeyTupleFn> genKeyTupleFns;
+    std::vector<std::string> dir_fields;
+    std::vector<char> has_dir(g_lvs.size(), 0);
     for (size_t i = 0; i < g_lvs.size(); i++) {
-      genKeyFns.push_back(loader.getGenKeyFn(config["genKey_" + g_lvs[i]]));
+      genKeyFns.push_back(plan.at(i).genKey);
+      genKeyDirFns.push_back(plan.at(i).genKeyDir);
+      genKeyTupleFns.push_back(plan.at(i).genKeyTuple);
+      dir_fields.push_back("__" + g_lvs[i] + "_dir");
+      has_dir[i] = (genKeyDirFns[i] != nullptr || genKeyTupleFns[i] != nullptr);
     }
+    std::vector<int> dirs(g_lvs.size(), 0);
+    const bool has_dirs = std::find(has_dir.begin(), has_dir.end(), 1) != has_dir.end();
+
+    // the records of a granularity with a tuple key generator are found by their binary keys; the
+    // key string is generated only for the first packet of a record
+    std::vector<FlowIndex> tuple_idxs(g_lvs.size());
+    FlowTuple tuple;
 #ifndef NDEBUG
     std::cout << "in_pkts_size: " << in_pkts.size() << std::endl;
 #endif
 
+    // the field names of the record IDs, which are stored in the records of each granularity
+    std::vector<std::string> idx_fields;
+    for (auto& g : g_lvs) idx_fields.push_back("__" + g + "_idx");
+    std::vector<RecordTable*> tables;
+    for (auto& g : g_lvs) tables.push_back(&out[g]);
+    hierarchy.reset(g_lvs.size());
+
     // this loop assumes that one in_pkt == one out_pkt
     // so that after generating keys out pkts are inserted immediately
+    std::vector<uint32_t> ids(g_lvs.size());
     for (size_t idx = 0; idx < in_pkts.size(); idx++) {  // for each in_pkt
       in_pkt_idx = idx;
 
-      std::vector<std::string> keys(g_lvs.size());
-      std::vector<std::string> idxs(g_lvs.size());
       for (size_t i = 0; i < g_lvs.size(); i++) {
         size_t cnt = (g_lvs.size() - 1)
                      - i;  // iterate from the top (the most grouped) granularity to the bottom
-        keys[cnt] = genKeyFns[cnt](in_pkts[idx], g_lvs[cnt], keys[cnt]);
+        uint32_t cnt_id = RecordTable::NO_ID;
+        bool has_tuple = false;
+        if (genKeyTupleFns[cnt] != nullptr) {
+          tuple.clear();
+          has_tuple = genKeyTupleFns[cnt](in_pkts[idx], g_lvs[cnt], tuple, dirs[cnt]);
+          if (has_tuple) cnt_id = tuple_idxs[cnt].find(tuple);
+        }
 
-        in_pkts[idx]["__" + g_lvs[cnt] + "_key"]
-            = keys[cnt];  // inject the generated key to in_pkts
+        bool is_new = false;
+        if (cnt_id == RecordTable::NO_ID) {
+          std::string key;  // a key generator receives an empty key, as it always did
+          int dir = 0;
+          if (genKeyDirFns[cnt] != nullptr) {
+            key = genKeyDirFns[cnt](in_pkts[idx], g_lvs[cnt], key, dir);
+          } else {
+            key = genKeyFns[cnt](in_pkts[idx], g_lvs[cnt], key);
+          }
+          if (!has_tuple) dirs[cnt] = dir;
 
-        size_t cnt_idx = out_keys[g_lvs[cnt]].size();
-        auto result
-            = out_keys[g_lvs[cnt]].insert(keys[cnt]);  // inject the generated key to out_keys
+          // intern the generated key; a new key gets the next ID
+          std::tie(cnt_id, is_new) = tables[cnt]->insert(key);
+          if (has_tuple) tuple_idxs[cnt].insert(tuple, cnt_id);
+        }
+        ids[cnt] = cnt_id;
 
-        if (result.second) {  // create a record object if a new key is injected to out_keys
-          nlohmann::json out_obj;
+        if (is_new) {  // fill the new record with the IDs of itself and its parent records
+          nlohmann::json& out_obj = (*tables[cnt])[cnt_id];
           out_obj["__in_idx"] = idx;
-          // std::cout << "__in_idx: " << idx << " g_lvs[cnt] " << g_lvs[cnt] << " " << keys[cnt] <<
-          // " idx2keysize " << out_idx2key[g_lvs[cnt]].size() << " key2idxsize " <<
-          // out_key2idx[g_lvs[cnt]].size() << std::endl;
-          out[g_lvs[cnt]][keys[cnt]] = out_obj;
-          // out_idx2key[g_lvs[cnt]][cnt_idx] = keys[cnt];
-          out_idx2key[g_lvs[cnt]].push_back(keys[cnt]);
-          out_key2idx[g_lvs[cnt]][keys[cnt]] = cnt_idx;
-
-          // std::cout << "[DEBUG] ----- New Record in " << g_lvs[cnt] << " with key " << keys[cnt]
-          // << std::endl;
+          for (size_t k = cnt; k < g_lvs.size(); k++) out_obj[idx_fields[k]] = ids[k];
 
-          for (size_t j = cnt; j < g_lvs.size(); j++) {
-            for (size_t k = j; k < g_lvs.size(); k++) {
-              out[g_lvs[j]][keys[j]]["__" + g_lvs[k] + "_key"] = keys[k];
-              // std::cout << "" << g_lvs[j] << "'s record " << keys[j] << "now has __" << g_lvs[k]
-              // << "_key field with value:" << keys[k] <<std::endl;
-            }
-            out[g_lvs[j]][keys[j]]["__" + g_lvs[cnt] + "_idx"] = cnt_idx;  // =idxs[cnt]
+          // std::cout << "[DEBUG] ----- New Record in " << g_lvs[cnt] << " with key " << key
+          // << std::endl;
 
-            if (j == cnt + 1) {  // in case of parent
-              out_child_keys[g_lvs[j]][keys[j]].push_back(keys[cnt]);
-            }
+          for (size_t j = cnt + 1; j < g_lvs.size(); j++) {
+            (*tables[j])[ids[j]][idx_fields[cnt]] = cnt_id;  // the last child of each parent
           }
-        } else {  // if it is an existing key, cnt_idx points to the corresponding out record object
-          cnt_idx = out_key2idx[g_lvs[cnt]][keys[cnt]];
+          hierarchy.addRecord(cnt, cnt + 1 < g_lvs.size() ? ids[cnt + 1] : RecordTable::NO_ID);
+        }  // if it is an existing key, cnt_id points to the corresponding out record object
+      }
+
+      if (has_dirs) {
+        nlohmann::json& pkt_record = (*tables[0])[ids[0]];
+        for (size_t i = 0; i < g_lvs.size(); i++) {
+          if (has_dir[i]) pkt_record[dir_fields[i]] = dirs[i];
         }
-        idxs[cnt] = cnt_idx;
-        // new keys[cnt] idxs[cnt] have appropriate values
       }
     }
+
+    hierarchy.build();
   }
 
-  void Dispatcher::process(std::string granularity) {
+  void Dispatcher::process(std::string granularity, bool concurrent) {
     // idx initialization except the current 'granularity'
     size_t ptr_g = -1;
     for (size_t i = 0; i < g_lvs.size(); i++) {
-      idxs[i] = -1;
+      if (!concurrent) idxs[i] = -1;
       if (g_lvs[i] == granularity) ptr_g = i;
     }
 
-    auto out_fields = out_maps[granularity].getFields();
-
-    // optimization for prep_fns_opts; more optimization is needed
-    std::vector<std::vector<std::pair<std::string, std::string>>> vec_prep_fns_opts;
-    for (auto& out_field : out_fields) {
-      auto prep_fns_opts = out_maps[granularity].getPrepFns(out_field);
-      vec_prep_fns_opts.push_back(prep_fns_opts);
-    }
+    const GranularityPlan& g_plan = plan[granularity];
+    const size_t no_records = get_records(granularity).size();  // may run concurrently
 
 #ifndef NDEBUG
-    std::cout << "Processing granuality: " << granularity << " with "
-              << out_idx2key[granularity].size() << " records." << std::endl;
+    std::cout << "Processing granuality: " << granularity << " with " << no_records << " records."
+              << std::endl;
 #endif
 
-    for (size_t idx = 0; idx < out_idx2key[granularity].size(); idx++) {
-      idxs[ptr_g] = idx;
+    // the record range is partitioned among threads only if every step is thread-safe
+    size_t no_threads = std::min(process_threads, no_records / PLAN_BATCH_RECORDS + 1);
+    if (!g_plan.threadsafe || no_threads <= 1) {
+      ProcessContext& ctx = context();
+      if (concurrent) {
+        ctx.idxs.assign(g_lvs.size(), -1);
+      } else {
+        ctx.idxs = idxs;
+      }
+      ctx.tmp.clear();
+      processRange(g_plan, granularity, ptr_g, 0, no_records, ctx, !concurrent);
+      if (!concurrent) idxs[ptr_g] = -1;
+      return;
+    }
 
-      const std::string& cnt_out_key = out_idx2key[granularity][idx];
-      // const size_t cnt_out_idx = out_key2idx[granularity][cnt_out_key];
-      nlohmann::json* record_ptr = &out[granularity][cnt_out_key];
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < no_threads; t++) {
+      size_t first = no_records * t / no_threads;
+      size_t last = no_records * (t + 1) / no_threads;
+      threads.emplace_back([this, &g_plan, granularity, ptr_g, first, last]() mutable {
+        ProcessContext& ctx = context();
+        ctx.idxs.assign(g_lvs.size(), -1);
+        ctx.tmp.clear();
+        processRange(g_plan, granularity, ptr_g, first, last, ctx, false);
+      });
+    }
+    for (auto& thread : threads) thread.join();
+    if (!concurrent) idxs[ptr_g] = -1;
+  }
 
-      size_t field_idx = 0;
-      for (auto& out_field : out_fields) {
-        for (auto& [str_fn, option] : vec_prep_fns_opts[field_idx]) {
-          auto prep_fn = loader.getPrepFn(str_fn);
-          prep_fn(option, *record_ptr, granularity, cnt_out_key, out_field);
-        }
+  ProcessContext& Dispatcher::context() {
+    static thread_local ProcessContext ctx;
+    return ctx;
+  }
 
-        if ((*record_ptr)[out_field].is_null()) {
-          (*record_ptr)[out_field] = "";
+  /** processRange processes the records [first, last) of a granularity. The batched runs of the
+   * plan (see ExecutionPlan::schedule) are run column by column over blocks of PLAN_BATCH_RECORDS
+   * records, so that a batch function is called once per block; the other runs are run record by
+   * record within the block. Every record has the previous columns when a column is computed, as
+   * in the per-record order. idxs of the dispatcher is updated along with ctx.idxs only if
+   * update_idxs is true (i.e., not in a worker thread).
+   */
+  void Dispatcher::processRange(const GranularityPlan& g_plan, std::string& granularity,
+                                size_t ptr_g, size_t first, size_t last, ProcessContext& ctx,
+                                bool update_idxs) {
+    RecordTable& records_of_g = out.find(granularity)->second;
+    auto set_idx = [&](size_t idx) {
+      ctx.idxs[ptr_g] = idx;
+      if (update_idxs) idxs[ptr_g] = idx;
+    };
+    auto to_typed = [](nlohmann::json& record, const PlanColumn& column) {
+      auto& value = record[column.field];
+      if (value.is_null()) {
+        value = "";
+      } else {
+        toTyped(value, column.type);
+      }
+    };
+    // the columns order[begin, end) of a record
+    auto process_record = [&](size_t idx, size_t begin, size_t end) {
+      set_idx(idx);
+
+      const std::string& cnt_out_key = records_of_g.key(idx);
+      nlohmann::json* record_ptr = &records_of_g[idx];
+
+      for (size_t pos = begin; pos < end; pos++) {
+        const PlanColumn& column = g_plan.columns[g_plan.order[pos]];
+        for (auto& step : column.steps) {
+          step.apply(*record_ptr, granularity, cnt_out_key, column.field);
         }
-        field_idx++;
+        to_typed(*record_ptr, column);
       }
+    };
+
+    if (!g_plan.batched) {
+      for (size_t idx = first; idx < last; idx++) {
+        process_record(idx, 0, g_plan.order.size());
 
 #ifndef NDEBUG
-      if (idx % 1000000 == 0) std::cout << "idx: " << idx << std::endl;
+        if (idx % 1000000 == 0) std::cout << "idx: " << idx << std::endl;
 #endif
+      }
+      set_idx(-1);
+      return;
     }
 
-    idxs[ptr_g] = -1;
+    std::vector<nlohmann::json*> records;
+    records.reserve(PLAN_BATCH_RECORDS);
+
+    for (size_t block = first; block < last; block += PLAN_BATCH_RECORDS) {
+      const size_t count = std::min(PLAN_BATCH_RECORDS, last - block);
+      records.clear();
+      for (size_t i = 0; i < count; i++) {
+        records.push_back(&records_of_g[block + i]);
+      }
+
+      for (auto& run : g_plan.runs) {
+        if (!run.batched) {
+          for (size_t i = 0; i < count; i++) process_record(block + i, run.begin, run.end);
+          continue;
+        }
+        for (size_t pos = run.begin; pos < run.end; pos++) {
+          const PlanColumn& column = g_plan.columns[g_plan.order[pos]];
+          for (auto& step : column.steps) {
+            if (step.batch_fn != nullptr) {
+              set_idx(-1);
+              step.applyBatch(granularity, block, count, records.data(), column.field);
+              continue;
+            }
+            for (size_t i = 0; i < count; i++) {
+              set_idx(block + i);
+              step.apply(*records[i], granularity, records_of_g.key(block + i), column.field);
+            }
+          }
+
+          for (size_t i = 0; i < count; i++) to_typed(*records[i], column);
+        }
+      }
+    }
+    set_idx(-1);
   }
 
   /** writer writes the output records of the specified granularity into CSV file
@@ -389,14 +774,16 @@ namespace fpnt {
     }
 
     // size_t size_fields = cur_map->getFields().size();
-    for (size_t idx = 0; idx < out_idx2key[granularity].size(); idx++) {
-      const std::string& cnt_out_key = out_idx2key[granularity][idx];
-      auto& row = out[granularity][cnt_out_key];
+    const std::vector<PlanColumn>& columns = plan[granularity].columns;
+    RecordTable& records_of_g = out[granularity];
+    for (size_t idx = 0; idx < records_of_g.size(); idx++) {
+      auto& row = records_of_g[idx];
 
       std::vector<std::string> row_vector;
-      for (auto& field : cur_map->getFields()) {
+      row_vector.reserve(columns.size());
+      for (auto& column : columns) {
         // std::cout << "ROW: " << row.dump() << std::endl;
-        row_vector.push_back(row[field]);
+        row_vector.push_back(formatValue(row[column.field], column.type));
       }
       csv_writer << row_vector;
       if (stdout_writer) *stdout_writer << row_vector;
@@ -404,78 +791,64 @@ namespace fpnt {
     if (stdout_writer) delete stdout_writer;
   }
 
-  size_t Dispatcher::get_idx(std::string key, std::string from, std::string to) {  // v0.3
-    nlohmann::json* cnt_obj = &out[from][key];
-    if (to == "eq" || from == to) {
-      return (*cnt_obj)["__" + to + "_idx"].get<size_t>();
+  size_t Dispatcher::get_lv(const std::string& granularity) const {
+    auto it = g_lv_idx.find(granularity);
+    if (it == g_lv_idx.end()) {
+      std::cerr << "unknown granularity " << granularity << "!" << std::endl;
+      exit(1);
     }
+    return it->second;
+  }
 
-    if (g_lv_idx[from] > g_lv_idx[to]) {
+  const RecordTable& Dispatcher::get_records(const std::string& granularity) const {
+    get_lv(granularity);
+    return out.at(granularity);
+  }
+
+  size_t Dispatcher::get_idx(std::string key, std::string from, std::string to) const {  // v0.3
+    if (to == "eq") to = from;
+    const size_t lv_from = get_lv(from), lv_to = get_lv(to);
+    if (lv_from > lv_to) {
       std::cerr << "please use get_idxs to access lower granuality records!" << std::endl;
       exit(1);
     }
 
-    // now g_lv_idx[from] < g_lv_idx[to]
-    return (*cnt_obj)["__" + to + "_idx"].get<size_t>();
+    // now lv_from <= lv_to
+    return hierarchy.ancestor(lv_from, lv_to, get_records(from).id(key));
   }
 
   /*
    */
-  std::string Dispatcher::get_key(std::string key, std::string from, std::string to) {  // v0.3
-    nlohmann::json* cnt_obj = &out[from][key];
-    if (to == "eq" || from == to) {
-      return (*cnt_obj)["__" + to + "_key"].get<std::string>();
-    }
-
-    if (g_lv_idx[from] > g_lv_idx[to]) {
-      std::cerr << "please use get_idxs to access lower granuality records!" << std::endl;
-      exit(1);
-    }
-
-    // now g_lv_idx[from] < g_lv_idx[to]
-    return (*cnt_obj)["__" + to + "_key"].get<std::string>();
+  std::string Dispatcher::get_key(std::string key, std::string from,
+                                  std::string to) const {  // v0.3
+    if (to == "eq") to = from;
+    return get_records(to).key(get_idx(key, from, to));
   }
 
   std::vector<size_t> Dispatcher::get_idxs(std::string key, std::string from,
-                                           std::string to) {  // v0.3
-    if (g_lv_idx[from] <= g_lv_idx[to]) {
+                                           std::string to) const {  // v0.3
+    std::span<const uint32_t> ids = get_idx_span(key, from, to);
+    return std::vector<size_t>(ids.begin(), ids.end());
+  }
+
+  std::span<const uint32_t> Dispatcher::get_idx_span(const std::string& key,
+                                                     const std::string& from,
+                                                     const std::string& to) const {
+    const size_t lv_from = get_lv(from), lv_to = get_lv(to);
+    if (lv_from <= lv_to) {
       std::cerr << "please use get_idx to access higher granuality records!" << std::endl;
       exit(1);
     }
 
-    // g_lv_idx[from] > g_lv_idx[to]
-    std::vector<size_t> result;
-    std::vector<std::string> cnt_child_keys = out_child_keys[from][key];
-    for (auto& x : cnt_child_keys) {
-      if (g_lv_idx[from] == g_lv_idx[to] + 1) {
-        result.push_back(out_key2idx[to][x]);
-      } else {
-        std::vector<std::size_t> child_result = get_idxs(x, g_lvs[g_lv_idx[from] - 1], to);
-        result.insert(result.end(), child_result.begin(), child_result.end());
-      }
-    }
-
-    return result;
+    // lv_from > lv_to
+    return hierarchy.descendants(lv_from, lv_to, get_records(from).id(key));
   }
 
   std::vector<std::string> Dispatcher::get_keys(std::string key, std::string from,
-                                                std::string to) {  // v0.3
-    if (g_lv_idx[from] <= g_lv_idx[to]) {
-      std::cerr << "please use get_idx to access higher granuality records!" << std::endl;
-      exit(1);
-    }
-
-    // g_lv_idx[from] > g_lv_idx[to]
+                                                std::string to) const {  // v0.3
     std::vector<std::string> result;
-    std::vector<std::string> cnt_child_keys = out_child_keys[from][key];
-    for (auto& x : cnt_child_keys) {
-      if (g_lv_idx[from] == g_lv_idx[to] + 1) {
-        result.push_back(x);
-      } else {
-        std::vector<std::string> child_result = get_keys(x, g_lvs[g_lv_idx[from] - 1], to);
-        result.insert(result.end(), child_result.begin(), child_result.end());
-      }
-    }
+    const RecordTable& records = get_records(to);
+    for (uint32_t id : get_idx_span(key, from, to)) result.push_back(records.key(id));
     return result;
   }
 
@@ -569,11 +942,11 @@ namespace fpnt {
     // If input path is a regular file (with .pcap or .pcapng extension) or a symbolic link (in a
     // recursive manner), insert the actual regular file and return
     if (std::filesystem::is_regular_file(input_pcap_path)) {
-      std::string ext = input_pcap_path.extension();
+      std::string ext = captureExtension(input_pcap_path);
       if (this->extensions.contains(ext)) {
         auto canonical_path = std::filesystem::canonical(input_pcap_path);
         this->sorted.insert(canonical_path);
-        this->relative_path[canonical_path] = input_pcap_path.filename();
+        this->relative_path[canonical_path] = output_relative_path(input_pcap_path.filename());
         return this->sorted;
       }
     } else if (std::filesystem::is_directory(input_pcap_path)) {
@@ -588,12 +961,12 @@ namespace fpnt {
 
               // 1. Regular File
               if (entry.is_regular_file()) {
-                std::string ext = entry_path.extension();
+                std::string ext = captureExtension(entry_path);
                 if (this->extensions.contains(ext)) {
                   // entry_path is absolute; relative will give an relative path
                   this->sorted.insert(entry_path);
                   std::filesystem::path rel_path
-                      = std::filesystem::relative(entry_path, current_path);
+                      = output_relative_path(std::filesystem::relative(entry_path, current_path));
                   if (preamble != ".")
                     this->relative_path[entry_path] = preamble / rel_path;
                   else
@@ -607,7 +980,7 @@ namespace fpnt {
                 // note: no treatment of multiple symlink
                 if (is_regular_file(abs_entry_path)) {
                   this->sorted.insert(abs_entry_path);
-                  std::filesystem::path rel_path = entry_path.filename();
+                  std::filesystem::path rel_path = output_relative_path(entry_path.filename());
                   // std::cout << "Rel_path " << rel_path << std::endl;
                   if (preamble != ".")
                     this->relative_path[entry_path] = preamble / rel_path;
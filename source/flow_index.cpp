@@ -0,0 +1,69 @@
+#include <fpnt/flow_index.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace fpnt {
+
+  namespace {
+    constexpr size_t FLOW_INDEX_MIN_SLOTS = 1024;  // a power of two
+  }  // namespace
+
+  uint64_t FlowIndex::hash(const FlowTuple& tuple) {
+    uint64_t words[sizeof(FlowTuple) / sizeof(uint64_t)];
+    memcpy(words, &tuple, sizeof(words));
+    uint64_t h = 0x9E3779B97F4A7C15ULL;
+    for (uint64_t word : words) {
+      h ^= word;
+      h *= 0xBF58476D1CE4E5B9ULL;
+      h ^= h >> 31;
+    }
+    return h;
+  }
+
+  size_t FlowIndex::find(const FlowTuple& tuple) const {
+    if (values.empty()) return -1;
+    const size_t mask = values.size() - 1;
+    for (size_t slot = hash(tuple) & mask;; slot = (slot + 1) & mask) {
+      if (values[slot] == 0) return -1;
+      if (tuples[slot] == tuple) return values[slot] - 1;
+    }
+  }
+
+  void FlowIndex::insert(const FlowTuple& tuple, size_t idx) {
+    if (idx >= UINT32_MAX) {
+      std::cerr << "FlowIndex: too many records!" << std::endl;
+      exit(1);
+    }
+    if ((no_entries + 1) * 2 > values.size()) grow();
+    const size_t mask = values.size() - 1;
+    size_t slot = hash(tuple) & mask;
+    while (values[slot] != 0) slot = (slot + 1) & mask;
+    tuples[slot] = tuple;
+    values[slot] = idx + 1;
+    no_entries++;
+  }
+
+  void FlowIndex::grow() {
+    std::vector<FlowTuple> old_tuples(std::max(values.size() * 2, FLOW_INDEX_MIN_SLOTS));
+    std::vector<uint32_t> old_values(old_tuples.size(), 0);
+    old_tuples.swap(tuples);
+    old_values.swap(values);
+
+    const size_t mask = values.size() - 1;
+    for (size_t i = 0; i < old_values.size(); i++) {
+      if (old_values[i] == 0) continue;
+      size_t slot = hash(old_tuples[i]) & mask;
+      while (values[slot] != 0) slot = (slot + 1) & mask;
+      tuples[slot] = old_tuples[i];
+      values[slot] = old_values[i];
+    }
+  }
+
+  void FlowIndex::clear() {
+    std::vector<FlowTuple>().swap(tuples);
+    std::vector<uint32_t>().swap(values);
+    no_entries = 0;
+  }
+
+}  // namespace fpnt
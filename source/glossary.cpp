@@ -0,0 +1,301 @@
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <fpnt/glossary.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace fpnt {
+
+  namespace {
+    constexpr char GLOSSARY_MAGIC[8] = {'F', 'P', 'N', 'T', 'G', 'L', 'S', '1'};
+    constexpr uint64_t GLOSSARY_BYTE_ORDER = 0x0102030405060708ULL;
+
+    // magic, byte order, key length, number of entries, pool size
+    constexpr size_t HEADER_SIZE = 8 + 4 * sizeof(uint64_t);
+
+    inline size_t align8(size_t x) { return (x + 7) & ~(size_t)7; }
+
+    inline uint64_t load64(const uint8_t* p) {
+      uint64_t word;
+      memcpy(&word, p, sizeof(word));
+      return word;
+    }
+
+    std::vector<std::string> splitTab(const std::string& line) {
+      std::vector<std::string> result;
+      std::stringstream ss(line);
+      for (std::string col; std::getline(ss, col, '\t');) result.push_back(col);
+      return result;
+    }
+  }  // namespace
+
+  // a row contains three columns starting </td><td>: description, type and versions
+  void parseDfrefRow(const std::string& row, GlossaryEntry& entry) {
+    std::string found_string = row;
+    for (int i = 0; i < 3; i++) {
+      std::size_t l = found_string.find("</td><td>");
+      std::size_t r = found_string.substr(l + 5).find("</td>");
+      std::string x = found_string.substr(l + 5 + 4, r - 4);
+      found_string = found_string.substr(l + 5 + r);
+      switch (i) {
+        case 0:  // Description
+          entry.desc = x;
+          break;
+        case 1:  // Type
+          entry.type = x;
+          break;
+        case 2:  // Versions
+          entry.ver = x;
+          break;
+      }
+    }
+  }
+
+  void FieldGlossary::close() {
+    if (base != nullptr) munmap((void*)base, length);
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    base = nullptr;
+    length = 0;
+    entries = nullptr;
+    no_entries = 0;
+    pool = nullptr;
+    pool_size = 0;
+  }
+
+  bool FieldGlossary::open(const std::filesystem::path& path, const std::string& key) {
+    close();
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < HEADER_SIZE) {
+      close();
+      return false;
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      close();
+      return false;
+    }
+    base = (const uint8_t*)addr;
+    length = st.st_size;
+    madvise(addr, length, MADV_RANDOM);  // binary search touches a few pages only
+
+    const uint8_t* p = base;
+    uint64_t byte_order = load64(p + 8);
+    uint64_t key_len = load64(p + 16);
+    uint64_t n = load64(p + 24);
+    uint64_t pool_len = load64(p + 32);
+    size_t entries_off = HEADER_SIZE + align8(key_len);
+
+    if (memcmp(p, GLOSSARY_MAGIC, sizeof(GLOSSARY_MAGIC)) != 0
+        || byte_order != GLOSSARY_BYTE_ORDER || key_len != key.size()
+        || entries_off > length || n > (length - entries_off) / sizeof(Entry)
+        || pool_len != length - entries_off - n * sizeof(Entry)
+        || memcmp(p + HEADER_SIZE, key.data(), key_len) != 0) {
+      close();
+      return false;
+    }
+
+    entries = (const Entry*)(base + entries_off);
+    no_entries = n;
+    pool = (const char*)(base + entries_off + n * sizeof(Entry));
+    pool_size = pool_len;
+    return true;
+  }
+
+  bool FieldGlossary::view(uint32_t off, uint32_t len, std::string_view& out) const {
+    if ((size_t)off + len > pool_size) return false;
+    out = std::string_view(pool + off, len);
+    return true;
+  }
+
+  bool FieldGlossary::find(const std::string& field, GlossaryEntry& entry) const {
+    size_t lo = 0, hi = no_entries;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      std::string_view name;
+      if (!view(entries[mid].name_off, entries[mid].name_len, name)) return false;
+      int cmp = name.compare(field);
+      if (cmp < 0) {
+        lo = mid + 1;
+      } else if (cmp > 0) {
+        hi = mid;
+      } else {
+        const Entry& e = entries[mid];
+        std::string_view desc, type, ver;
+        if (!view(e.desc_off, e.desc_len, desc) || !view(e.type_off, e.type_len, type)
+            || !view(e.ver_off, e.ver_len, ver))
+          return false;
+        entry.desc = desc;
+        entry.type = type;
+        entry.ver = ver;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool FieldGlossary::write(const std::filesystem::path& path, const std::string& key,
+                            const std::map<std::string, GlossaryEntry>& fields) {
+    // std::map is sorted by the field name, which is the order of the binary search
+    std::vector<Entry> table;
+    table.reserve(fields.size());
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> interned;  // types and versions repeat a lot
+    auto add = [&](const std::string& s, uint32_t& off, uint32_t& len, bool intern) {
+      if (intern) {
+        auto it = interned.find(s);
+        if (it != interned.end()) {
+          off = it->second;
+          len = s.size();
+          return;
+        }
+      }
+      off = strings.size();
+      len = s.size();
+      strings += s;
+      if (intern) interned.emplace(s, off);
+    };
+    for (auto& [name, entry] : fields) {
+      Entry e;
+      add(name, e.name_off, e.name_len, false);
+      add(entry.desc, e.desc_off, e.desc_len, false);
+      add(entry.type, e.type_off, e.type_len, true);
+      add(entry.ver, e.ver_off, e.ver_len, true);
+      table.push_back(e);
+    }
+    if (strings.size() > UINT32_MAX) {
+      std::cerr << "FieldGlossary::write: too many fields for " << path << std::endl;
+      return false;
+    }
+
+    std::error_code ec;
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path(), ec);
+
+    // concurrent runs may write the same index; the complete file is renamed atomically
+    auto tmp_path = path;
+    tmp_path += fmt::format(".tmp.{}", getpid());
+    {
+      std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+      uint64_t header[4] = {GLOSSARY_BYTE_ORDER, key.size(), table.size(), strings.size()};
+      const char padding[8] = {0};
+      os.write(GLOSSARY_MAGIC, sizeof(GLOSSARY_MAGIC));
+      os.write((const char*)header, sizeof(header));
+      os.write(key.data(), key.size());
+      os.write(padding, align8(key.size()) - key.size());
+      os.write((const char*)table.data(), table.size() * sizeof(Entry));
+      os.write(strings.data(), strings.size());
+      if (!os) {
+        std::cerr << "FieldGlossary::write: failed to write " << tmp_path << std::endl;
+        os.close();
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+      }
+    }
+
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+      std::cerr << "FieldGlossary::write: failed to rename " << tmp_path << " (" << ec.message()
+                << ")" << std::endl;
+      std::filesystem::remove(tmp_path, ec);
+      return false;
+    }
+    return true;
+  }
+
+  // every <tr id="..."> row of every file is read once; the first row of a field wins
+  bool FieldGlossary::collectDfref(const std::filesystem::path& dfref_path,
+                                   std::map<std::string, GlossaryEntry>& fields) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(dfref_path, ec)) return false;
+
+    const std::string leftstr = "id=\"";
+    const std::string rightstr = "</tr>";
+
+    // directory hierarichy assumption: "dfref" / field[0] / filename
+    for (auto const& dir_entry : std::filesystem::directory_iterator{dfref_path}) {
+      if (!std::filesystem::is_directory(dir_entry.symlink_status())) continue;
+      if (dir_entry.path().filename().string().length() != 1) continue;
+
+      for (auto const& file_entry : std::filesystem::directory_iterator{dir_entry.path()}) {
+        if (!std::filesystem::is_regular_file(file_entry.symlink_status())) continue;
+
+        std::ifstream i(file_entry.path());
+        i.imbue(std::locale("en_US.UTF8"));  // the reference is offered as a UTF8 document
+        for (std::string line; std::getline(i, line);) {
+          // other elements may have an id as well; only rows with three columns are fields
+          std::size_t l = 0;
+          while ((l = line.find(leftstr, l)) != std::string::npos) {
+            std::size_t q = line.find('"', l + leftstr.length());
+            std::size_t r = line.find(rightstr, l);
+            if (q == std::string::npos || r == std::string::npos) break;
+            std::string row = line.substr(l, r - l);
+            std::size_t columns = 0;
+            for (std::size_t c = 0; (c = row.find("</td><td>", c)) != std::string::npos; c++)
+              columns++;
+            std::string field = line.substr(l + leftstr.length(), q - l - leftstr.length());
+            if (columns >= 3 && !fields.contains(field)) parseDfrefRow(row, fields[field]);
+            l = r;
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  bool FieldGlossary::collectTshark(const std::string& tshark_path, const std::string& version,
+                                    std::map<std::string, GlossaryEntry>& fields) {
+    // tshark -G ftypes: <ftype>\t<description>, e.g., FT_UINT16\tUnsigned integer (16 bits)
+    std::unordered_map<std::string, std::string> ftypes;
+    std::string cmd = tshark_path + " -G ftypes 2>/dev/null";
+    FILE* in = popen(cmd.c_str(), "r");
+    if (in == nullptr) return false;
+    char* buf = nullptr;
+    size_t cap = 0;
+    ssize_t len;
+    while ((len = getline(&buf, &cap, in)) > 0) {
+      std::string line(buf, len);
+      if (line.back() == '\n') line.pop_back();
+      auto cols = splitTab(line);
+      if (cols.size() >= 2) ftypes[cols[0]] = cols[1];
+    }
+    pclose(in);
+
+    // tshark -G fields:
+    //   P\t<name>\t<abbrev>
+    //   F\t<name>\t<abbrev>\t<ftype>\t<parent protocol>\t<blurb>\t<base>\t<bitmask>
+    const std::string ver = version + " to " + version;
+    cmd = tshark_path + " -G fields 2>/dev/null";
+    in = popen(cmd.c_str(), "r");
+    if (in == nullptr) {
+      free(buf);
+      return false;
+    }
+    while ((len = getline(&buf, &cap, in)) > 0) {
+      std::string line(buf, len);
+      if (line.back() == '\n') line.pop_back();
+      auto cols = splitTab(line);
+      if (cols.size() < 3 || fields.contains(cols[2])) continue;
+      if (cols[0] == "P") {
+        fields[cols[2]] = {cols[1], "Protocol", ver};
+      } else if (cols[0] == "F" && cols.size() >= 4) {
+        auto it = ftypes.find(cols[3]);
+        fields[cols[2]] = {cols[1], it != ftypes.end() ? it->second : cols[3], ver};
+      }
+    }
+    free(buf);
+    return pclose(in) == 0 && !fields.empty();
+  }
+
+}  // namespace fpnt
@@ -0,0 +1,64 @@
+#include <fpnt/hierarchy.h>
+
+#include <utility>
+
+namespace fpnt {
+
+  void Hierarchy::reset(size_t levels) {
+    no_levels = levels;
+    no_records.assign(levels, 0);
+    parents.assign(levels, {});
+    ancestors.assign(levels * levels, {});
+    csrs.assign(levels * levels, {});
+  }
+
+  void Hierarchy::build() {
+    // the children of each level: a counting sort of the lower level by parent, which keeps the
+    // order of IDs for the same parent
+    for (size_t from = 1; from < no_levels; from++) {
+      const std::vector<uint32_t>& parent_ids = parents[from - 1];
+      Csr& csr = csrs[from * no_levels + from - 1];
+      csr.offsets.assign(no_records[from] + 1, 0);
+      for (uint32_t parent_id : parent_ids) csr.offsets[parent_id + 1]++;
+      for (size_t id = 0; id < no_records[from]; id++) csr.offsets[id + 1] += csr.offsets[id];
+
+      std::vector<uint32_t> next(csr.offsets.begin(), csr.offsets.end() - 1);
+      csr.ids.resize(parent_ids.size());
+      for (size_t id = 0; id < parent_ids.size(); id++) csr.ids[next[parent_ids[id]]++] = id;
+
+      // the descendants at the levels further below are the concatenated descendants of the
+      // children, which are already built for the level of the children
+      for (size_t i = 2; i <= from; i++) {
+        size_t to = from - i;
+        const Csr& children = csrs[from * no_levels + from - 1];
+        const Csr& lower = csrs[(from - 1) * no_levels + to];
+        Csr& result = csrs[from * no_levels + to];
+        result.offsets.resize(no_records[from] + 1);
+        result.offsets[0] = 0;
+        result.ids.reserve(lower.ids.size());
+        for (size_t id = 0; id < no_records[from]; id++) {
+          for (size_t i = children.offsets[id]; i < children.offsets[id + 1]; i++) {
+            const uint32_t child = children.ids[i];
+            result.ids.insert(result.ids.end(), lower.ids.begin() + lower.offsets[child],
+                              lower.ids.begin() + lower.offsets[child + 1]);
+          }
+          result.offsets[id + 1] = result.ids.size();
+        }
+      }
+    }
+
+    // the ancestors of each level: the ancestors of the parents, which are already built for the
+    // level above; the parents themselves are kept as the ancestors at the next level
+    for (size_t i = 1; i < no_levels; i++) {
+      size_t from = (no_levels - 1) - i;
+      for (size_t to = from + 2; to < no_levels; to++) {
+        const std::vector<uint32_t>& upper = ancestors[(from + 1) * no_levels + to];
+        std::vector<uint32_t>& result = ancestors[from * no_levels + to];
+        result.resize(parents[from].size());
+        for (size_t id = 0; id < result.size(); id++) result[id] = upper[parents[from][id]];
+      }
+      ancestors[from * no_levels + from + 1] = std::move(parents[from]);
+    }
+  }
+
+}  // namespace fpnt
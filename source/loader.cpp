@@ -153,6 +153,62 @@ namespace fpnt {
     return fnptr;
   }
 
+  bool Loader::isStatefulPrepFn(const std::string &str_fn) {
+    return map_fns.contains(str_fn + "_init");
+  }
+
+  void *Loader::getSymbol(const std::string &str_sym) {
+    char *error;
+    void *symptr = dlsym(handle, str_sym.c_str());
+    if ((error = dlerror()) != NULL) {
+      std::cerr << error << std::endl;
+      exit(1);
+    }
+    return symptr;
+  }
+
+  fnptr_PrepInitFn Loader::getPrepInitFn(const std::string &str_fn) {
+    return (fnptr_PrepInitFn)getSymbol(str_fn + "_init");
+  }
+
+  fnptr_PrepStateFn Loader::getPrepStateFn(const std::string &str_fn) {
+    return (fnptr_PrepStateFn)getSymbol(str_fn);
+  }
+
+  fnptr_PrepDestroyFn Loader::getPrepDestroyFn(const std::string &str_fn) {
+    if (!map_fns.contains(str_fn + "_destroy")) return nullptr;
+    return (fnptr_PrepDestroyFn)getSymbol(str_fn + "_destroy");
+  }
+
+  bool Loader::isThreadSafePrepFn(const std::string &str_fn) {
+    return map_fns.contains(str_fn + "_threadsafe");
+  }
+
+  fnptr_PrepBatchFn Loader::getPrepBatchFn(const std::string &str_fn) {
+    if (!map_fns.contains(str_fn + "_batch")) return nullptr;
+    return (fnptr_PrepBatchFn)getSymbol(str_fn + "_batch");
+  }
+
+  fnptr_PrepRefsFn Loader::getPrepRefsFn(const std::string &str_fn) {
+    if (!map_fns.contains(str_fn + "_refs")) return nullptr;
+    return (fnptr_PrepRefsFn)getSymbol(str_fn + "_refs");
+  }
+
+  fnptr_PrepMultiFn Loader::getPrepMultiFn(const std::string &str_fn) {
+    if (!map_fns.contains(str_fn + "_multi")) return nullptr;
+    return (fnptr_PrepMultiFn)getSymbol(str_fn + "_multi");
+  }
+
+  fnptr_PrepMultiInitFn Loader::getPrepMultiInitFn(const std::string &str_fn) {
+    if (!map_fns.contains(str_fn + "_multi_init")) return nullptr;
+    return (fnptr_PrepMultiInitFn)getSymbol(str_fn + "_multi_init");
+  }
+
+  fnptr_PrepDestroyFn Loader::getPrepMultiDestroyFn(const std::string &str_fn) {
+    if (!map_fns.contains(str_fn + "_multi_destroy")) return nullptr;
+    return (fnptr_PrepDestroyFn)getSymbol(str_fn + "_multi_destroy");
+  }
+
   fnptr_genKeyFn Loader::getGenKeyFn(const std::string &str_fn) {
     fnptr_genKeyFn fnptr = NULL;
     if (map_genkeyfns.contains(str_fn) && map_genkeyfns[str_fn] != NULL)
@@ -176,4 +232,14 @@ namespace fpnt {
     return fnptr;
   }
 
-}  // namespace fpnt
\ No newline at end of file
+  fnptr_genKeyDirFn Loader::getGenKeyDirFn(const std::string &str_fn) {
+    if (!map_genkeyfns.contains(str_fn + "_dir")) return nullptr;
+    return (fnptr_genKeyDirFn)getSymbol(str_fn + "_dir");
+  }
+
+  fnptr_genKeyTupleFn Loader::getGenKeyTupleFn(const std::string &str_fn) {
+    if (!map_genkeyfns.contains(str_fn + "_tuple")) return nullptr;
+    return (fnptr_genKeyTupleFn)getSymbol(str_fn + "_tuple");
+  }
+
+}  // namespace fpnt
@@ -0,0 +1,1041 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <fpnt/pcap.h>
+#include <fpnt/util.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <unordered_map>
+
+namespace fpnt {
+
+  namespace {
+    constexpr uint32_t PCAP_MAGIC_USEC = 0xa1b2c3d4;
+    constexpr uint32_t PCAP_MAGIC_NSEC = 0xa1b23c4d;
+    constexpr uint32_t PCAPNG_SHB = 0x0A0D0D0A;
+    constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+    constexpr uint32_t PCAPNG_IDB = 0x00000001;
+    constexpr uint32_t PCAPNG_PB = 0x00000002;  // obsolete packet block
+    constexpr uint32_t PCAPNG_SPB = 0x00000003;
+    constexpr uint32_t PCAPNG_EPB = 0x00000006;
+    constexpr uint32_t PCAPNG_DSB = 0x0000000A;  // decryption secrets block
+    constexpr uint32_t STREAM_MAX_UNIT = 1u << 28;  // larger records are regarded as corrupted
+    constexpr size_t STREAM_READ_SIZE = 1 << 20;
+
+    inline uint16_t be16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+    inline uint32_t be32(const uint8_t* p) {
+      return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+    inline uint32_t le32(const uint8_t* p) {
+      return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+    }
+
+    // seconds + nanoseconds to a "sec.nnnnnnnnn" string as tshark prints time fields
+    void formatTime(int64_t sec, uint32_t nsec, std::string& out) {
+      out = fmt::format("{}.{:09}", sec, nsec);
+    }
+
+    void formatTimeDiff(int64_t sec, uint32_t nsec, int64_t base_sec, uint32_t base_nsec,
+                        std::string& out) {
+      int64_t diff = (sec - base_sec) * 1000000000LL + ((int64_t)nsec - (int64_t)base_nsec);
+      if (diff < 0)
+        out = fmt::format("-{}.{:09}", (-diff) / 1000000000LL, (-diff) % 1000000000LL);
+      else
+        out = fmt::format("{}.{:09}", diff / 1000000000LL, diff % 1000000000LL);
+    }
+
+    void formatMac(const uint8_t* p, std::string& out) {
+      out = fmt::format("{:02x}:{:02x}:{:02x}:{:02x}:{:02x}:{:02x}", p[0], p[1], p[2], p[3], p[4],
+                        p[5]);
+    }
+
+    void formatIPv4(const uint8_t* p, std::string& out) {
+      out = fmt::format("{}.{}.{}.{}", p[0], p[1], p[2], p[3]);
+    }
+
+    void formatIPv6(const uint8_t* p, std::string& out) {
+      char buf[INET6_ADDRSTRLEN];
+      if (inet_ntop(AF_INET6, p, buf, sizeof(buf)) == nullptr)
+        out.clear();
+      else
+        out = buf;
+    }
+
+    void decodeTransport(const uint8_t* p, size_t avail, DecodedPkt& pkt) {
+      if (pkt.l4_proto == 6 && avail >= 20) {
+        size_t hdr_len = (p[12] >> 4) * 4;
+        if (hdr_len >= 20) {
+          pkt.tcp = p;
+          pkt.layers |= LAYER_TCP;
+        }
+      } else if (pkt.l4_proto == 17 && avail >= 8) {
+        pkt.udp = p;
+        pkt.layers |= LAYER_UDP;
+      }
+    }
+
+    void decodeIPv4(const uint8_t* p, size_t avail, DecodedPkt& pkt) {
+      if (avail < 20 || (p[0] >> 4) != 4) return;
+      size_t ihl = (p[0] & 0x0f) * 4;
+      if (ihl < 20 || ihl > avail) return;
+
+      pkt.ip4 = p;
+      pkt.layers |= LAYER_IP;
+      pkt.l4_proto = p[9];
+
+      // IP fragments are not reassembled; the transport header is decoded only for unfragmented
+      // datagrams
+      uint16_t frag = be16(p + 6);
+      if ((frag & 0x1fff) != 0 || (frag & 0x2000) != 0) return;
+
+      uint16_t total_len = be16(p + 2);
+      pkt.l4_len = total_len >= ihl ? total_len - ihl : 0;
+      decodeTransport(p + ihl, avail - ihl, pkt);
+    }
+
+    void decodeIPv6(const uint8_t* p, size_t avail, DecodedPkt& pkt) {
+      if (avail < 40 || (p[0] >> 4) != 6) return;
+
+      pkt.ip6 = p;
+      pkt.layers |= LAYER_IPV6;
+
+      uint8_t nxt = p[6];
+      size_t off = 40;
+      size_t ext_len = 0;
+      // walk the extension headers to find the transport header
+      while (true) {
+        if (nxt == 0 || nxt == 43 || nxt == 60) {  // hop-by-hop, routing, destination options
+          if (off + 8 > avail) return;
+          size_t len = ((size_t)p[off + 1] + 1) * 8;
+          nxt = p[off];
+          off += len;
+          ext_len += len;
+        } else if (nxt == 44) {  // fragment
+          if (off + 8 > avail) return;
+          uint16_t frag = be16(p + off + 2);
+          if ((frag & 0xfff8) != 0 || (frag & 0x0001) != 0) {
+            pkt.l4_proto = p[off];
+            return;
+          }
+          nxt = p[off];
+          off += 8;
+          ext_len += 8;
+        } else if (nxt == 51) {  // authentication header
+          if (off + 8 > avail) return;
+          size_t len = ((size_t)p[off + 1] + 2) * 4;
+          nxt = p[off];
+          off += len;
+          ext_len += len;
+        } else {
+          break;
+        }
+      }
+
+      if (off > avail) return;
+      pkt.l4_proto = nxt;
+      uint16_t plen = be16(p + 4);
+      pkt.l4_len = plen >= ext_len ? plen - ext_len : 0;
+      decodeTransport(p + off, avail - off, pkt);
+    }
+
+    void decodeEtherType(uint16_t type, const uint8_t* p, size_t avail, DecodedPkt& pkt) {
+      pkt.eth_type = type;
+      if (type == 0x0800)
+        decodeIPv4(p, avail, pkt);
+      else if (type == 0x86DD)
+        decodeIPv6(p, avail, pkt);
+    }
+
+    void decodeRawIP(const uint8_t* p, size_t avail, DecodedPkt& pkt) {
+      if (avail < 1) return;
+      if ((p[0] >> 4) == 4)
+        decodeIPv4(p, avail, pkt);
+      else if ((p[0] >> 4) == 6)
+        decodeIPv6(p, avail, pkt);
+    }
+
+    const std::unordered_map<std::string, int>& nativeFieldMap() {
+      static const std::unordered_map<std::string, int> result = {
+          {"frame.number", NF_FRAME_NUMBER},
+          {"frame.time_epoch", NF_FRAME_TIME_EPOCH},
+          {"frame.time_relative", NF_FRAME_TIME_RELATIVE},
+          {"frame.time_delta", NF_FRAME_TIME_DELTA},
+          {"frame.len", NF_FRAME_LEN},
+          {"frame.cap_len", NF_FRAME_CAP_LEN},
+          {"eth.src", NF_ETH_SRC},
+          {"eth.dst", NF_ETH_DST},
+          {"eth.type", NF_ETH_TYPE},
+          {"vlan.id", NF_VLAN_ID},
+          {"ip.version", NF_IP_VERSION},
+          {"ip.hdr_len", NF_IP_HDR_LEN},
+          {"ip.len", NF_IP_LEN},
+          {"ip.id", NF_IP_ID},
+          {"ip.ttl", NF_IP_TTL},
+          {"ip.proto", NF_IP_PROTO},
+          {"ip.src", NF_IP_SRC},
+          {"ip.dst", NF_IP_DST},
+          {"ipv6.plen", NF_IPV6_PLEN},
+          {"ipv6.nxt", NF_IPV6_NXT},
+          {"ipv6.hlim", NF_IPV6_HLIM},
+          {"ipv6.src", NF_IPV6_SRC},
+          {"ipv6.dst", NF_IPV6_DST},
+          {"tcp.srcport", NF_TCP_SRCPORT},
+          {"tcp.dstport", NF_TCP_DSTPORT},
+          {"tcp.port", NF_TCP_PORT},
+          {"tcp.seq_raw", NF_TCP_SEQ_RAW},
+          {"tcp.ack_raw", NF_TCP_ACK_RAW},
+          {"tcp.hdr_len", NF_TCP_HDR_LEN},
+          {"tcp.len", NF_TCP_LEN},
+          {"tcp.window_size_value", NF_TCP_WINDOW_SIZE_VALUE},
+          {"udp.srcport", NF_UDP_SRCPORT},
+          {"udp.dstport", NF_UDP_DSTPORT},
+          {"udp.port", NF_UDP_PORT},
+          {"udp.length", NF_UDP_LENGTH},
+          {"_ws.col.def_src", NF_COL_DEF_SRC},
+          {"_ws.col.def_dst", NF_COL_DEF_DST},
+      };
+      return result;
+    }
+  }  // namespace
+
+  bool isNativeLinkType(uint32_t linktype) {
+    switch (linktype) {
+      case LINKTYPE_NULL:
+      case LINKTYPE_ETHERNET:
+      case LINKTYPE_RAW:
+      case LINKTYPE_LINUX_SLL:
+      case LINKTYPE_IPV4:
+      case LINKTYPE_IPV6:
+      case LINKTYPE_LINUX_SLL2:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  bool isCompressedCapture(const std::filesystem::path& path) {
+    return genDecompressCmd(path) != "";
+  }
+
+  std::string captureExtension(const std::filesystem::path& path) {
+    std::string ext = path.extension().string();
+    if (isCompressedCapture(path)) ext = path.stem().extension().string() + ext;
+    return ext;
+  }
+
+  std::string genDecompressCmd(const std::filesystem::path& path) {
+    std::string ext = path.extension().string();
+    std::string quoted = "\"" + path.string() + "\"";
+    if (ext == ".gz")  // pigz decompresses with separate reader, writer and checksum threads
+      return "$(command -v pigz || echo gzip) -dc " + quoted;
+    if (ext == ".zst") return "zstd -dcq " + quoted;
+    if (ext == ".xz") return "xz -dc -T0 " + quoted;  // multi-threaded for multi-block files
+    return "";
+  }
+
+  bool PcapFile::openStream() {
+    pipe = popen(decompress_cmd.c_str(), "re");
+    if (pipe == nullptr) return false;
+    stream = std::make_unique<PcapStream>(fileno(pipe));
+
+    std::string_view bytes;
+    if (nextUnit(bytes) != PcapStream::UNIT_HEADER
+        || !parseFileHeader((const uint8_t*)bytes.data(), bytes.size()))
+      return false;
+    skipped_units.assign(bytes);
+    stream_pos = bytes.size();
+
+    // pcapng: read the interface descriptions preceding the first packet, which is kept for next()
+    PcapRecord rec;
+    PcapStream::Unit unit;
+    while (pcapng && (unit = nextUnit(bytes)) != PcapStream::UNIT_NONE) {
+      if (unit == PcapStream::UNIT_PACKET || rd32((const uint8_t*)bytes.data()) == PCAPNG_SHB) {
+        pending_unit = unit;
+        pending = bytes;
+        break;
+      }
+      size_t p = 0;
+      nextRecord((const uint8_t*)bytes.data(), bytes.size(), p, rec);
+      skipped_units.append(bytes);
+      stream_pos += bytes.size();
+    }
+    first_record = stream_pos;
+    return true;
+  }
+
+  PcapStream::Unit PcapFile::nextUnit(std::string_view& bytes) {
+    if (pending_unit != PcapStream::UNIT_NONE) {
+      PcapStream::Unit unit = pending_unit;
+      bytes = pending;
+      pending_unit = PcapStream::UNIT_NONE;
+      return unit;
+    }
+    while (true) {
+      PcapStream::Unit unit = stream->next(bytes);
+      if (unit != PcapStream::UNIT_NONE || stream->failed() || !stream->fill(-1)) return unit;
+    }
+  }
+
+  bool PcapFile::nextStreamed(PcapRecord& rec) {
+    if (skipped_reset) {
+      skipped_units.clear();
+      skipped_reset = false;
+    }
+
+    // the units other than packet records (and unparsable ones) only update the interfaces
+    std::string_view bytes;
+    PcapStream::Unit unit;
+    while ((unit = nextUnit(bytes)) != PcapStream::UNIT_NONE) {
+      size_t offset = stream_pos;
+      size_t p = 0;
+      stream_pos += bytes.size();
+      if (nextRecord((const uint8_t*)bytes.data(), bytes.size(), p, rec)
+          && unit == PcapStream::UNIT_PACKET) {
+        rec.offset += offset;
+        last_record = bytes;
+        gap = skipped_units;
+        skipped_reset = true;
+        return true;
+      }
+      skipped_units.append(bytes);
+    }
+    gap = skipped_units;
+    return false;
+  }
+
+  void PcapFile::release() {
+    if (base != nullptr) munmap((void*)base, length);
+    if (fd >= 0) close(fd);
+    base = nullptr;
+    fd = -1;
+
+    stream.reset();
+    if (pipe != nullptr) pclose(pipe);
+    pipe = nullptr;
+    pending_unit = PcapStream::UNIT_NONE;
+  }
+
+  PcapFile::PcapFile(const std::filesystem::path& path) {
+    decompress_cmd = genDecompressCmd(path);
+    if (decompress_cmd != "") {
+      // a compressed file cannot be mapped; its decompressed records are read one by one
+      if (!openStream()) release();
+      return;
+    }
+
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 24) {
+      release();
+      return;
+    }
+
+    length = st.st_size;
+    void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      release();
+      return;
+    }
+    base = (const uint8_t*)addr;
+    madvise(addr, length, MADV_SEQUENTIAL);
+
+    if (!parseFileHeader(base, length)) {  // unknown format; let tshark handle it
+      release();
+      return;
+    }
+    if (!pcapng) {
+      first_record = 24;
+      pos = first_record;
+      return;
+    }
+
+    // pcapng: read the interface descriptions preceding the first packet
+    pos = rd32(base + 4);
+    while (pos + 12 <= length) {
+      uint32_t type = rd32(base + pos);
+      uint32_t total_len = rd32(base + pos + 4);
+      if (total_len < 12 || pos + total_len > length) break;
+      if (type == PCAPNG_EPB || type == PCAPNG_SPB || type == PCAPNG_PB) break;
+      if (type == PCAPNG_IDB) parseIDB(base + pos + 8, total_len - 12);
+      if (type == PCAPNG_SHB) break;
+      pos += total_len;
+    }
+    first_record = pos;
+  }
+
+  PcapFile::~PcapFile() { release(); }
+
+  uint16_t PcapFile::rd16(const uint8_t* p) const {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return swapped ? __builtin_bswap16(v) : v;
+  }
+
+  uint32_t PcapFile::rd32(const uint8_t* p) const {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return swapped ? __builtin_bswap32(v) : v;
+  }
+
+  bool PcapFile::parseFileHeader(const uint8_t* data, size_t size) {
+    if (size < 24) return false;
+    uint32_t magic = le32(data);
+    if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC) {
+      swapped = false;
+    } else if (be32(data) == PCAP_MAGIC_USEC || be32(data) == PCAP_MAGIC_NSEC) {
+      swapped = true;
+      magic = be32(data);
+    } else if (magic == PCAPNG_SHB) {
+      pcapng = true;
+      return parseSHB(data, size);
+    } else {
+      return false;
+    }
+
+    pcap_nsec = (magic == PCAP_MAGIC_NSEC);
+    Interface iface;
+    iface.snaplen = rd32(data + 16);
+    iface.linktype = rd32(data + 20) & 0xffff;
+    iface.tsresol_pow10 = true;
+    iface.tsresol = pcap_nsec ? 9 : 6;
+    iface.tsoffset = 0;
+    interfaces.push_back(iface);
+    return true;
+  }
+
+  bool PcapFile::parseSHB(const uint8_t* blk, size_t avail) {
+    if (avail < 28) return false;
+    uint32_t bom;
+    memcpy(&bom, blk + 8, sizeof(bom));
+    if (bom == PCAPNG_BYTE_ORDER_MAGIC)
+      swapped = false;
+    else if (__builtin_bswap32(bom) == PCAPNG_BYTE_ORDER_MAGIC)
+      swapped = true;
+    else
+      return false;
+
+    uint32_t total_len = rd32(blk + 4);
+    if (total_len < 28 || total_len > avail) return false;
+
+    interfaces.clear();  // interface ids are local to a section
+    sections++;
+    return true;
+  }
+
+  bool PcapFile::parseIDB(const uint8_t* body, size_t body_len) {
+    if (body_len < 8) return false;
+    Interface iface;
+    iface.linktype = rd16(body);
+    iface.snaplen = rd32(body + 4);
+    iface.tsresol_pow10 = true;
+    iface.tsresol = 6;
+    iface.tsoffset = 0;
+
+    size_t off = 8;
+    while (off + 4 <= body_len) {
+      uint16_t code = rd16(body + off);
+      uint16_t len = rd16(body + off + 2);
+      if (code == 0) break;  // opt_endofopt
+      if (off + 4 + len > body_len) break;
+      if (code == 9 && len >= 1) {  // if_tsresol
+        iface.tsresol_pow10 = (body[off + 4] & 0x80) == 0;
+        iface.tsresol = body[off + 4] & 0x7f;
+      } else if (code == 14 && len >= 8) {  // if_tsoffset
+        uint64_t v;
+        memcpy(&v, body + off + 4, sizeof(v));
+        if (swapped) v = __builtin_bswap64(v);
+        iface.tsoffset = (int64_t)v;
+      }
+      off += 4 + ((len + 3) & ~3u);
+    }
+
+    interfaces.push_back(iface);
+    return true;
+  }
+
+  void PcapFile::setTimestamp(PcapRecord& rec, uint32_t iface, uint64_t ts) const {
+    const Interface& i = interfaces[iface];
+    if (i.tsresol_pow10) {
+      uint64_t div = 1;
+      for (uint8_t k = 0; k < i.tsresol && k < 19; k++) div *= 10;
+      uint64_t frac = ts % div;
+      rec.ts_sec = (int64_t)(ts / div) + i.tsoffset;
+      if (i.tsresol <= 9) {
+        uint64_t mul = 1;
+        for (uint8_t k = i.tsresol; k < 9; k++) mul *= 10;
+        rec.ts_nsec = (uint32_t)(frac * mul);
+      } else {
+        rec.ts_nsec = (uint32_t)(frac / (div / 1000000000ULL));
+      }
+    } else {
+      uint8_t shift = i.tsresol < 64 ? i.tsresol : 63;
+      uint64_t frac = ts & ((1ULL << shift) - 1);
+      rec.ts_sec = (int64_t)(ts >> shift) + i.tsoffset;
+      rec.ts_nsec = (uint32_t)((long double)frac * 1e9L / (long double)(1ULL << shift));
+    }
+  }
+
+  std::vector<uint32_t> PcapFile::linktypes() const {
+    std::vector<uint32_t> result;
+    for (const auto& iface : interfaces) result.push_back(iface.linktype);
+    return result;
+  }
+
+  void PcapFile::rewind() {
+    if (!is_open()) return;
+    gap = std::string_view();
+    record_end = 0;
+    if (stream != nullptr) {  // the decompressor is started again
+      release();
+      interfaces.clear();
+      sections = 0;
+      skipped_reset = false;
+      if (!openStream()) release();
+      return;
+    }
+
+    if (pcapng) {
+      // the first section may have been replaced by a later one; parse it again
+      parseSHB(base, length);
+      size_t p = rd32(base + 4);
+      while (p < first_record) {
+        uint32_t type = rd32(base + p);
+        uint32_t total_len = rd32(base + p + 4);
+        if (type == PCAPNG_IDB) parseIDB(base + p + 8, total_len - 12);
+        p += total_len;
+      }
+    }
+    pos = first_record;
+  }
+
+  bool PcapFile::next(PcapRecord& rec) {
+    if (!is_open()) return false;
+    if (stream != nullptr) return nextStreamed(rec);
+
+    bool found = nextRecord(base, length, pos, rec);
+    size_t gap_end = found ? rec.offset : length;
+    gap = std::string_view((const char*)base + record_end, gap_end - record_end);
+    record_end = found ? rec.offset + rec.size : length;
+    return found;
+  }
+
+  std::string_view PcapFile::raw(const PcapRecord& rec) const {
+    if (stream != nullptr) return last_record;
+    return std::string_view((const char*)base + rec.offset, rec.size);
+  }
+
+  bool PcapFile::nextRecord(const uint8_t* data, size_t size, size_t& pos, PcapRecord& rec) {
+    if (!pcapng) {
+      if (pos + 16 > size) return false;
+      const uint8_t* hdr = data + pos;
+      uint32_t ts_sec = rd32(hdr);
+      uint32_t ts_frac = rd32(hdr + 4);
+      uint32_t caplen = rd32(hdr + 8);
+      uint32_t len = rd32(hdr + 12);
+      if (pos + 16 + caplen > size) return false;  // truncated record
+
+      rec.data = hdr + 16;
+      rec.caplen = caplen;
+      rec.len = len;
+      rec.ts_sec = ts_sec;
+      rec.ts_nsec = pcap_nsec ? ts_frac : ts_frac * 1000;
+      rec.linktype = interfaces[0].linktype;
+      rec.offset = pos;
+      rec.size = 16 + caplen;
+      pos += rec.size;
+      return true;
+    }
+
+    while (pos + 12 <= size) {
+      const uint8_t* blk = data + pos;
+      uint32_t type = rd32(blk);
+      if (type == PCAPNG_SHB) {
+        if (!parseSHB(blk, size - pos)) return false;
+        pos += rd32(blk + 4);
+        continue;
+      }
+
+      uint32_t total_len = rd32(blk + 4);
+      if (total_len < 12 || pos + total_len > size) return false;  // truncated block
+      const uint8_t* body = blk + 8;
+      size_t body_len = total_len - 12;
+
+      if (type == PCAPNG_IDB) {
+        parseIDB(body, body_len);
+      } else if (type == PCAPNG_EPB && body_len >= 20) {
+        uint32_t iface = rd32(body);
+        uint32_t caplen = rd32(body + 12);
+        if (iface < interfaces.size() && 20 + (size_t)caplen <= body_len) {
+          uint64_t ts = ((uint64_t)rd32(body + 4) << 32) | rd32(body + 8);
+          setTimestamp(rec, iface, ts);
+          rec.data = body + 20;
+          rec.caplen = caplen;
+          rec.len = rd32(body + 16);
+          rec.linktype = interfaces[iface].linktype;
+          rec.offset = pos;
+          rec.size = total_len;
+          pos += total_len;
+          return true;
+        }
+      } else if (type == PCAPNG_SPB && body_len >= 4 && !interfaces.empty()) {
+        uint32_t len = rd32(body);
+        uint32_t caplen = std::min<uint32_t>(len, body_len - 4);
+        if (interfaces[0].snaplen != 0) caplen = std::min<uint32_t>(caplen, interfaces[0].snaplen);
+        rec.data = body + 4;
+        rec.caplen = caplen;
+        rec.len = len;
+        rec.ts_sec = 0;  // simple packet blocks do not have timestamps
+        rec.ts_nsec = 0;
+        rec.linktype = interfaces[0].linktype;
+        rec.offset = pos;
+        rec.size = total_len;
+        pos += total_len;
+        return true;
+      } else if (type == PCAPNG_PB && body_len >= 20) {
+        uint32_t iface = rd16(body);
+        uint32_t caplen = rd32(body + 12);
+        if (iface < interfaces.size() && 20 + (size_t)caplen <= body_len) {
+          uint64_t ts = ((uint64_t)rd32(body + 4) << 32) | rd32(body + 8);
+          setTimestamp(rec, iface, ts);
+          rec.data = body + 20;
+          rec.caplen = caplen;
+          rec.len = rd32(body + 16);
+          rec.linktype = interfaces[iface].linktype;
+          rec.offset = pos;
+          rec.size = total_len;
+          pos += total_len;
+          return true;
+        }
+      }
+      pos += total_len;
+    }
+    return false;
+  }
+
+  bool splitPcapFile(PcapFile& pcap, size_t n, std::vector<PcapChunk>& chunks) {
+    chunks.clear();
+    if (!pcap.is_open() || n == 0) return false;
+
+    pcap.rewind();
+    size_t sections = pcap.no_sections();
+    size_t interfaces = pcap.no_interfaces();
+    const size_t target = (pcap.size() - pcap.header_size()) / n + 1;
+
+    // only record headers are visited; the chunk boundaries are the record offsets
+    PcapRecord rec;
+    uint64_t frame_number = 0;
+    while (pcap.next(rec)) {
+      frame_number++;
+      if (chunks.empty() || (rec.offset - chunks.back().offset >= target && chunks.size() < n)) {
+        PcapChunk chunk;
+        chunk.offset = chunks.empty() ? pcap.header_size() : rec.offset;
+        chunk.first_frame = frame_number;
+        chunks.push_back(chunk);
+      }
+      chunks.back().no_records++;
+    }
+    bool splittable = (pcap.no_sections() == sections && pcap.no_interfaces() == interfaces);
+    pcap.rewind();
+
+    if (!splittable) {  // every chunk should be described by the same header
+      chunks.clear();
+      return false;
+    }
+
+    // blocks between records (and trailing bytes) belong to the preceding chunk
+    for (size_t i = 0; i < chunks.size(); i++) {
+      size_t end = (i + 1 < chunks.size()) ? chunks[i + 1].offset : pcap.size();
+      chunks[i].size = end - chunks[i].offset;
+    }
+    return !chunks.empty();
+  }
+
+  PcapStream::PcapStream(const std::string& path) {
+    if (path == "-")
+      fd = STDIN_FILENO;
+    else
+      fd = open(path.c_str(), O_RDONLY);
+  }
+
+  PcapStream::PcapStream(int fd) : fd(fd), owns_fd(false) {}
+
+  PcapStream::~PcapStream() {
+    if (owns_fd && fd > STDIN_FILENO) close(fd);
+  }
+
+  uint32_t PcapStream::rd32(const uint8_t* p) const {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return swapped ? __builtin_bswap32(v) : v;
+  }
+
+  bool PcapStream::fill(int timeout_ms) {
+    if (eof || fd < 0) return false;
+
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int rc = poll(&pfd, 1, timeout_ms);
+    if (rc < 0 && errno != EINTR) {
+      eof = true;
+      return false;
+    }
+    if (rc <= 0) return true;  // timeout (or a signal); no new bytes
+
+    // drop the parsed bytes before growing the buffer
+    if (head > 0) {
+      buf.erase(buf.begin(), buf.begin() + head);
+      head = 0;
+    }
+    size_t old_size = buf.size();
+    buf.resize(old_size + STREAM_READ_SIZE);
+    ssize_t n = read(fd, buf.data() + old_size, STREAM_READ_SIZE);
+    buf.resize(old_size + (n > 0 ? n : 0));
+    if (n == 0 || (n < 0 && errno != EINTR && errno != EAGAIN)) eof = true;
+    return !eof;
+  }
+
+  PcapStream::Unit PcapStream::next(std::string_view& bytes) {
+    if (malformed) return UNIT_NONE;
+    const uint8_t* p = buf.data() + head;
+    size_t avail = buf.size() - head;
+
+    if (!started) {
+      if (avail < 12) return UNIT_NONE;
+      uint32_t magic = le32(p);
+      if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC) {
+        swapped = false;
+      } else if (be32(p) == PCAP_MAGIC_USEC || be32(p) == PCAP_MAGIC_NSEC) {
+        swapped = true;
+      } else if (magic == PCAPNG_SHB) {
+        pcapng = true;
+      } else {
+        malformed = true;
+        return UNIT_NONE;
+      }
+      if (!pcapng) {
+        if (avail < 24) return UNIT_NONE;
+        segment_header.assign((const char*)p, 24);
+        bytes = std::string_view((const char*)p, 24);
+        head += 24;
+        started = true;
+        return UNIT_HEADER;
+      }
+    }
+
+    if (!pcapng) {
+      if (avail < 16) return UNIT_NONE;
+      uint32_t caplen = rd32(p + 8);
+      if (caplen > STREAM_MAX_UNIT) {
+        malformed = true;
+        return UNIT_NONE;
+      }
+      if (avail < 16 + (size_t)caplen) return UNIT_NONE;
+      bytes = std::string_view((const char*)p, 16 + caplen);
+      head += bytes.size();
+      return UNIT_PACKET;
+    }
+
+    if (avail < 12) return UNIT_NONE;
+    uint32_t type = le32(p);  // the SHB type is the same in both byte orders
+    if (type == PCAPNG_SHB) {
+      uint32_t bom;
+      memcpy(&bom, p + 8, sizeof(bom));
+      if (bom == PCAPNG_BYTE_ORDER_MAGIC) {
+        swapped = false;
+      } else if (__builtin_bswap32(bom) == PCAPNG_BYTE_ORDER_MAGIC) {
+        swapped = true;
+      } else {
+        malformed = true;
+        return UNIT_NONE;
+      }
+    }
+    type = rd32(p);
+    uint32_t total_len = rd32(p + 4);
+    if (total_len < 12 || total_len % 4 != 0 || total_len > STREAM_MAX_UNIT) {
+      malformed = true;
+      return UNIT_NONE;
+    }
+    if (avail < total_len) return UNIT_NONE;
+    bytes = std::string_view((const char*)p, total_len);
+    head += total_len;
+
+    switch (type) {
+      case PCAPNG_SHB:  // a new section replaces the interfaces of the previous one
+        segment_header.assign(bytes);
+        started = true;
+        return UNIT_HEADER;
+      case PCAPNG_IDB:
+      case PCAPNG_DSB:
+        segment_header.append(bytes);
+        return UNIT_HEADER;
+      case PCAPNG_EPB:
+      case PCAPNG_SPB:
+      case PCAPNG_PB:
+        return UNIT_PACKET;
+      default:
+        return UNIT_BLOCK;
+    }
+  }
+
+  void decodePkt(const PcapRecord& rec, DecodedPkt& pkt) {
+    pkt.rec = &rec;
+    pkt.layers = LAYER_FRAME;
+    pkt.eth = nullptr;
+    pkt.eth_type = 0;
+    pkt.n_vlan = 0;
+    pkt.ip4 = nullptr;
+    pkt.ip6 = nullptr;
+    pkt.l4_proto = 0;
+    pkt.l4_len = 0;
+    pkt.tcp = nullptr;
+    pkt.udp = nullptr;
+
+    const uint8_t* p = rec.data;
+    size_t avail = rec.caplen;
+
+    switch (rec.linktype) {
+      case LINKTYPE_ETHERNET: {
+        if (avail < 14) return;
+        pkt.eth = p;
+        pkt.layers |= LAYER_ETH;
+        uint16_t type = be16(p + 12);
+        size_t off = 14;
+        while ((type == 0x8100 || type == 0x88a8 || type == 0x9100) && off + 4 <= avail) {
+          if (pkt.n_vlan < 2) pkt.vlan_ids[pkt.n_vlan++] = be16(p + off) & 0x0fff;
+          pkt.layers |= LAYER_VLAN;
+          type = be16(p + off + 2);
+          off += 4;
+        }
+        decodeEtherType(type, p + off, avail - off, pkt);
+        pkt.eth_type = be16(p + 12);  // eth.type is the outermost type
+        break;
+      }
+      case LINKTYPE_NULL: {
+        if (avail < 4) return;
+        uint32_t family = le32(p);
+        if (family > 0xffff) family = be32(p);  // written in the capturing host's byte order
+        if (family == 2)
+          decodeIPv4(p + 4, avail - 4, pkt);
+        else if (family == 24 || family == 28 || family == 30)
+          decodeIPv6(p + 4, avail - 4, pkt);
+        break;
+      }
+      case LINKTYPE_RAW:
+      case LINKTYPE_IPV4:
+      case LINKTYPE_IPV6:
+        decodeRawIP(p, avail, pkt);
+        break;
+      case LINKTYPE_LINUX_SLL:
+        if (avail < 16) return;
+        pkt.layers |= LAYER_SLL;
+        decodeEtherType(be16(p + 14), p + 16, avail - 16, pkt);
+        break;
+      case LINKTYPE_LINUX_SLL2:
+        if (avail < 20) return;
+        pkt.layers |= LAYER_SLL;
+        decodeEtherType(be16(p), p + 20, avail - 20, pkt);
+        break;
+      default:
+        break;
+    }
+  }
+
+  int getNativeField(const std::string& field) {
+    const auto& fields = nativeFieldMap();
+    auto it = fields.find(field);
+    if (it == fields.end()) return NF_NONE;
+    return it->second;
+  }
+
+  bool isFrameField(int native_field) {
+    return native_field >= NF_FRAME_NUMBER && native_field <= NF_FRAME_CAP_LEN;
+  }
+
+  void formatNativeField(const DecodedPkt& pkt, int native_field, std::string& out) {
+    const PcapRecord& rec = *pkt.rec;
+    const uint8_t* ip4 = pkt.ip4;
+    const uint8_t* ip6 = pkt.ip6;
+    const uint8_t* tcp = pkt.tcp;
+    const uint8_t* udp = pkt.udp;
+
+    out.clear();
+    switch (native_field) {
+      case NF_FRAME_NUMBER:
+        out = std::to_string(pkt.number);
+        break;
+      case NF_FRAME_TIME_EPOCH:
+        formatTime(rec.ts_sec, rec.ts_nsec, out);
+        break;
+      case NF_FRAME_TIME_RELATIVE:
+        formatTimeDiff(rec.ts_sec, rec.ts_nsec, pkt.first_sec, pkt.first_nsec, out);
+        break;
+      case NF_FRAME_TIME_DELTA:
+        formatTimeDiff(rec.ts_sec, rec.ts_nsec, pkt.prev_sec, pkt.prev_nsec, out);
+        break;
+      case NF_FRAME_LEN:
+        out = std::to_string(rec.len);
+        break;
+      case NF_FRAME_CAP_LEN:
+        out = std::to_string(rec.caplen);
+        break;
+      case NF_ETH_SRC:
+        if (pkt.eth) formatMac(pkt.eth + 6, out);
+        break;
+      case NF_ETH_DST:
+        if (pkt.eth) formatMac(pkt.eth, out);
+        break;
+      case NF_ETH_TYPE:
+        if (pkt.eth) out = fmt::format("0x{:04x}", pkt.eth_type);
+        break;
+      case NF_VLAN_ID:
+        for (uint8_t i = 0; i < pkt.n_vlan; i++) {
+          if (i > 0) out += ",";
+          out += std::to_string(pkt.vlan_ids[i]);
+        }
+        break;
+      case NF_IP_VERSION:
+        if (ip4) out = "4";
+        break;
+      case NF_IP_HDR_LEN:
+        if (ip4) out = std::to_string((ip4[0] & 0x0f) * 4);
+        break;
+      case NF_IP_LEN:
+        if (ip4) out = std::to_string(be16(ip4 + 2));
+        break;
+      case NF_IP_ID:
+        if (ip4) out = fmt::format("0x{:04x}", be16(ip4 + 4));
+        break;
+      case NF_IP_TTL:
+        if (ip4) out = std::to_string(ip4[8]);
+        break;
+      case NF_IP_PROTO:
+        if (ip4) out = std::to_string(ip4[9]);
+        break;
+      case NF_IP_SRC:
+        if (ip4) formatIPv4(ip4 + 12, out);
+        break;
+      case NF_IP_DST:
+        if (ip4) formatIPv4(ip4 + 16, out);
+        break;
+      case NF_IPV6_PLEN:
+        if (ip6) out = std::to_string(be16(ip6 + 4));
+        break;
+      case NF_IPV6_NXT:
+        if (ip6) out = std::to_string(ip6[6]);
+        break;
+      case NF_IPV6_HLIM:
+        if (ip6) out = std::to_string(ip6[7]);
+        break;
+      case NF_IPV6_SRC:
+        if (ip6) formatIPv6(ip6 + 8, out);
+        break;
+      case NF_IPV6_DST:
+        if (ip6) formatIPv6(ip6 + 24, out);
+        break;
+      case NF_TCP_SRCPORT:
+        if (tcp) out = std::to_string(be16(tcp));
+        break;
+      case NF_TCP_DSTPORT:
+        if (tcp) out = std::to_string(be16(tcp + 2));
+        break;
+      case NF_TCP_PORT:
+        if (tcp) out = fmt::format("{},{}", be16(tcp), be16(tcp + 2));
+        break;
+      case NF_TCP_SEQ_RAW:
+        if (tcp) out = std::to_string(be32(tcp + 4));
+        break;
+      case NF_TCP_ACK_RAW:
+        if (tcp) out = std::to_string(be32(tcp + 8));
+        break;
+      case NF_TCP_HDR_LEN:
+        if (tcp) out = std::to_string((tcp[12] >> 4) * 4);
+        break;
+      case NF_TCP_LEN:
+        if (tcp) {
+          uint32_t hdr_len = (tcp[12] >> 4) * 4;
+          out = std::to_string(pkt.l4_len >= hdr_len ? pkt.l4_len - hdr_len : 0);
+        }
+        break;
+      case NF_TCP_WINDOW_SIZE_VALUE:
+        if (tcp) out = std::to_string(be16(tcp + 14));
+        break;
+      case NF_UDP_SRCPORT:
+        if (udp) out = std::to_string(be16(udp));
+        break;
+      case NF_UDP_DSTPORT:
+        if (udp) out = std::to_string(be16(udp + 2));
+        break;
+      case NF_UDP_PORT:
+        if (udp) out = fmt::format("{},{}", be16(udp), be16(udp + 2));
+        break;
+      case NF_UDP_LENGTH:
+        if (udp) out = std::to_string(be16(udp + 4));
+        break;
+      case NF_COL_DEF_SRC:
+        if (ip4)
+          formatIPv4(ip4 + 12, out);
+        else if (ip6)
+          formatIPv6(ip6 + 8, out);
+        else if (pkt.eth)
+          formatMac(pkt.eth + 6, out);
+        break;
+      case NF_COL_DEF_DST:
+        if (ip4)
+          formatIPv4(ip4 + 16, out);
+        else if (ip6)
+          formatIPv6(ip6 + 24, out);
+        else if (pkt.eth)
+          formatMac(pkt.eth, out);
+        break;
+      default:
+        break;
+    }
+  }
+
+  bool parseNativeDisplayFilter(const std::string& filter, uint32_t& layer_mask) {
+    layer_mask = 0;
+    std::string expr = trim_copy(filter);
+    if (expr == "") return true;
+
+    // normalize "or" to "||" so that a single delimiter is used for splitting
+    std::string normalized;
+    for (auto& token : split_with_trim(expr, " ")) {
+      if (token == "") continue;
+      normalized += (token == "or") ? "||" : token;
+    }
+
+    size_t start = 0;
+    while (start <= normalized.length()) {
+      size_t end = normalized.find("||", start);
+      std::string proto = normalized.substr(start, end == std::string::npos ? std::string::npos
+                                                                            : end - start);
+      if (proto == "frame")
+        layer_mask |= LAYER_FRAME;
+      else if (proto == "eth")
+        layer_mask |= LAYER_ETH;
+      else if (proto == "vlan")
+        layer_mask |= LAYER_VLAN;
+      else if (proto == "ip")
+        layer_mask |= LAYER_IP;
+      else if (proto == "ipv6")
+        layer_mask |= LAYER_IPV6;
+      else if (proto == "tcp")
+        layer_mask |= LAYER_TCP;
+      else if (proto == "udp")
+        layer_mask |= LAYER_UDP;
+      else
+        return false;
+
+      if (end == std::string::npos) break;
+      start = end + 2;
+    }
+    return true;
+  }
+
+}  // namespace fpnt
@@ -0,0 +1,222 @@
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <fpnt/pkt_cache.h>
+#include <fpnt/util.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace fpnt {
+
+  namespace {
+    constexpr char CACHE_MAGIC[8] = {'F', 'P', 'N', 'T', 'P', 'K', 'C', '1'};
+    constexpr uint64_t CACHE_BYTE_ORDER = 0x0102030405060708ULL;
+
+    constexpr uint64_t P1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t P3 = 0x165667B19E3779F9ULL;
+
+    inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+    inline uint64_t mix(uint64_t acc, uint64_t word) { return rotl(acc + word * P2, 31) * P1; }
+    inline uint64_t load64(const uint8_t* p) {
+      uint64_t word;
+      memcpy(&word, p, sizeof(word));
+      return word;
+    }
+
+    // a read-only memory map of a whole file
+    struct MappedFile {
+      int fd = -1;
+      const uint8_t* data = nullptr;
+      size_t size = 0;
+
+      MappedFile(const std::filesystem::path& path) {
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) return;
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) return;
+        data = (const uint8_t*)addr;
+        size = st.st_size;
+        madvise(addr, size, MADV_SEQUENTIAL);
+      }
+      MappedFile(const MappedFile&) = delete;
+      MappedFile& operator=(const MappedFile&) = delete;
+      ~MappedFile() {
+        if (data != nullptr) munmap((void*)data, size);
+        if (fd >= 0) close(fd);
+      }
+    };
+  }  // namespace
+
+  // four independent lanes over 32-byte stripes, then the tail and a final avalanche
+  uint64_t hash64(const void* data, size_t len, uint64_t seed) {
+    const uint8_t* p = (const uint8_t*)data;
+    const uint8_t* end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+      uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+      for (; p + 32 <= end; p += 32) {
+        v1 = mix(v1, load64(p));
+        v2 = mix(v2, load64(p + 8));
+        v3 = mix(v3, load64(p + 16));
+        v4 = mix(v4, load64(p + 24));
+      }
+      h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+      h = (h ^ mix(0, v1)) * P1 + P3;
+      h = (h ^ mix(0, v2)) * P1 + P3;
+      h = (h ^ mix(0, v3)) * P1 + P3;
+      h = (h ^ mix(0, v4)) * P1 + P3;
+    } else {
+      h = seed + P3;
+    }
+
+    h += len;
+    for (; p + 8 <= end; p += 8) h = rotl(h ^ mix(0, load64(p)), 27) * P1 + P3;
+    for (; p < end; p++) h = rotl(h ^ (*p * P3), 11) * P1;
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+  }
+
+  bool hashFile(const std::filesystem::path& path, uint64_t& hash) {
+    MappedFile file(path);
+    if (file.fd < 0) return false;
+    hash = hash64(file.data, file.size);
+    return true;
+  }
+
+  PacketCache::PacketCache(const nlohmann::json& config, const std::string& tshark_version) {
+    if (config.contains("decode_cache_path"))
+      cache_dir = config["decode_cache_path"].get<std::string>();
+    if (config.contains("decode_cache_content_hash"))
+      content_hash = config["decode_cache_content_hash"].get<bool>();
+    if (!enabled()) return;
+
+    std::error_code ec;
+    std::filesystem::create_directories(cache_dir, ec);
+    if (ec) {
+      std::cerr << "PacketCache: failed to create " << cache_dir << " (" << ec.message()
+                << "); decode cache is disabled." << std::endl;
+      cache_dir.clear();
+      return;
+    }
+
+    auto option = [&config](const std::string& key) -> std::string {
+      return config.contains(key) ? config[key].dump() : "null";
+    };
+
+    options = "fpnt packet cache v2\n";
+    options += "tshark: " + tshark_version + "\n";
+    options += "tshark_option: " + option("tshark_option") + "\n";
+    options += "tshark_displayfilter: " + option("tshark_displayfilter") + "\n";
+    options += "early_stop_pkts: " + option("early_stop_pkts") + "\n";
+    options += "native_decoder: " + option("native_decoder") + "\n";
+    options += "tshark_chunks: " + option("tshark_chunks") + "\n";
+    options += "capture_prefilter: " + option("capture_prefilter") + "\n";
+  }
+
+  std::string PacketCache::genFileId(const std::filesystem::path& in_filepath) const {
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(in_filepath, ec);
+
+    if (content_hash) {
+      uint64_t hash = 0;
+      if (!hashFile(in_filepath, hash)) return "";
+      return fmt::format("content: {:016x} {}", hash, size);
+    }
+
+    auto mtime = std::filesystem::last_write_time(in_filepath, ec).time_since_epoch().count();
+    return fmt::format("file: {} {} {}", std::filesystem::absolute(in_filepath).c_str(), size,
+                       mtime);
+  }
+
+  std::string PacketCache::genKey(const std::filesystem::path& in_filepath) const {
+    return options + genFileId(in_filepath) + "\n";
+  }
+
+  std::filesystem::path PacketCache::getPath(const std::string& key) const {
+    return cache_dir / fmt::format("{:016x}.fpc", hash64(key.data(), key.size()));
+  }
+
+  // cache file layout: magic, byte order mark, key length, key, and PacketTable::serialize()
+  bool PacketCache::load(const std::string& key, PacketTable& in_pkts) const {
+    if (!enabled()) return false;
+    auto path = getPath(key);
+    if (!std::filesystem::exists(path)) return false;
+
+    // the table is read from the file into its own buffers; a memory map would be copied anyway
+    std::error_code ec;
+    const uintmax_t size = std::filesystem::file_size(path, ec);
+    std::ifstream is(path, std::ios::binary);
+    const size_t header_size = sizeof(CACHE_MAGIC) + 2 * sizeof(uint64_t);
+    if (ec || !is || size < header_size) return false;
+
+    char magic[sizeof(CACHE_MAGIC)];
+    uint64_t byte_order, key_len;
+    is.read(magic, sizeof(magic));
+    is.read((char*)&byte_order, sizeof(byte_order));
+    is.read((char*)&key_len, sizeof(key_len));
+    if (!is || memcmp(magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+        || byte_order != CACHE_BYTE_ORDER || key_len != key.size() || size - header_size < key_len)
+      return false;
+    std::string file_key(key_len, '\0');
+    if (!is.read(file_key.data(), key_len) || file_key != key) return false;
+
+    if (!in_pkts.deserialize(is, size - header_size - key_len)) {
+      std::cerr << "PacketCache::load: " << path << " is broken; it will be decoded again."
+                << std::endl;
+      return false;
+    }
+
+#ifndef NDEBUG
+    std::cout << "decode cache hit: " << path << std::endl;
+#endif
+    return true;
+  }
+
+  void PacketCache::save(const std::string& key, const PacketTable& in_pkts) const {
+    if (!enabled()) return;
+    auto path = getPath(key);
+
+    // concurrent workers may write the same entry; the complete file is renamed atomically
+    auto tmp_path = path;
+    tmp_path += fmt::format(".tmp.{}", getpid());
+    {
+      std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+      os.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+      uint64_t byte_order = CACHE_BYTE_ORDER;
+      uint64_t key_len = key.size();
+      os.write((const char*)&byte_order, sizeof(byte_order));
+      os.write((const char*)&key_len, sizeof(key_len));
+      os.write(key.data(), key.size());
+      in_pkts.serialize(os);
+      if (!os) {
+        std::cerr << "PacketCache::save: failed to write " << tmp_path << std::endl;
+        os.close();
+        std::error_code ec;
+        std::filesystem::remove(tmp_path, ec);
+        return;
+      }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) {
+      std::cerr << "PacketCache::save: failed to rename " << tmp_path << " (" << ec.message()
+                << ")" << std::endl;
+      std::filesystem::remove(tmp_path, ec);
+    }
+  }
+
+}  // namespace fpnt
@@ -0,0 +1,408 @@
+#include <fpnt/pkt_table.h>
+
+#include <charconv>
+#include <cstring>
+#include <iostream>
+
+namespace fpnt {
+
+  bool PktRef::contains(const std::string& field) const {
+    return table->col(field) != (size_t)-1;
+  }
+
+  std::string PktRef::operator[](const std::string& field) const {
+    return table->str(row, field);
+  }
+
+  // a canonical decimal integer is converted back to the same string by std::to_chars; "-0",
+  // leading zeros, a plus sign and out-of-range values are not canonical
+  bool PacketTable::parseCanonicalInt(std::string_view value, int64_t& num) {
+    if (value.empty() || value.size() > 20) return false;
+    size_t digits = (value[0] == '-') ? 1 : 0;
+    if (digits == value.size()) return false;
+    if (value[digits] == '0' && (value.size() > digits + 1 || digits == 1)) return false;
+
+    auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), num);
+    return ec == std::errc() && ptr == value.data() + value.size() && num != NUM_EMPTY;
+  }
+
+  void PacketTable::reset(const std::vector<std::string>& fields) {
+    this->fields.clear();
+    field_to_col.clear();
+    columns.clear();
+    arena.clear();
+    rows = 0;
+    for (const auto& field : fields) addColumn(field);
+  }
+
+  size_t PacketTable::addColumn(const std::string& field) {
+    auto it = field_to_col.find(field);
+    if (it != field_to_col.end()) return it->second;
+
+    size_t col = columns.size();
+    fields.push_back(field);
+    field_to_col[field] = col;
+    columns.emplace_back();
+    columns.back().cells.assign(rows, (uint64_t)NUM_EMPTY);
+    return col;
+  }
+
+  void PacketTable::removeColumn(const std::string& field) {
+    size_t col = this->col(field);
+    if (col == (size_t)-1) return;
+
+    fields.erase(fields.begin() + col);
+    columns.erase(columns.begin() + col);
+    field_to_col.clear();
+    for (size_t i = 0; i < fields.size(); i++) field_to_col[fields[i]] = i;
+  }
+
+  void PacketTable::reorder(const std::vector<std::string>& fields) {
+    if (fields.size() != this->fields.size()) {
+      std::cerr << "PacketTable::reorder: the number of fields is mismatched!" << std::endl;
+      exit(1);
+    }
+
+    std::vector<Column> reordered;
+    reordered.reserve(columns.size());
+    for (const auto& field : fields) {
+      size_t col = this->col(field);
+      if (col == (size_t)-1) {
+        std::cerr << "PacketTable::reorder: unknown field " << field << std::endl;
+        exit(1);
+      }
+      reordered.push_back(std::move(columns[col]));
+    }
+
+    columns = std::move(reordered);
+    this->fields = fields;
+    field_to_col.clear();
+    for (size_t i = 0; i < fields.size(); i++) field_to_col[fields[i]] = i;
+  }
+
+  void PacketTable::shrink_to_fit() {
+    arena.shrink_to_fit();
+    for (auto& column : columns) column.cells.shrink_to_fit();
+  }
+
+  size_t PacketTable::col(const std::string& field) const {
+    auto it = field_to_col.find(field);
+    return (it == field_to_col.end()) ? (size_t)-1 : it->second;
+  }
+
+  size_t PacketTable::memory() const {
+    size_t result = arena.capacity();
+    for (const auto& column : columns) result += column.cells.capacity() * sizeof(uint64_t);
+    return result;
+  }
+
+  uint64_t PacketTable::store(std::string_view value) {
+    if (value.empty()) return 0;
+    if (value.size() > REF_MAX_LEN || arena.size() + value.size() > REF_MAX_OFFSET) {
+      std::cerr << "PacketTable::store: a field value (" << value.size()
+                << " bytes) or the packet table exceeds the size limit!" << std::endl;
+      exit(1);
+    }
+
+    uint64_t ref = ((uint64_t)arena.size() << REF_LEN_BITS) | value.size();
+    arena.insert(arena.end(), value.begin(), value.end());
+    return ref;
+  }
+
+  // convert a numeric column to a string column; values are formatted in place
+  void PacketTable::demote(Column& column) {
+    char buf[24];
+    for (auto& cell : column.cells) {
+      int64_t num = (int64_t)cell;
+      if (num == NUM_EMPTY) {
+        cell = 0;
+        continue;
+      }
+      auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), num);
+      cell = store(std::string_view(buf, ptr - buf));
+    }
+    column.numeric = false;
+  }
+
+  size_t PacketTable::addRow() {
+    for (auto& column : columns) column.cells.push_back(column.numeric ? (uint64_t)NUM_EMPTY : 0);
+    return rows++;
+  }
+
+  void PacketTable::set(size_t row, size_t col, std::string_view value) {
+    Column& column = columns[col];
+
+    if (column.numeric) {
+      int64_t num;
+      if (value.empty()) {
+        column.cells[row] = (uint64_t)NUM_EMPTY;
+        return;
+      } else if (parseCanonicalInt(value, num)) {
+        column.cells[row] = (uint64_t)num;
+        return;
+      }
+      demote(column);
+    }
+
+    // consecutive packets often share the same value (e.g., addresses of the same flow), so the
+    // previous reference is reused instead of copying the value again
+    if (row > 0 && !value.empty()) {
+      uint64_t prev = column.cells[row - 1];
+      if (ref2view(prev) == value) {
+        column.cells[row] = prev;
+        return;
+      }
+    }
+    column.cells[row] = store(value);
+  }
+
+  void PacketTable::append(PacketTable& other) {
+    if (other.fields != fields) {
+      std::cerr << "PacketTable::append: the fields of the tables are mismatched!" << std::endl;
+      exit(1);
+    }
+
+    // a column is numeric only if it is numeric in both tables
+    for (size_t col = 0; col < columns.size(); col++) {
+      if (columns[col].numeric && !other.columns[col].numeric) demote(columns[col]);
+      if (!columns[col].numeric && other.columns[col].numeric) other.demote(other.columns[col]);
+    }
+
+    uint64_t base = arena.size();
+    if (base + other.arena.size() > REF_MAX_OFFSET) {
+      std::cerr << "PacketTable::append: the packet table exceeds the size limit!" << std::endl;
+      exit(1);
+    }
+    arena.insert(arena.end(), other.arena.begin(), other.arena.end());
+
+    for (size_t col = 0; col < columns.size(); col++) {
+      auto& cells = columns[col].cells;
+      const auto& other_cells = other.columns[col].cells;
+      if (columns[col].numeric) {
+        cells.insert(cells.end(), other_cells.begin(), other_cells.end());
+        continue;
+      }
+      cells.reserve(cells.size() + other_cells.size());
+      for (auto ref : other_cells) {  // rebase the arena offsets of non-empty strings
+        cells.push_back((ref & REF_MAX_LEN) ? ref + (base << REF_LEN_BITS) : 0);
+      }
+    }
+    rows += other.rows;
+
+    other.reset({});
+    other.shrink_to_fit();
+  }
+
+  bool PacketTable::offsetColumn(size_t col, int64_t delta) {
+    Column& column = columns[col];
+    if (!column.numeric) return false;
+    for (auto& cell : column.cells) {
+      if ((int64_t)cell != NUM_EMPTY) cell = (uint64_t)((int64_t)cell + delta);
+    }
+    return true;
+  }
+
+  bool PacketTable::renumberColumn(size_t col, const std::vector<uint64_t>& values) {
+    Column& column = columns[col];
+    if (!column.numeric) return false;
+    for (auto& cell : column.cells) {
+      if ((int64_t)cell == NUM_EMPTY) continue;
+      if ((int64_t)cell < 1 || (uint64_t)cell > values.size()) return false;
+      cell = values[cell - 1];
+    }
+    return true;
+  }
+
+  bool PacketTable::join(PacketTable& other, const std::string& key_field) {
+    size_t key_col = col(key_field);
+    size_t other_key_col = other.col(key_field);
+    if (key_col == (size_t)-1 || other_key_col == (size_t)-1 || rows != other.rows) return false;
+    if (!columns[key_col].numeric || !other.columns[other_key_col].numeric) return false;
+    if (columns[key_col].cells != other.columns[other_key_col].cells) return false;
+
+    uint64_t base = arena.size();
+    if (base + other.arena.size() > REF_MAX_OFFSET) return false;
+    arena.insert(arena.end(), other.arena.begin(), other.arena.end());
+
+    for (size_t other_col = 0; other_col < other.columns.size(); other_col++) {
+      if (col(other.fields[other_col]) != (size_t)-1) continue;
+      Column& column = columns[addColumn(other.fields[other_col])];
+      column.numeric = other.columns[other_col].numeric;
+      column.cells = std::move(other.columns[other_col].cells);
+      if (column.numeric) continue;
+      for (auto& ref : column.cells) {  // rebase the arena offsets of non-empty strings
+        if (ref & REF_MAX_LEN) ref += base << REF_LEN_BITS;
+      }
+    }
+
+    other.reset({});
+    other.shrink_to_fit();
+    return true;
+  }
+
+  void PacketTable::project(const std::vector<std::string>& fields) {
+    bool dropped = (fields.size() < this->fields.size());
+    std::vector<Column> projected;
+    for (const auto& field : fields) {
+      size_t col = this->col(field);
+      if (col == (size_t)-1) {
+        std::cerr << "PacketTable::project: unknown field " << field << std::endl;
+        exit(1);
+      }
+      projected.push_back(std::move(columns[col]));
+    }
+
+    columns = std::move(projected);
+    this->fields = fields;
+    field_to_col.clear();
+    for (size_t i = 0; i < fields.size(); i++) field_to_col[fields[i]] = i;
+    if (!dropped) return;
+
+    // copy only the strings referenced by the remaining columns to a new arena
+    std::vector<char> old_arena;
+    old_arena.swap(arena);
+    for (auto& column : columns) {
+      if (column.numeric) continue;
+      uint64_t prev_old = 0, prev_new = 0;
+      for (auto& ref : column.cells) {
+        if ((ref & REF_MAX_LEN) == 0) continue;
+        if (ref == prev_old) {  // consecutive duplicates keep sharing a reference
+          ref = prev_new;
+          continue;
+        }
+        prev_old = ref;
+        ref = store(std::string_view(old_arena.data() + (ref >> REF_LEN_BITS), ref & REF_MAX_LEN));
+        prev_new = ref;
+      }
+    }
+    arena.shrink_to_fit();
+  }
+
+  bool PacketTable::getNum(size_t row, size_t col, int64_t& num) const {
+    const Column& column = columns[col];
+    if (!column.numeric || (int64_t)column.cells[row] == NUM_EMPTY) return false;
+    num = (int64_t)column.cells[row];
+    return true;
+  }
+
+  std::string_view PacketTable::view(size_t row, size_t col, std::string& buf) const {
+    const Column& column = columns[col];
+    if (!column.numeric) return ref2view(column.cells[row]);
+
+    int64_t num = (int64_t)column.cells[row];
+    if (num == NUM_EMPTY) return std::string_view();
+    char tmp[24];
+    auto [ptr, ec] = std::to_chars(tmp, tmp + sizeof(tmp), num);
+    buf.assign(tmp, ptr - tmp);
+    return buf;
+  }
+
+  std::string PacketTable::str(size_t row, size_t col) const {
+    std::string buf;
+    return std::string(view(row, col, buf));
+  }
+
+  std::string PacketTable::str(size_t row, const std::string& field) const {
+    size_t col = this->col(field);
+    if (col == (size_t)-1) return "";
+    return str(row, col);
+  }
+
+  nlohmann::json PacketTable::dump(size_t row) const {
+    nlohmann::json result;
+    for (size_t col = 0; col < fields.size(); col++) result[fields[col]] = str(row, col);
+    result["idx"] = row;
+    return result;
+  }
+
+  namespace {
+    void put64(std::ostream& os, uint64_t value) {
+      os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    // a bounds-checked reader of a serialized image of len bytes from a stream
+    struct ImageReader {
+      std::istream& is;
+      size_t len;
+      size_t pos = 0;
+
+      bool read(void* dst, uint64_t size) {
+        if (len - pos < size || !is.read(static_cast<char*>(dst), size)) return false;
+        pos += size;
+        return true;
+      }
+      bool get64(uint64_t& value) { return read(&value, sizeof(value)); }
+    };
+  }  // namespace
+
+  // layout: rows, columns, arena size, (name length, name, numeric) per column, arena, and the
+  // cells of each column
+  void PacketTable::serialize(std::ostream& os) const {
+    put64(os, rows);
+    put64(os, columns.size());
+    put64(os, arena.size());
+    for (size_t col = 0; col < columns.size(); col++) {
+      put64(os, fields[col].size());
+      os.write(fields[col].data(), fields[col].size());
+      put64(os, columns[col].numeric ? 1 : 0);
+    }
+    os.write(arena.data(), arena.size());
+    for (const auto& column : columns) {
+      os.write(reinterpret_cast<const char*>(column.cells.data()), rows * sizeof(uint64_t));
+    }
+  }
+
+  // the arena and the cells are read straight into the table, without an intermediate copy
+  bool PacketTable::deserialize(std::istream& is, size_t len) {
+    ImageReader in{is, len};
+    uint64_t no_rows, no_cols, arena_size;
+    if (!in.get64(no_rows) || !in.get64(no_cols) || !in.get64(arena_size)) return false;
+    if (arena_size > REF_MAX_OFFSET || arena_size > len || no_cols > len
+        || no_rows > len / sizeof(uint64_t))
+      return false;
+
+    std::vector<std::string> names;
+    std::vector<bool> numeric;
+    for (uint64_t col = 0; col < no_cols; col++) {
+      uint64_t name_len, flag;
+      if (!in.get64(name_len) || name_len > len - in.pos) return false;
+      std::string name(name_len, '\0');
+      if (!in.read(name.data(), name_len) || !in.get64(flag)) return false;
+      names.push_back(std::move(name));
+      numeric.push_back(flag != 0);
+    }
+    if (len - in.pos < arena_size
+        || (len - in.pos - arena_size) != no_cols * no_rows * sizeof(uint64_t))
+      return false;
+
+    reset(names);
+    if (columns.size() != no_cols) {  // duplicated field names
+      reset({});
+      return false;
+    }
+    arena.resize(arena_size);
+    if (!in.read(arena.data(), arena_size)) {
+      reset({});
+      return false;
+    }
+    rows = no_rows;
+    for (uint64_t col = 0; col < no_cols; col++) {
+      columns[col].numeric = numeric[col];
+      columns[col].cells.resize(no_rows);
+      if (!in.read(columns[col].cells.data(), no_rows * sizeof(uint64_t))) {
+        reset({});
+        return false;
+      }
+
+      if (numeric[col]) continue;
+      for (auto ref : columns[col].cells) {  // every reference must point into the arena
+        if ((ref >> REF_LEN_BITS) + (ref & REF_MAX_LEN) > arena_size) {
+          reset({});
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+}  // namespace fpnt
@@ -0,0 +1,393 @@
+#include <fpnt/plan.h>
+#include <fpnt/util.h>
+
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <set>
+
+namespace fpnt {
+
+  namespace {
+    // fields written by Dispatcher::process_base before any column is computed
+    bool isBaseField(const std::string& field) {
+      if (field == "__in_idx") return true;
+      if (field.size() < 6 || field.substr(0, 2) != "__") return false;
+      std::string suffix = field.substr(field.size() - 4);
+      return suffix == "_idx" || suffix == "_dir";
+    }
+
+    bool hasBatchStep(const PlanColumn& column) {
+      for (auto& step : column.steps) {
+        if (step.batch_fn != nullptr) return true;
+      }
+      return false;
+    }
+
+    // every step of the column has a batch function and its references are declared
+    bool isBatchColumn(const PlanColumn& column) {
+      if (column.opaque || column.steps.empty()) return false;
+      for (auto& step : column.steps) {
+        if (step.batch_fn == nullptr) return false;
+      }
+      return true;
+    }
+
+    /** splitRuns partitions the order of a granularity into runs. Without an opaque column, the
+     * whole order is a single run, batched if a step has a batch function. An opaque column may
+     * read any field of the other records, which are then expected in the per-record order; so
+     * only the consecutive columns whose every step has a batch function are batched.
+     */
+    void splitRuns(GranularityPlan& g_plan) {
+      g_plan.runs.clear();
+      g_plan.batched = false;
+      const size_t no_order = g_plan.order.size();
+      if (no_order == 0) return;
+      if (!g_plan.opaque) {
+        bool batched = false;
+        for (size_t c : g_plan.order) batched = batched || hasBatchStep(g_plan.columns[c]);
+        g_plan.runs.push_back({0, no_order, batched});
+        g_plan.batched = batched;
+        return;
+      }
+      for (size_t pos = 0; pos < no_order; pos++) {
+        const bool batched = isBatchColumn(g_plan.columns[g_plan.order[pos]]);
+        if (!g_plan.runs.empty() && g_plan.runs.back().batched == batched) {
+          g_plan.runs.back().end = pos + 1;
+        } else {
+          g_plan.runs.push_back({pos, pos + 1, batched});
+        }
+        if (batched) g_plan.batched = true;
+      }
+    }
+
+    // "^" continues the multi-output block of the previous column
+    bool isBlockContinuation(const std::vector<std::pair<std::string, std::string>>& prep_fns) {
+      return prep_fns.size() == 1 && prep_fns[0].first == "^";
+    }
+  }  // namespace
+
+  void ExecutionPlan::build(const std::vector<std::string>& g_lvs,
+                            std::unordered_map<std::string, Mapper>& out_maps, Loader& loader,
+                            const nlohmann::json& config) {
+    clear();
+
+    // the granularities written to CSV files (all if not set or empty); the others are intermediate
+    std::set<std::string> written;
+    if (config.contains("output_granularities")) {
+      for (auto& token : split(config["output_granularities"].get<std::string>(), ',')) {
+        const auto first = token.find_first_not_of(" \t");
+        if (first == std::string::npos) continue;
+        const auto last = token.find_last_not_of(" \t");
+        written.insert(token.substr(first, (last - first + 1)));
+      }
+      for (auto& granularity : written) {
+        if (std::find(g_lvs.begin(), g_lvs.end(), granularity) == g_lvs.end()) {
+          std::cerr << "ExecutionPlan: output_granularities has an unknown granularity "
+                    << granularity << "!" << std::endl;
+          exit(1);
+        }
+      }
+    }
+    if (written.empty()) written.insert(g_lvs.begin(), g_lvs.end());
+
+    for (size_t i = 0; i < g_lvs.size(); i++) {
+      const std::string& granularity = g_lvs[i];
+      Mapper& map = out_maps[granularity];
+
+      GranularityPlan g_plan;
+      g_plan.granularity = granularity;
+      g_plan.level = i;
+      const std::string str_genkey = config["genKey_" + granularity].get<std::string>();
+      g_plan.genKey = loader.getGenKeyFn(str_genkey);
+      g_plan.genKeyDir = loader.getGenKeyDirFn(str_genkey);
+      g_plan.genKeyTuple = loader.getGenKeyTupleFn(str_genkey);
+      g_plan.written = written.contains(granularity);
+
+      std::vector<std::string> fields = map.getFields();
+      for (size_t c = 0; c < fields.size(); c++) {
+        std::string& field = fields[c];
+        PlanColumn column;
+        column.field = field;
+        column.slot = map[field];
+        if (!parseValueType(map.getType(column.slot), column.type)) {
+          std::cerr << "ExecutionPlan: the type " << map.getType(column.slot) << " of " << field
+                    << " (" << granularity << ") is not one of string, int, double and timestamp!"
+                    << std::endl;
+          exit(1);
+        }
+        auto prep_fns = map.getPrepFns(field);
+        if (isBlockContinuation(prep_fns)) {
+          const PlanColumn* prev = g_plan.columns.empty() ? nullptr : &g_plan.columns.back();
+          if (prev != nullptr && prev->head != (size_t)-1) {
+            column.head = prev->head;
+          } else if (prev != nullptr && !prev->steps.empty()
+                     && prev->steps[0].multi_fn != nullptr) {
+            column.head = c - 1;
+          } else {
+            std::cerr << "ExecutionPlan: " << field << " (" << granularity
+                      << ") does not follow a multi-output function!" << std::endl;
+            exit(1);
+          }
+          PlanStep& head_step = g_plan.columns[column.head].steps[0];
+          head_step.options.push_back(prep_fns[0].second);
+          head_step.fields.push_back(field);
+          g_plan.columns.push_back(std::move(column));
+          continue;
+        }
+
+        // the first column of a multi-output block
+        const bool block_head
+            = (c + 1 < fields.size()) && isBlockContinuation(map.getPrepFns(fields[c + 1]));
+        if (block_head && prep_fns.size() != 1) {
+          std::cerr << "ExecutionPlan: " << field << " (" << granularity
+                    << ") must have a single multi-output function for the following ^ fields!"
+                    << std::endl;
+          exit(1);
+        }
+
+        for (auto& [str_fn, option] : prep_fns) {
+          if (block_head) {
+            if (!loader.validate(str_fn + "_multi")) {
+              std::cerr << "ExecutionPlan: " << str_fn << "_multi of " << field << " ("
+                        << granularity << ") is not found in the plugin library!" << std::endl;
+              exit(1);
+            }
+            PlanStep step;  // the state and the references are resolved when the block is complete
+            step.name = str_fn;
+            step.option = option;
+            step.multi_fn = loader.getPrepMultiFn(str_fn);
+            step.options.push_back(option);
+            step.fields.push_back(field);
+            step.threadsafe = loader.isThreadSafePrepFn(str_fn);
+            if (!step.threadsafe) g_plan.threadsafe = false;
+            column.steps.push_back(std::move(step));
+            continue;
+          }
+          if (!loader.validate(str_fn)) {
+            std::cerr << "ExecutionPlan: " << str_fn << " of " << field << " (" << granularity
+                      << ") is not found in the plugin library!" << std::endl;
+            exit(1);
+          }
+          PlanStep step;
+          step.name = str_fn;
+          step.option = option;
+          if (loader.isStatefulPrepFn(str_fn)) {
+            step.state_fn = loader.getPrepStateFn(str_fn);
+            step.destroy = loader.getPrepDestroyFn(str_fn);
+            step.state = loader.getPrepInitFn(str_fn)(option);
+          } else {
+            step.fn = loader.getPrepFn(str_fn);
+          }
+          step.batch_fn = loader.getPrepBatchFn(str_fn);
+          step.threadsafe = loader.isThreadSafePrepFn(str_fn);
+          if (!step.threadsafe) g_plan.threadsafe = false;
+          fnptr_PrepRefsFn refs_fn = loader.getPrepRefsFn(str_fn);
+          if (refs_fn != nullptr) {
+            refs_fn(option, granularity, column.refs);
+          } else {
+            column.opaque = true;
+          }
+          column.steps.push_back(std::move(step));
+        }
+        g_plan.columns.push_back(std::move(column));
+      }
+
+      for (auto& column : g_plan.columns) {
+        if (column.steps.empty() || column.steps[0].multi_fn == nullptr) continue;
+        PlanStep& step = column.steps[0];
+        fnptr_PrepMultiInitFn init_fn = loader.getPrepMultiInitFn(step.name);
+        if (init_fn != nullptr) step.state = init_fn(step.options);
+        step.destroy = loader.getPrepMultiDestroyFn(step.name);
+        fnptr_PrepRefsFn refs_fn = loader.getPrepRefsFn(step.name);
+        if (refs_fn != nullptr) {
+          for (auto& option : step.options) refs_fn(option, granularity, column.refs);
+        } else {
+          column.opaque = true;
+        }
+      }
+
+      level_idx[granularity] = i;
+      levels.push_back(std::move(g_plan));
+    }
+
+    schedule();
+  }
+
+  /** schedule builds the dependency graph of all columns (nodes are numbered by the level and the
+   * CSV order) and derives the needed columns, their order within each granularity, and the waves
+   * of granularities. A reference to a field which is not a column (e.g., __dir written by P_dir)
+   * depends on every column of the referred granularity, or on the previous columns if it is the
+   * same granularity. An opaque column keeps its position in the original order (the levels, then
+   * the CSV order): it depends on every node before it, and every node after it depends on it.
+   */
+  void ExecutionPlan::schedule() {
+    std::vector<size_t> offset(levels.size() + 1, 0);
+    std::vector<std::unordered_map<std::string, size_t>> column_idx(levels.size());
+    for (size_t g = 0; g < levels.size(); g++) {
+      offset[g + 1] = offset[g] + levels[g].columns.size();
+      for (size_t c = 0; c < levels[g].columns.size(); c++) {
+        column_idx[g][levels[g].columns[c].field] = c;
+      }
+    }
+    const size_t no_nodes = offset.back();
+    std::vector<size_t> node_level(no_nodes);
+    for (size_t g = 0; g < levels.size(); g++) {
+      for (size_t node = offset[g]; node < offset[g + 1]; node++) node_level[node] = g;
+    }
+
+    std::vector<std::vector<size_t>> deps(no_nodes);
+    size_t last_opaque = -1;
+    for (size_t g = 0; g < levels.size(); g++) {
+      for (size_t c = 0; c < levels[g].columns.size(); c++) {
+        const size_t node = offset[g] + c;
+        const PlanColumn& column = levels[g].columns[c];
+        if (column.opaque) {  // the previous nodes until the last opaque one (transitively all)
+          for (size_t prev = (last_opaque == (size_t)-1) ? 0 : last_opaque; prev < node; prev++) {
+            deps[node].push_back(prev);
+          }
+          last_opaque = node;
+          continue;
+        }
+        if (last_opaque != (size_t)-1) deps[node].push_back(last_opaque);
+        if (column.head != (size_t)-1) deps[node].push_back(offset[g] + column.head);
+
+        for (auto& [ref_g, ref_field] : column.refs) {
+          auto it = level_idx.find(ref_g);
+          if (it == level_idx.end()) {
+            std::cerr << "ExecutionPlan: " << column.field << " (" << levels[g].granularity
+                      << ") refers to " << ref_field << " of an unknown granularity " << ref_g
+                      << "!" << std::endl;
+            exit(1);
+          }
+          const size_t r = it->second;
+          if (isBaseField(ref_field)) continue;
+
+          auto found = column_idx[r].find(ref_field);
+          if (found != column_idx[r].end()) {
+            if (offset[r] + found->second != node) deps[node].push_back(offset[r] + found->second);
+            continue;
+          }
+          const size_t end = (r == g) ? c : levels[r].columns.size();
+          for (size_t j = 0; j < end; j++) deps[node].push_back(offset[r] + j);
+        }
+      }
+    }
+
+    // the columns of the written granularities and (transitively) their dependencies
+    std::vector<char> needed(no_nodes, 0);
+    std::vector<size_t> stack;
+    for (size_t g = 0; g < levels.size(); g++) {
+      if (!levels[g].written) continue;
+      for (size_t node = offset[g]; node < offset[g + 1]; node++) {
+        needed[node] = 1;
+        stack.push_back(node);
+      }
+    }
+    while (!stack.empty()) {
+      const size_t node = stack.back();
+      stack.pop_back();
+      for (size_t dep : deps[node]) {
+        if (!needed[dep]) {
+          needed[dep] = 1;
+          stack.push_back(dep);
+        }
+      }
+    }
+
+    // the order within a granularity: topological, preferring the CSV order
+    std::vector<std::set<size_t>> g_deps(levels.size());
+    for (size_t g = 0; g < levels.size(); g++) {
+      GranularityPlan& g_plan = levels[g];
+      const size_t no_columns = g_plan.columns.size();
+      std::vector<size_t> indegree(no_columns, 0);
+      std::vector<std::vector<size_t>> dependents(no_columns);
+      std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> ready;
+      size_t no_needed = 0;
+      g_plan.order.clear();
+      g_plan.opaque = false;
+
+      for (size_t c = 0; c < no_columns; c++) {
+        const size_t node = offset[g] + c;
+        if (!needed[node]) continue;
+        no_needed++;
+        if (g_plan.columns[c].opaque) g_plan.opaque = true;
+        for (size_t dep : deps[node]) {
+          if (node_level[dep] != g) {
+            g_deps[g].insert(node_level[dep]);
+            continue;
+          }
+          indegree[c]++;
+          dependents[dep - offset[g]].push_back(c);
+        }
+        if (indegree[c] == 0) ready.push(c);
+      }
+      while (!ready.empty()) {
+        const size_t c = ready.top();
+        ready.pop();
+        g_plan.order.push_back(c);
+        for (size_t next : dependents[c]) {
+          if (--indegree[next] == 0) ready.push(next);
+        }
+      }
+      if (g_plan.order.size() != no_needed) {
+        for (size_t c = 0; c < no_columns; c++) {
+          if (needed[offset[g] + c] && indegree[c] > 0) {
+            std::cerr << "ExecutionPlan: " << g_plan.columns[c].field << " ("
+                      << g_plan.granularity << ") is in a cyclic field reference!" << std::endl;
+            break;
+          }
+        }
+        exit(1);
+      }
+      splitRuns(g_plan);
+    }
+
+    // waves: a granularity follows every granularity it reads
+    waves.clear();
+    std::vector<size_t> wave_of(levels.size(), -1);
+    std::vector<char> visiting(levels.size(), 0);
+    std::function<size_t(size_t)> wave = [&](size_t g) -> size_t {
+      if (wave_of[g] != (size_t)-1) return wave_of[g];
+      if (visiting[g]) {
+        std::cerr << "ExecutionPlan: granularity " << levels[g].granularity
+                  << " is in a cyclic field reference!" << std::endl;
+        exit(1);
+      }
+      visiting[g] = 1;
+      size_t w = 0;
+      for (size_t r : g_deps[g]) w = std::max(w, wave(r) + 1);
+      visiting[g] = 0;
+      return wave_of[g] = w;
+    };
+    for (size_t g = 0; g < levels.size(); g++) {
+      if (levels[g].order.empty()) continue;  // nothing to compute
+      const size_t w = wave(g);
+      if (waves.size() <= w) waves.resize(w + 1);
+      waves[w].push_back(g);
+    }
+  }
+
+  void ExecutionPlan::clear() {
+    for (auto& g_plan : levels) {
+      for (auto& column : g_plan.columns) {
+        for (auto& step : column.steps) {
+          if (step.destroy != nullptr) step.destroy(step.state);
+        }
+      }
+    }
+    levels.clear();
+    level_idx.clear();
+    waves.clear();
+  }
+
+  const GranularityPlan& ExecutionPlan::operator[](const std::string& granularity) const {
+    auto it = level_idx.find(granularity);
+    if (it == level_idx.end()) {
+      std::cerr << "ExecutionPlan: unknown granularity " << granularity << "!" << std::endl;
+      exit(1);
+    }
+    return levels[it->second];
+  }
+
+}  // namespace fpnt
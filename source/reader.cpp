@@ -54,8 +54,8 @@ namespace fpnt {
     size_t counter = 0;
     for (auto& row : internal_reader) {
       counter++;
-      // field,name,preprocess_fns,options
-      std::string name = "", field = "", preprocess_fns_str = "", options = "";
+      // field,name,preprocess_fns,options[,type]
+      std::string name = "", field = "", preprocess_fns_str = "", options = "", type = "";
       try {
         name = row["name"].get<std::string>();
       } catch (std::runtime_error& e) {
@@ -72,11 +72,16 @@ namespace fpnt {
         options = row["options"].get<std::string>();
       } catch (std::runtime_error& e) {
       }
+      try {
+        type = row["type"].get<std::string>();  // optional; see fpnt/value.h
+      } catch (std::runtime_error& e) {
+      }
 
       trim(name);
       trim(field);
       trim(preprocess_fns_str);
       trim(options);
+      trim(type);
       std::vector<char> quote_chars{'\"', '\''};
       for (auto q : quote_chars)
         if (name[0] == q || field[0] == q
@@ -104,8 +109,7 @@ namespace fpnt {
       if (name == "") name = field;
 
       // Now, we have unempty name
-      map.addField(field, name, "", "");  // TODO: we do not use desc and type in this version.
-                                          // maybe these fields can be used
+      map.addField(field, name, "", type);  // TODO: we do not use desc in this version.
 
       map.setPrepFns(field, preprocess_fns_str, options);
     }
@@ -124,6 +128,119 @@ namespace fpnt {
     return map;
   };
 
+  // the key invalidates the index when tshark or the crawled dfref tree changes
+  void TSharkCSVReader::loadGlossary(FieldGlossary& glossary) {
+    std::string key = "fpnt field glossary\ntshark " + version + "\nsource " + dfref_index_source;
+    if (dfref_index_source == "dfref") {
+      std::error_code ec;
+      auto newest = std::filesystem::last_write_time(dfref_path, ec);
+      if (!ec) {
+        for (auto const& dir_entry : std::filesystem::directory_iterator{dfref_path, ec}) {
+          auto t = std::filesystem::last_write_time(dir_entry, ec);
+          if (!ec && t > newest) newest = t;
+        }
+      }
+      key += " " + std::filesystem::absolute(dfref_path).string() + " "
+             + std::to_string(newest.time_since_epoch().count());
+    } else if (dfref_index_source != "tshark") {
+      std::cerr << "reader_csv_input_tshark: dfref_index_source must be dfref or tshark!"
+                << std::endl;
+      exit(1);
+    }
+
+    if (glossary.open(dfref_index_path, key)) return;
+
+    std::cout << "Building the field glossary " << dfref_index_path << " from "
+              << dfref_index_source << "..." << std::endl;
+    std::map<std::string, GlossaryEntry> fields;
+    bool collected = (dfref_index_source == "dfref")
+                         ? FieldGlossary::collectDfref(dfref_path, fields)
+                         : FieldGlossary::collectTshark(tshark_path, version, fields);
+    if (!collected) {
+      std::cerr << "reader_csv_input_tshark: failed to collect fields from " << dfref_index_source
+                << "!" << std::endl;
+      exit(1);
+    }
+    if (!FieldGlossary::write(dfref_index_path, key, fields)
+        || !glossary.open(dfref_index_path, key)) {
+      std::cerr << "reader_csv_input_tshark: failed to build the field glossary "
+                << dfref_index_path << "!" << std::endl;
+      exit(1);
+    }
+  }
+
+  // returns the dfref row of field from id="field" to </tr>
+  std::string TSharkCSVReader::findDfrefRow(
+      const std::string& field,
+      std::unordered_map<std::string, std::vector<std::string> >& dfref_dirs) {
+    // note: dfref has a substantial locality
+
+    std::string first_char = std::to_string(field[0]);
+
+    if (!dfref_dirs.contains(first_char)) {  // first visit // C++20
+      std::string dir_entry = dfref_path + "/" + field[0];
+      const std::filesystem::path dfref_curr{dir_entry};
+
+      for (auto const& dir_entry : std::filesystem::directory_iterator{dfref_curr}) {
+        if (std::filesystem::is_regular_file(dir_entry.symlink_status())) {
+          std::string filename = std::filesystem::relative(dir_entry, dfref_curr);
+          dfref_dirs[std::to_string(field[0])].push_back(filename);
+        }
+      }
+    }
+
+    // directory hierarichy assumption: "dfref" / field[0] / filename
+
+    // searching algorithm:
+    // (1) take the prefix from row["tshark_displayfilter_field"]
+    // (2) iterate dfref_dirs[to_string(field[0])] and filter html files with the prefix
+    // (3) brute-force search; if failed, program will be terminated.
+
+    std::string prefix = field.substr(0, field.find("."));  // (1)
+    const std::string leftstr = "id=\"" + field + "\"";
+    const std::string rightstr = "</tr>";
+
+    bool found = false;
+    std::string found_string = "";
+    for (auto const& filename : dfref_dirs[std::to_string(field[0])]) {
+      const std::filesystem::path path_entry{dfref_path + "/" + field[0] + "/" + filename};
+
+      if (filename.substr(0, prefix.length()).find(prefix) == std::string::npos) continue;
+
+      std::ifstream i(path_entry);
+      i.imbue(std::locale("en_US.UTF8"));  // we assume that wireshark display filter reference
+                                           // will be offered as a UTF8 document.
+      // assumption by using getline, we read '<tr id=...'. We assume 4KB is sufficient to read a
+      // line until </tr> and emperically it is satisfied.
+      std::size_t l, r;
+      for (std::string line; std::getline(i, line);) {
+        if ((l = line.find(leftstr)) != std::string::npos) {               // <tr id=... found
+          if ((r = line.substr(l).find(rightstr)) != std::string::npos) {  // </tr> found
+            found = true;
+            found_string
+                = line.substr(l, r);  // r is the result of line.substr(l) and the fn call returns
+                                      // a size_t value, it should be r instead of r-1
+            break;
+          } else {
+            std::cerr << "reader_csv_input_tshark: found <tr " << leftstr
+                      << "> but failed to find </tr>" << std::endl;
+            exit(1);
+          }
+        }
+      }
+
+      if (found) break;
+    }
+
+    if (!found) {
+      std::cerr << "reader_csv_input_tshark: not found <tr " << leftstr << "> for all files!!"
+                << std::endl;
+      exit(1);
+    }
+
+    return found_string;
+  }
+
   TSharkMapper& TSharkCSVReader::read(Loader* loader) {
     std::string line;
     bool first = true;
@@ -148,11 +265,17 @@ namespace fpnt {
     //    std::cout << "READ: " << path << std::endl;
     std::unordered_map<std::string, std::vector<std::string> > dfref_dirs;
 
-    for (auto const& dir_entry : std::filesystem::directory_iterator{dfref_path}) {
-      if (std::filesystem::is_directory(dir_entry.symlink_status())) {
-        std::string dirname = std::filesystem::relative(dir_entry, dfref_path);
-        if (dirname.length() == 1) {
-          dfref_dirs.insert({dirname, std::vector<std::string>()});
+    // the field glossary index replaces the scan of the dfref HTML files
+    FieldGlossary glossary;
+    if (dfref_index_path != "") {
+      loadGlossary(glossary);
+    } else {
+      for (auto const& dir_entry : std::filesystem::directory_iterator{dfref_path}) {
+        if (std::filesystem::is_directory(dir_entry.symlink_status())) {
+          std::string dirname = std::filesystem::relative(dir_entry, dfref_path);
+          if (dirname.length() == 1) {
+            dfref_dirs.insert({dirname, std::vector<std::string>()});
+          }
         }
       }
     }
@@ -193,94 +316,19 @@ namespace fpnt {
       // name can be empty so we need to fill name
       // now we need to find desc, type, ver
 
-      // note: dfref has a substantial locality
-
-      std::string first_char = std::to_string(field[0]);
-
-      if (!dfref_dirs.contains(first_char)) {  // first visit // C++20
-        std::string dir_entry = dfref_path + "/" + field[0];
-        const std::filesystem::path dfref_curr{dir_entry};
-
-        for (auto const& dir_entry : std::filesystem::directory_iterator{dfref_curr}) {
-          if (std::filesystem::is_regular_file(dir_entry.symlink_status())) {
-            std::string filename = std::filesystem::relative(dir_entry, dfref_curr);
-            dfref_dirs[std::to_string(field[0])].push_back(filename);
-          }
+      GlossaryEntry entry;
+      if (glossary.is_open()) {
+        if (!glossary.find(field, entry)) {
+          std::cerr << "reader_csv_input_tshark: not found " << field << " in the field glossary "
+                    << dfref_index_path << "!!" << std::endl;
+          exit(1);
         }
+      } else {
+        parseDfrefRow(findDfrefRow(field, dfref_dirs), entry);
       }
 
-      // directory hierarichy assumption: "dfref" / field[0] / filename
-
-      // searching algorithm:
-      // (1) take the prefix from row["tshark_displayfilter_field"]
-      // (2) iterate dfref_dirs[to_string(field[0])] and filter html files with the prefix
-      // (3) brute-force search; if failed, program will be terminated.
-
-      std::string prefix = field.substr(0, field.find("."));  // (1)
-      const std::string leftstr = "id=\"" + field + "\"";
-      const std::string rightstr = "</tr>";
-
-      bool found = false;
-      std::string found_string = "";
-      for (auto const& filename : dfref_dirs[std::to_string(field[0])]) {
-        const std::filesystem::path path_entry{dfref_path + "/" + field[0] + "/" + filename};
-
-        if (filename.substr(0, prefix.length()).find(prefix) == std::string::npos) continue;
-
-        std::ifstream i(path_entry);
-        i.imbue(std::locale("en_US.UTF8"));  // we assume that wireshark display filter reference
-                                             // will be offered as a UTF8 document.
-        // assumption by using getline, we read '<tr id=...'. We assume 4KB is sufficient to read a
-        // line until </tr> and emperically it is satisfied.
-        std::size_t l, r;
-        for (std::string line; std::getline(i, line);) {
-          if ((l = line.find(leftstr)) != std::string::npos) {               // <tr id=... found
-            if ((r = line.substr(l).find(rightstr)) != std::string::npos) {  // </tr> found
-              found = true;
-              found_string
-                  = line.substr(l, r);  // r is the result of line.substr(l) and the fn call returns
-                                        // a size_t value, it should be r instead of r-1
-              break;
-            } else {
-              std::cerr << "reader_csv_input_tshark: found <tr " << leftstr
-                        << "> but failed to find </tr>" << std::endl;
-              exit(1);
-            }
-          }
-        }
-
-        if (found) break;
-      }
-
-      if (!found) {
-        std::cerr << "reader_csv_input_tshark: not found <tr " << leftstr << "> for all files!!"
-                  << std::endl;
-        exit(1);
-      }
-
-      std::string desc, type, ver;
-
-      // found_string contains three columns starting </td><td>. we extract each column in this code
-      // snippet
-      for (int i = 0; i < 3; i++) {
-        std::size_t l = found_string.find("</td><td>");
-        std::size_t r = found_string.substr(l + 5).find("</td>");
-        std::string x = found_string.substr(l + 5 + 4, r - 4);
-        found_string = found_string.substr(l + 5 + r);
-        switch (i) {
-          case 0:  // Description
-            desc = x;
-            if (name == "") name = x;
-            break;
-          case 1:  // Type
-            type = x;
-            break;
-
-          case 2:  // Versions
-            ver = x;
-            break;
-        }
-      }
+      std::string desc = entry.desc, type = entry.type, ver = entry.ver;
+      if (name == "") name = desc;
 
       if (version_validation) {
         verValid(field, name, ver, major, minor, patch);
@@ -310,62 +358,343 @@ namespace fpnt {
       exit(1);
     }
 
-    std::string line;
-    char c = in.get();
-    if (c == std::char_traits<char>::eof()) {  // if tshark silently terminated
-      std::string error_msg = "reader: tshark is terminated. check error log";
-      if (config.contains("fpnt_tshark_error_log")) {
-        error_msg += " " + config["fpnt_tshark_error_log"].get<std::string>();
-      }
-
-      rangBerr(error_msg, rang::fg::red);
-      in.close();
+    if (in == nullptr) {
+      std::cerr << "reader: failed to execute tshark: " << strerror(errno) << std::endl;
       exit(1);
-    } else
-      in.unget();
+    }
+
+    // a larger pipe lets tshark write ahead while fpnt is busy; failure is harmless
+    int fd = fileno(in);
+    fcntl(fd, F_SETPIPE_SZ, TSHARK_PIPE_SIZE);
+
+    // technical note: tshark's output is read in large blocks instead of line by line (see
+    // TsvReader), and each field is passed to in_pkts as a view into the block
+    TsvReader tsv(fd, TSHARK_READ_BLOCK_SIZE);
+    std::vector<std::string_view> values;
 
     size_t no_pkts = 0;
     size_t early_stop_pkts = config["early_stop_pkts"].get<size_t>();
+    const size_t no_fields = map.getFields().size();
+    in_pkts.reset(map.getFields());  // column idx == field idx of map
 
-    // technical note: CSVParser supports inputstream read but there are two reasons not to use
-    // the function even though this approach may degrade its performance: Reason 1: CSVParser
-    // seems not to correctly read pstream, a inherited class of inputsteram. Reason 2: We need to
-    // implement early stop, so that line-by-line read is essential.
-    while (std::getline(in, line)) {
+    while (tsv.next(values)) {
       if (no_pkts >= early_stop_pkts) {  // if early_stop_pkts == -1, this early stop
                                          // function does not work.
         rangout(fmt::format("splitter: early_stopped {} in_pkts / {} in_pkts", no_pkts,
                             early_stop_pkts),
                 rang::fg::blue);
-        in.close();
         break;
       }
 
-      auto lines_csv = csv::parse(line, tshark_input_format);
-
-      // with very very high probability, lines_csv has only one element.
-      // So it is better not to optimize this code.
-      for (auto& row : lines_csv) {
-        nlohmann::json row_json;
-        for (auto& col_name : map.getFields()) {
-          row_json[col_name] = row[col_name].get<std::string>();
-        }
-        row_json["idx"] = no_pkts++;  // Warning: internal state!
-        in_pkts.push_back(row_json);
+      const size_t row_idx = in_pkts.addRow();  // row_idx == no_pkts
+      for (size_t col = 0; col < values.size() && col < no_fields; col++) {
+        in_pkts.set(row_idx, col, values[col]);
       }
-
+      no_pkts++;
 #ifndef NDEBUG
       if (no_pkts % 1000000 == 0)  // counter for debugging
         std::cout << "idx: " << no_pkts << std::endl;
 #endif
     }
 
+    if (tsv.bytesRead() == 0) {
+      if (allow_empty) return map;
+
+      // if tshark silently terminated
+      std::string error_msg = "reader: tshark is terminated. check error log";
+      if (config.contains("fpnt_tshark_error_log")) {
+        error_msg += " " + config["fpnt_tshark_error_log"].get<std::string>();
+      }
+
+      rangBerr(error_msg, rang::fg::red);
+      exit(1);
+    }
+
+    in_pkts.shrink_to_fit();
+#ifndef NDEBUG
+    std::cout << "packet table: " << in_pkts.size() << " rows, " << in_pkts.memory() << " bytes"
+              << std::endl;
+#endif
+
+    return map;
+  }
+
+  TSharkMapper& TSharkChunkReader::read(Loader* loader) {
+    if (loader != nullptr) {
+      std::cerr << "TSharkChunkReader::read: loader must not be used!" << std::endl;
+      exit(1);
+    }
+
+    size_t no_chunks = 1;
+    if (config.contains("tshark_chunks")) no_chunks = config["tshark_chunks"].get<size_t>();
+    // early stop decodes only the head of the file, so that splitting is meaningless
+    bool early_stop = (config["early_stop_pkts"].get<size_t>() != (size_t)-1);
+
+    // chunks are cut by byte offsets, which a compressed file does not have
+    std::vector<PcapChunk> chunks;
+    size_t header_size = 0;
+    if (no_chunks > 1 && !early_stop && !isCompressedCapture(in_filepath)) {
+      PcapFile pcap(in_filepath);
+      if (splitPcapFile(pcap, no_chunks, chunks)) {
+        header_size = pcap.header_size();
+      } else {
+        chunks.clear();
+      }
+    }
+
+    if (chunks.size() < 2) {
+      TSharkOutputReader reader_out_tshark(config, map, in_pkts, in_filepath, counter);
+      return reader_out_tshark.read();
+    }
+
+#ifndef NDEBUG
+    std::cout << "File " << in_filepath << " is split into " << chunks.size() << " chunks"
+              << std::endl;
+#endif
+
+    // each chunk is fed to tshark as a capture file: the file header followed by the records
+    std::vector<PacketTable> chunk_pkts(chunks.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < chunks.size(); i++) {
+      std::string input_cmd = fmt::format(
+          "{{ head -c {0} \"{3}\"; tail -c +{1} \"{3}\" | head -c {2}; }}", header_size,
+          chunks[i].offset + 1, chunks[i].size, in_filepath.c_str());
+      threads.emplace_back([this, i, input_cmd, &chunk_pkts]() {
+        TSharkOutputReader reader_out_tshark(config, map, chunk_pkts[i], in_filepath, counter,
+                                             input_cmd, true);
+        reader_out_tshark.read();
+      });
+    }
+    for (auto& thread : threads) thread.join();
+
+    // merge the chunks in order; frame.number of a chunk starts from 1
+    std::string frame_number_field = "frame.number";
+    in_pkts.reset(map.getFields());
+    for (size_t i = 0; i < chunks.size(); i++) {
+      size_t frame_number_col = chunk_pkts[i].col(frame_number_field);
+      if (frame_number_col != (size_t)-1 && chunks[i].first_frame > 1
+          && !chunk_pkts[i].offsetColumn(frame_number_col, chunks[i].first_frame - 1)) {
+        std::cerr << "TSharkChunkReader::read: tshark reported an invalid frame.number"
+                  << std::endl;
+        exit(1);
+      }
+      in_pkts.append(chunk_pkts[i]);
+    }
+    in_pkts.shrink_to_fit();
+
+    return map;
+  }
+
+  TSharkMapper& TSharkShardReader::read(Loader* loader) {
+    if (loader != nullptr) {
+      std::cerr << "TSharkShardReader::read: loader must not be used!" << std::endl;
+      exit(1);
+    }
+
+    std::string frame_number_field = "frame.number";
+    auto fields = map.getFields();
+    std::vector<size_t> shard_fields;  // field idxs except frame.number
+    for (size_t i = 0; i < fields.size(); i++) {
+      if (fields[i] != frame_number_field) shard_fields.push_back(i);
+    }
+
+    size_t no_shards = 1;
+    if (config.contains("tshark_field_shards"))
+      no_shards = config["tshark_field_shards"].get<size_t>();
+    no_shards = std::min(no_shards, shard_fields.size());
+
+    if (no_shards < 2) {
+      TSharkChunkReader reader_tshark(config, map, in_pkts, in_filepath, counter);
+      return reader_tshark.read();
+    }
+
+    // fields are assigned in their order, since fields of the same protocol are usually adjacent
+    // in input_tshark.csv and a tshark process then handles fewer protocols
+    std::vector<TSharkMapper> shard_maps(no_shards);
+    for (size_t k = 0; k < shard_fields.size(); k++) {
+      size_t i = shard_fields[k];
+      shard_maps[k * no_shards / shard_fields.size()].addField(
+          fields[i], map.getName(i), map.getDesc(i), map.getType(i), map.getVer(i));
+    }
+
+#ifndef NDEBUG
+    std::cout << "File " << in_filepath << " is decoded by " << no_shards << " field shards"
+              << std::endl;
+#endif
+
+    std::vector<PacketTable> shard_pkts(no_shards);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < no_shards; i++) {
+      shard_maps[i].addField(frame_number_field, frame_number_field);
+      threads.emplace_back([this, i, &shard_maps, &shard_pkts]() {
+        TSharkChunkReader reader_tshark(config, shard_maps[i], shard_pkts[i], in_filepath,
+                                        counter);
+        reader_tshark.read();
+      });
+    }
+    for (auto& thread : threads) thread.join();
+
+    in_pkts = std::move(shard_pkts[0]);
+    for (size_t i = 1; i < no_shards; i++) {
+      if (!in_pkts.join(shard_pkts[i], frame_number_field)) {
+        std::cerr << "TSharkShardReader::read: field shards of " << in_filepath
+                  << " have different packets!" << std::endl;
+        exit(1);
+      }
+    }
+
+    if (map[frame_number_field] == (size_t)-1) in_pkts.removeColumn(frame_number_field);
+    in_pkts.reorder(fields);  // column idx == field idx of map
+    in_pkts.shrink_to_fit();
+
+    return map;
+  }
+
+  TSharkMapper& NativePcapReader::read(Loader* loader) {
+    if (loader != nullptr) {
+      std::cerr << "NativePcapReader::read: loader must not be used!" << std::endl;
+      exit(1);
+    }
+
+    PcapFile pcap(in_filepath);
+    if (!pcap.is_open()) {  // unknown capture format; tshark decodes the whole file
+      TSharkShardReader reader_tshark(config, map, in_pkts, in_filepath, counter);
+      return reader_tshark.read();
+    }
+
+    // link-layer dependent fields can be decoded natively only for the supported linktypes
+    bool native_linktypes = true;
+    for (auto linktype : pcap.linktypes()) {
+      if (!isNativeLinkType(linktype)) native_linktypes = false;
+    }
+
+    auto fields = map.getFields();
+    std::vector<int> native_fields(fields.size(), NF_NONE);
+    TSharkMapper tshark_map;  // fields which should be decoded by tshark
+    for (size_t i = 0; i < fields.size(); i++) {
+      int native_field = getNativeField(fields[i]);
+      if (native_field != NF_NONE && (native_linktypes || isFrameField(native_field)))
+        native_fields[i] = native_field;
+      else
+        tshark_map.addField(fields[i], map.getName(i), map.getDesc(i), map.getType(i),
+                            map.getVer(i));
+    }
+
+    uint32_t layer_mask = 0;
+    bool native_filter = parseNativeDisplayFilter(
+        config["tshark_displayfilter"].get<std::string>(), layer_mask);
+
+    PcapRecord rec;
+    DecodedPkt pkt;
+    uint64_t frame_number = 0;
+    int64_t last_sec = 0;
+    uint32_t last_nsec = 0;
+    std::string value;
+
+    // move the cursor to the next record while keeping frame.number and the reference timestamps
+    auto next_record = [&]() -> bool {
+      if (!pcap.next(rec)) return false;
+      frame_number++;
+      if (frame_number == 1) {
+        pkt.first_sec = last_sec = rec.ts_sec;
+        pkt.first_nsec = last_nsec = rec.ts_nsec;
+      }
+      pkt.prev_sec = last_sec;
+      pkt.prev_nsec = last_nsec;
+      last_sec = rec.ts_sec;
+      last_nsec = rec.ts_nsec;
+      pkt.number = frame_number;
+      decodePkt(rec, pkt);
+      return true;
+    };
+
+    std::vector<size_t> native_cols(fields.size(), -1);  // column idx of in_pkts
+    auto fill_native_fields = [&](size_t row_idx) {
+      for (size_t i = 0; i < fields.size(); i++) {
+        if (native_fields[i] == NF_NONE) continue;
+        formatNativeField(pkt, native_fields[i], value);
+        in_pkts.set(row_idx, native_cols[i], value);
+      }
+    };
+
+    if (native_filter && tshark_map.getFields().empty()) {  // tshark is not needed
+#ifndef NDEBUG
+      std::cout << "File " << in_filepath << " is now being decoded natively..." << std::endl;
+#endif
+      size_t no_pkts = 0;
+      size_t early_stop_pkts = config["early_stop_pkts"].get<size_t>();
+      in_pkts.reset(fields);
+      for (size_t i = 0; i < fields.size(); i++) native_cols[i] = i;
+      while (next_record()) {
+        if (!matchNativeDisplayFilter(pkt, layer_mask)) continue;
+
+        if (no_pkts >= early_stop_pkts) {
+          rangout(fmt::format("splitter: early_stopped {} in_pkts / {} in_pkts", no_pkts,
+                              early_stop_pkts),
+                  rang::fg::blue);
+          break;
+        }
+
+        fill_native_fields(in_pkts.addRow());
+        no_pkts++;
+
+#ifndef NDEBUG
+        if (no_pkts % 1000000 == 0)  // counter for debugging
+          std::cout << "idx: " << no_pkts << std::endl;
+#endif
+      }
+      in_pkts.shrink_to_fit();
+      return map;
+    }
+
+    // tshark decodes the remaining fields (and applies the display filter); frame.number is
+    // required to join them with the natively decoded fields
+    std::string frame_number_field = "frame.number";
+    bool frame_number_requested = (map[frame_number_field] != (size_t)-1);
+    if (tshark_map[frame_number_field] == (size_t)-1)
+      tshark_map.addField(frame_number_field, frame_number_field);
+
+    TSharkShardReader reader_tshark(config, tshark_map, in_pkts, in_filepath, counter);
+    reader_tshark.read();
+
+    for (size_t i = 0; i < fields.size(); i++) {
+      if (native_fields[i] != NF_NONE) native_cols[i] = in_pkts.addColumn(fields[i]);
+    }
+    size_t frame_number_col = in_pkts.col(frame_number_field);
+
+    for (size_t row_idx = 0; row_idx < in_pkts.size(); row_idx++) {
+      int64_t target;
+      if (!in_pkts.getNum(row_idx, frame_number_col, target)) {
+        std::cerr << "NativePcapReader::read: tshark reported an invalid frame.number "
+                  << in_pkts.str(row_idx, frame_number_col) << std::endl;
+        exit(1);
+      }
+      while (frame_number < (uint64_t)target) {
+        if (!next_record()) {
+          std::cerr << "NativePcapReader::read: frame " << target << " reported by tshark is "
+                    << "not found in " << in_filepath << std::endl;
+          exit(1);
+        }
+      }
+
+      fill_native_fields(row_idx);
+    }
+
+    if (!frame_number_requested) in_pkts.removeColumn(frame_number_field);
+    in_pkts.reorder(fields);  // column idx == field idx of map
+    in_pkts.shrink_to_fit();
+
     return map;
   }
 
   std::string genTsharkCmd(const nlohmann::json config, TSharkMapper& in_map,
-                           std::filesystem::path& filepath, size_t cnt) {
+                           std::filesystem::path& filepath, size_t cnt,
+                           const std::string& input_cmd) {
+    // a compressed file is decompressed into the stdin of tshark
+    std::string pipe_cmd = (input_cmd != "") ? input_cmd : genDecompressCmd(filepath);
+
     std::string command = config["tshark_path"].get<std::string>();
+    if (pipe_cmd != "") command = pipe_cmd + " | " + command;
     command += " " + config["tshark_option"].get<std::string>();
     command += " -Y \"" + config["tshark_displayfilter"].get<std::string>() + "\"";
     command += " -T fields";
@@ -373,7 +702,10 @@ namespace fpnt {
     // for debugging purpose, vector is used instead of unordered_map
     for (const auto& field : in_map.getFields()) command += " -e \"" + field + "\"";
 
-    command += " -r \"" + std::string(filepath.c_str()) + "\"";
+    if (pipe_cmd != "")
+      command += " -r -";
+    else
+      command += " -r \"" + std::string(filepath.c_str()) + "\"";
 
     std::filesystem::path logfile;
     try {  // https://json.nlohmann.me/features/element_access/checked_access/#notes
@@ -0,0 +1,42 @@
+#include <fpnt/record_table.h>
+
+#include <iostream>
+
+namespace fpnt {
+
+  std::pair<uint32_t, bool> RecordTable::insert(const std::string& key) {
+    auto it = ids.find(key);
+    if (it != ids.end()) return {it->second, false};
+
+    if (records.size() >= NO_ID) {
+      std::cerr << "RecordTable: too many records!" << std::endl;
+      exit(1);
+    }
+    const uint32_t new_id = records.size();
+    keys.push_back(key);
+    ids.emplace(keys.back(), new_id);
+    records.emplace_back();
+    return {new_id, true};
+  }
+
+  uint32_t RecordTable::find(std::string_view key) const {
+    auto it = ids.find(key);
+    return it == ids.end() ? NO_ID : it->second;
+  }
+
+  uint32_t RecordTable::id(std::string_view key) const {
+    auto it = ids.find(key);
+    if (it == ids.end()) {
+      std::cerr << "RecordTable: unknown key " << key << "!" << std::endl;
+      exit(1);
+    }
+    return it->second;
+  }
+
+  void RecordTable::clear() {
+    ids.clear();
+    keys.clear();
+    std::vector<nlohmann::json>().swap(records);
+  }
+
+}  // namespace fpnt
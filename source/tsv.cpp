@@ -0,0 +1,163 @@
+#include <fpnt/tsv.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#  define FPNT_TSV_X86
+#endif
+
+namespace fpnt {
+
+  namespace {
+
+    constexpr size_t TSV_SCAN_WINDOW = 64 * 1024;  // bytes scanned per growth check of delims
+
+    // every scanner visits data[i, len) and stores absolute positions to out
+    typedef size_t (*fnptr_scan)(const char*, size_t, size_t, uint32_t*);
+
+    size_t scanScalar(const char* data, size_t i, size_t len, uint32_t* out) {
+      size_t n = 0;
+      for (; i < len; i++) {
+        if (data[i] == '\t' || data[i] == '\n') out[n++] = (uint32_t)i;
+      }
+      return n;
+    }
+
+#ifdef FPNT_TSV_X86
+    // emit the positions of the set bits of mask; base is the offset of bit 0
+    inline size_t emitMask(uint32_t mask, size_t base, uint32_t* out) {
+      size_t n = 0;
+      while (mask != 0) {
+        out[n++] = (uint32_t)(base + __builtin_ctz(mask));
+        mask &= mask - 1;
+      }
+      return n;
+    }
+
+    size_t scanSSE2(const char* data, size_t i, size_t len, uint32_t* out) {
+      const __m128i tab = _mm_set1_epi8('\t');
+      const __m128i nl = _mm_set1_epi8('\n');
+      size_t n = 0;
+      for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(chunk, tab), _mm_cmpeq_epi8(chunk, nl));
+        n += emitMask((uint32_t)_mm_movemask_epi8(hit), i, out + n);
+      }
+      return n + scanScalar(data, i, len, out + n);
+    }
+
+    __attribute__((target("avx2"))) size_t scanAVX2(const char* data, size_t i, size_t len,
+                                                    uint32_t* out) {
+      const __m256i tab = _mm256_set1_epi8('\t');
+      const __m256i nl = _mm256_set1_epi8('\n');
+      size_t n = 0;
+      for (; i + 32 <= len; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i hit
+            = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, tab), _mm256_cmpeq_epi8(chunk, nl));
+        n += emitMask((uint32_t)_mm256_movemask_epi8(hit), i, out + n);
+      }
+      return n + scanSSE2(data, i, len, out + n);
+    }
+#endif
+
+    struct Scanner {
+      fnptr_scan fn = scanScalar;
+      const char* name = "scalar";
+
+      Scanner() {
+#ifdef FPNT_TSV_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+          fn = scanAVX2;
+          name = "avx2";
+        } else if (__builtin_cpu_supports("sse2")) {
+          fn = scanSSE2;
+          name = "sse2";
+        }
+#endif
+      }
+    };
+
+    const Scanner& scanner() {
+      static const Scanner instance;
+      return instance;
+    }
+
+  }  // namespace
+
+  size_t scanTsvDelimiters(const char* data, size_t len, std::vector<uint32_t>& delims) {
+    // the data is scanned by windows, so that delims only needs room for the delimiters found so
+    // far and those of one window, instead of one position for every byte of the data
+    size_t n = 0;
+    for (size_t i = 0; i < len; i += TSV_SCAN_WINDOW) {
+      const size_t last = std::min(len, i + TSV_SCAN_WINDOW);
+      if (delims.size() < n + (last - i)) {
+        delims.resize(std::max(n + (last - i), delims.size() * 2));
+      }
+      n += scanner().fn(data, i, last, delims.data() + n);
+    }
+    return n;
+  }
+
+  const char* tsvScannerName() { return scanner().name; }
+
+  void TsvReader::fill() {
+    memmove(buf.data(), buf.data() + start, filled - start);
+    filled -= start;
+    start = 0;
+
+    ssize_t r;
+    do {
+      if (filled == buf.size()) buf.resize(buf.size() * 2);  // a line longer than the buffer
+      r = ::read(fd, buf.data() + filled, buf.size() - filled);
+    } while (r < 0 && errno == EINTR);
+    if (r < 0) {
+      std::cerr << "TsvReader: failed to read: " << strerror(errno) << std::endl;
+      exit(1);
+    }
+
+    if (r == 0) {  // the last line may not be terminated by a newline
+      eof = true;
+      if (filled > 0 && buf[filled - 1] != '\n') {
+        if (filled == buf.size()) buf.resize(buf.size() + 1);
+        buf[filled++] = '\n';
+      }
+    } else {
+      filled += r;
+      no_bytes += r;
+    }
+
+    no_complete = scanTsvDelimiters(buf.data(), filled, delims);
+    while (no_complete > 0 && buf[delims[no_complete - 1]] != '\n') no_complete--;
+    next_delim = 0;
+  }
+
+  bool TsvReader::next(std::vector<std::string_view>& fields) {
+    fields.clear();
+    while (true) {
+      while (next_delim < no_complete) {
+        const size_t pos = delims[next_delim++];
+        std::string_view value(buf.data() + start, pos - start);
+        start = pos + 1;
+        if (buf[pos] != '\n') {
+          fields.push_back(value);
+          continue;
+        }
+
+        if (!value.empty() && value.back() == '\r') value.remove_suffix(1);
+        if (fields.empty() && value.empty()) continue;  // an empty line is not a packet
+        fields.push_back(value);
+        return true;
+      }
+      if (eof) return false;
+      fill();  // every field of the previous lines has been returned
+    }
+  }
+
+}  // namespace fpnt
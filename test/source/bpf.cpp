@@ -0,0 +1,110 @@
+#include <doctest/doctest.h>
+#include <fpnt/bpf.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+  constexpr uint32_t LINKTYPE_ETHERNET = 1;
+
+  // tcpdump -ddd arp
+  const char* TCPDUMP_ARP = "4\n40 0 0 12\n21 0 1 2054\n6 0 0 262144\n6 0 0 0\n";
+
+  // tcpdump -ddd tcp port 80
+  const char* TCPDUMP_TCP_PORT_80
+      = "20\n40 0 0 12\n21 0 6 34525\n48 0 0 20\n21 0 15 6\n40 0 0 54\n21 12 0 80\n40 0 0 56\n"
+        "21 10 11 80\n21 0 10 2048\n48 0 0 23\n21 0 8 6\n40 0 0 20\n69 6 0 8191\n177 0 0 14\n"
+        "72 0 0 14\n21 2 0 80\n72 0 0 16\n21 0 1 80\n6 0 0 262144\n6 0 0 0\n";
+
+  void put16(std::vector<uint8_t>& pkt, size_t pos, uint16_t value) {
+    pkt[pos] = value >> 8;
+    pkt[pos + 1] = value & 0xff;
+  }
+
+  // an Ethernet frame with an IPv4 (or IPv6) header and the ports of a TCP or UDP header
+  std::vector<uint8_t> makePacket(bool ipv6, uint8_t proto, uint16_t sport, uint16_t dport,
+                                  uint16_t frag = 0) {
+    const size_t ip_len = ipv6 ? 40 : 20;
+    std::vector<uint8_t> pkt(14 + ip_len + 20, 0);
+    put16(pkt, 12, ipv6 ? 0x86dd : 0x0800);
+    if (ipv6) {
+      pkt[14] = 0x60;
+      pkt[14 + 6] = proto;
+    } else {
+      pkt[14] = 0x45;
+      put16(pkt, 14 + 6, frag);
+      pkt[14 + 9] = proto;
+    }
+    put16(pkt, 14 + ip_len, sport);
+    put16(pkt, 14 + ip_len + 2, dport);
+    return pkt;
+  }
+
+  bool match(const fpnt::BpfProgram& program, const std::vector<uint8_t>& pkt) {
+    return program.match(pkt.data(), pkt.size(), pkt.size());
+  }
+}  // namespace
+
+TEST_CASE("compileBpf reads tcpdump -ddd byte code") {
+  fpnt::BpfProgram program;
+  std::string error;
+  REQUIRE(fpnt::compileBpf(TCPDUMP_ARP, LINKTYPE_ETHERNET, program, error));
+  REQUIRE(program.size() == 4);
+  const auto& insns = program.getInsns();
+  CHECK(insns[0].code == 40);
+  CHECK(insns[0].k == 12);
+  CHECK(insns[1].code == 21);
+  CHECK(insns[1].jt == 0);
+  CHECK(insns[1].jf == 1);
+  CHECK(insns[1].k == 2054);
+  CHECK(insns[2].code == 6);
+  CHECK(insns[2].k == 262144);
+
+  // commas may separate the instructions as well
+  REQUIRE(fpnt::compileBpf("4,40 0 0 12,21 0 1 2054,6 0 0 262144,6 0 0 0", LINKTYPE_ETHERNET,
+                           program, error));
+  CHECK(program.size() == 4);
+}
+
+TEST_CASE("compileBpf rejects invalid byte code and filters") {
+  fpnt::BpfProgram program;
+  std::string error;
+  CHECK_FALSE(fpnt::compileBpf("1\n40 0 0 12\n", LINKTYPE_ETHERNET, program, error));  // no return
+  CHECK_FALSE(fpnt::compileBpf("2\n21 5 0 1\n6 0 0 0\n", LINKTYPE_ETHERNET, program, error));
+  CHECK(program.empty());
+
+  error.clear();
+  CHECK_FALSE(fpnt::compileBpf("tcp port", LINKTYPE_ETHERNET, program, error));
+  CHECK_FALSE(error.empty());
+}
+
+TEST_CASE("compileBpf agrees with tcpdump") {
+  std::string error;
+  fpnt::BpfProgram tcpdump_arp, compiled_arp, tcpdump_port, compiled_port;
+  REQUIRE(fpnt::compileBpf(TCPDUMP_ARP, LINKTYPE_ETHERNET, tcpdump_arp, error));
+  REQUIRE(fpnt::compileBpf("arp", LINKTYPE_ETHERNET, compiled_arp, error));
+  REQUIRE(fpnt::compileBpf(TCPDUMP_TCP_PORT_80, LINKTYPE_ETHERNET, tcpdump_port, error));
+  REQUIRE(fpnt::compileBpf("tcp port 80", LINKTYPE_ETHERNET, compiled_port, error));
+
+  std::vector<uint8_t> arp(42, 0);
+  put16(arp, 12, 0x0806);
+  const std::vector<std::pair<std::vector<uint8_t>, bool>> cases = {
+      {makePacket(false, 6, 80, 40000), true},
+      {makePacket(false, 6, 40000, 80), true},
+      {makePacket(false, 6, 40000, 443), false},
+      {makePacket(false, 17, 40000, 80), false},
+      {makePacket(true, 6, 40000, 80), true},
+      {makePacket(true, 17, 80, 40000), false},
+      {makePacket(false, 6, 40000, 80, 0x0010), false},  // not the first fragment
+      {makePacket(false, 6, 40000, 80, 0x2000), true},   // the first fragment
+      {arp, false},
+      {std::vector<uint8_t>(14, 0), false},  // truncated
+  };
+  for (const auto& [pkt, expected] : cases) {
+    CHECK(match(tcpdump_port, pkt) == expected);
+    CHECK(match(compiled_port, pkt) == expected);
+    CHECK(match(compiled_arp, pkt) == match(tcpdump_arp, pkt));
+  }
+  CHECK(match(compiled_arp, arp));
+}
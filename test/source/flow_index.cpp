@@ -0,0 +1,47 @@
+#include <doctest/doctest.h>
+#include <fpnt/flow_index.h>
+
+#include <cstdint>
+
+namespace {
+  fpnt::FlowTuple makeTuple(uint32_t i, bool ipv6 = false) {
+    fpnt::FlowTuple tuple;
+    tuple.clear();
+    memcpy(tuple.addr[0], &i, sizeof(i));
+    tuple.addr[1][0] = 10;
+    tuple.port[0] = i % 65536;
+    tuple.port[1] = 443;
+    tuple.proto = 6;
+    tuple.flags = fpnt::FlowTuple::PROTO | (ipv6 ? fpnt::FlowTuple::IPV6 : 0);
+    return tuple;
+  }
+}  // namespace
+
+TEST_CASE("FlowIndex finds the inserted tuples") {
+  fpnt::FlowIndex index;
+  CHECK(index.find(makeTuple(0)) == (size_t)-1);  // no slot yet
+
+  index.insert(makeTuple(1), 7);
+  CHECK(index.size() == 1);
+  CHECK(index.find(makeTuple(1)) == 7);
+  CHECK(index.find(makeTuple(2)) == (size_t)-1);
+  CHECK(index.find(makeTuple(1, true)) == (size_t)-1);  // the flags are a part of the key
+}
+
+TEST_CASE("FlowIndex keeps every entry when it grows") {
+  fpnt::FlowIndex index;
+  const uint32_t no_tuples = 100000;  // several times the initial slots
+  for (uint32_t i = 0; i < no_tuples; i++) index.insert(makeTuple(i), i * 2);
+  REQUIRE(index.size() == no_tuples);
+
+  size_t found = 0;
+  for (uint32_t i = 0; i < no_tuples; i++) found += index.find(makeTuple(i)) == i * 2;
+  CHECK(found == no_tuples);
+  CHECK(index.find(makeTuple(no_tuples)) == (size_t)-1);
+
+  index.clear();
+  CHECK(index.size() == 0);
+  CHECK(index.find(makeTuple(1)) == (size_t)-1);
+  index.insert(makeTuple(1), 3);
+  CHECK(index.find(makeTuple(1)) == 3);
+}
@@ -0,0 +1,56 @@
+#include <doctest/doctest.h>
+#include <fpnt/hierarchy.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+  std::vector<uint32_t> toVector(std::span<const uint32_t> ids) {
+    return std::vector<uint32_t>(ids.begin(), ids.end());
+  }
+
+  // pkt (0) -> flow (1) -> flowset (2): six packets, three flows and two flowsets
+  fpnt::Hierarchy makeHierarchy() {
+    fpnt::Hierarchy hierarchy;
+    hierarchy.reset(3);
+    for (uint32_t flow : {0, 1, 0, 2, 1, 0}) hierarchy.addRecord(0, flow);
+    for (uint32_t flowset : {0, 1, 0}) hierarchy.addRecord(1, flowset);
+    for (int i = 0; i < 2; i++) hierarchy.addRecord(2, 0);
+    hierarchy.build();
+    return hierarchy;
+  }
+}  // namespace
+
+TEST_CASE("Hierarchy finds the ancestors of a record") {
+  const fpnt::Hierarchy hierarchy = makeHierarchy();
+  CHECK(hierarchy.ancestor(0, 0, 4) == 4);
+  CHECK(hierarchy.ancestor(0, 1, 3) == 2);
+  CHECK(hierarchy.ancestor(0, 1, 4) == 1);
+  CHECK(hierarchy.ancestor(0, 2, 3) == 0);
+  CHECK(hierarchy.ancestor(0, 2, 4) == 1);
+  CHECK(hierarchy.ancestor(1, 2, 2) == 0);
+}
+
+TEST_CASE("Hierarchy spans the descendants of a record") {
+  const fpnt::Hierarchy hierarchy = makeHierarchy();
+  CHECK(toVector(hierarchy.descendants(1, 0, 0)) == std::vector<uint32_t>{0, 2, 5});
+  CHECK(toVector(hierarchy.descendants(1, 0, 1)) == std::vector<uint32_t>{1, 4});
+  CHECK(toVector(hierarchy.descendants(1, 0, 2)) == std::vector<uint32_t>{3});
+  CHECK(toVector(hierarchy.descendants(2, 1, 0)) == std::vector<uint32_t>{0, 2});
+
+  // ordered by the children, then by ID
+  CHECK(toVector(hierarchy.descendants(2, 0, 0)) == std::vector<uint32_t>{0, 2, 5, 3});
+  CHECK(toVector(hierarchy.descendants(2, 0, 1)) == std::vector<uint32_t>{1, 4});
+}
+
+TEST_CASE("Hierarchy handles a record without descendants") {
+  fpnt::Hierarchy hierarchy;
+  hierarchy.reset(2);
+  hierarchy.addRecord(0, 1);
+  hierarchy.addRecord(1, 0);
+  hierarchy.addRecord(1, 0);
+  hierarchy.build();
+  CHECK(hierarchy.descendants(1, 0, 0).empty());
+  CHECK(toVector(hierarchy.descendants(1, 0, 1)) == std::vector<uint32_t>{0});
+  CHECK(hierarchy.ancestor(0, 1, 0) == 1);
+}
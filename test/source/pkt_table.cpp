@@ -0,0 +1,161 @@
+#include <doctest/doctest.h>
+#include <fpnt/pkt_cache.h>
+#include <fpnt/pkt_table.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+  // frame.number, a numeric column, a string column (demoted by "0x1f") and a sparse column
+  fpnt::PacketTable makeTable(size_t rows) {
+    fpnt::PacketTable table;
+    table.reset({"frame.number", "ip.len", "tcp.flags", "http.host"});
+    for (size_t i = 0; i < rows; i++) {
+      const size_t row = table.addRow();
+      table.set(row, 0, std::to_string(i + 1));
+      table.set(row, 1, std::to_string(40 + i % 1460));
+      table.set(row, 2, i % 7 == 0 ? "0x1f" : std::to_string(i % 64));
+      if (i % 3 == 0) table.set(row, 3, "host" + std::to_string(i % 10) + ".example");
+    }
+    return table;
+  }
+
+  void checkEqual(const fpnt::PacketTable& a, const fpnt::PacketTable& b) {
+    REQUIRE(a.size() == b.size());
+    REQUIRE(a.getFields() == b.getFields());
+    for (size_t col = 0; col < a.getFields().size(); col++) {
+      CHECK(a.isNumeric(col) == b.isNumeric(col));
+      for (size_t row = 0; row < a.size(); row++) CHECK(a.str(row, col) == b.str(row, col));
+    }
+  }
+}  // namespace
+
+TEST_CASE("PacketTable demotes a column with a non-canonical integer") {
+  fpnt::PacketTable table = makeTable(10);
+  CHECK(table.isNumeric(0));
+  CHECK(table.isNumeric(1));
+  CHECK_FALSE(table.isNumeric(2));
+  CHECK(table.str(0, 2) == "0x1f");
+  CHECK(table.str(1, 2) == "1");
+  CHECK(table.str(1, 3) == "");
+  CHECK(table.str(0, "absent") == "");
+}
+
+TEST_CASE("PacketTable keeps numeric cells as integers") {
+  fpnt::PacketTable table = makeTable(10);
+  int64_t num = 0;
+  REQUIRE(table.getNum(3, 1, num));
+  CHECK(num == 43);
+  CHECK_FALSE(table.getNum(3, 2, num));  // a string column
+
+  table.set(4, 1, "");
+  CHECK_FALSE(table.getNum(4, 1, num));  // an empty cell
+  std::string buf;
+  CHECK(table.view(4, 1, buf).empty());
+  CHECK(table.view(5, 1, buf) == "45");
+}
+
+TEST_CASE("PacketTable serialize and deserialize round-trip") {
+  const fpnt::PacketTable table = makeTable(5000);
+  std::stringstream image;
+  table.serialize(image);
+  const std::string bytes = image.str();
+
+  fpnt::PacketTable loaded;
+  std::istringstream is(bytes);
+  REQUIRE(loaded.deserialize(is, bytes.size()));
+  checkEqual(table, loaded);
+
+  fpnt::PacketTable empty, loaded_empty;
+  std::stringstream empty_image;
+  empty.serialize(empty_image);
+  const std::string empty_bytes = empty_image.str();
+  std::istringstream empty_is(empty_bytes);
+  REQUIRE(loaded_empty.deserialize(empty_is, empty_bytes.size()));
+  CHECK(loaded_empty.empty());
+
+  // a truncated image and a wrong length are malformed
+  std::istringstream truncated(bytes.substr(0, bytes.size() - 1));
+  CHECK_FALSE(loaded.deserialize(truncated, bytes.size() - 1));
+  std::istringstream longer(bytes + "x");
+  CHECK_FALSE(loaded.deserialize(longer, bytes.size() + 1));
+}
+
+TEST_CASE("PacketCache loads a saved table only with the same key") {
+  const auto cache_dir = std::filesystem::temp_directory_path() / "fpnt_test_pkt_cache";
+  std::filesystem::remove_all(cache_dir);
+  nlohmann::json config;
+  config["decode_cache_path"] = cache_dir.string();
+  const fpnt::PacketCache cache(config, "tshark 4.2.0");
+  REQUIRE(cache.enabled());
+
+  const auto capture = std::filesystem::temp_directory_path() / "fpnt_test_capture.pcap";
+  std::ofstream(capture) << "capture";
+
+  const fpnt::PacketTable table = makeTable(2000);
+  const std::string key = cache.genKey(capture);
+  fpnt::PacketTable loaded;
+  CHECK_FALSE(cache.load(key, loaded));  // a miss
+  cache.save(key, table);
+  REQUIRE(cache.load(key, loaded));
+  checkEqual(table, loaded);
+
+  // another tshark version is another key
+  const fpnt::PacketCache other(config, "tshark 4.4.0");
+  CHECK_FALSE(other.load(other.genKey(capture), loaded));
+
+  // a truncated file is a miss
+  const auto path = cache.getPath(key);
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+  CHECK_FALSE(cache.load(key, loaded));
+
+  std::filesystem::remove_all(cache_dir);
+  std::filesystem::remove(capture);
+}
+
+TEST_CASE("PacketTable join adds the missing columns of the same rows") {
+  fpnt::PacketTable table = makeTable(1000);
+  table.project({"frame.number", "ip.len"});
+
+  fpnt::PacketTable other = makeTable(1000);
+  other.project({"frame.number", "http.host", "tcp.flags"});
+  REQUIRE(table.join(other, "frame.number"));
+  CHECK(other.empty());
+
+  const fpnt::PacketTable expected = makeTable(1000);
+  REQUIRE(table.getFields()
+          == std::vector<std::string>{"frame.number", "ip.len", "http.host", "tcp.flags"});
+  for (size_t row = 0; row < table.size(); row++) {
+    CHECK(table.str(row, "ip.len") == expected.str(row, "ip.len"));
+    CHECK(table.str(row, "http.host") == expected.str(row, "http.host"));
+    CHECK(table.str(row, "tcp.flags") == expected.str(row, "tcp.flags"));
+  }
+
+  // the rows must be the same
+  fpnt::PacketTable shorter = makeTable(999);
+  CHECK_FALSE(table.join(shorter, "frame.number"));
+  fpnt::PacketTable no_key = makeTable(1000);
+  CHECK_FALSE(table.join(no_key, "absent"));
+}
+
+TEST_CASE("PacketTable project reorders and drops columns") {
+  fpnt::PacketTable table = makeTable(3000);
+  const fpnt::PacketTable expected = makeTable(3000);
+
+  table.reorder({"http.host", "tcp.flags", "ip.len", "frame.number"});
+  CHECK(table.col("http.host") == 0);
+  CHECK(table.str(0, 0) == expected.str(0, "http.host"));
+
+  const size_t before = table.memory();
+  table.project({"tcp.flags", "frame.number"});
+  REQUIRE(table.getFields() == std::vector<std::string>{"tcp.flags", "frame.number"});
+  CHECK(table.col("http.host") == (size_t)-1);
+  CHECK(table.memory() < before);  // the strings of http.host are dropped from the arena
+  for (size_t row = 0; row < table.size(); row++) {
+    CHECK(table.str(row, 0) == expected.str(row, "tcp.flags"));
+    CHECK(table.str(row, 1) == expected.str(row, "frame.number"));
+  }
+}
@@ -0,0 +1,188 @@
+#include <doctest/doctest.h>
+#include <fpnt/plan.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// the plugin library built with the tests (see test/CMakeLists.txt)
+#ifdef FPNT_PLUGINS_PATH
+
+namespace {
+  const std::vector<std::string> G_LVS = {"pkt", "flow", "flowset"};
+
+  struct Column {
+    std::string field, fn, option;
+  };
+
+  // out_maps with the given columns of each granularity, as read from output_<granularity>.csv
+  std::unordered_map<std::string, fpnt::Mapper> makeMaps(
+      const std::unordered_map<std::string, std::vector<Column>>& columns) {
+    std::unordered_map<std::string, fpnt::Mapper> out_maps;
+    for (auto& granularity : G_LVS) {
+      fpnt::Mapper& map = out_maps[granularity];
+      auto it = columns.find(granularity);
+      if (it == columns.end()) continue;
+      for (auto& column : it->second) {
+        map.addField(column.field, column.field);
+        map.setPrepFns(column.field, column.fn, column.option);
+      }
+    }
+    return out_maps;
+  }
+
+  nlohmann::json makeConfig() {
+    nlohmann::json config;
+    config["genKey_pkt"] = "genKey_pkt_default";
+    config["genKey_flow"] = "genKey_flow_default";
+    config["genKey_flowset"] = "genKey_flowset_default";
+    return config;
+  }
+}  // namespace
+
+TEST_CASE("ExecutionPlan resolves the functions and options of every column") {
+  fpnt::Loader loader(FPNT_PLUGINS_PATH);
+  auto out_maps = makeMaps({
+      {"pkt", {{"a", "P_fillOpt", "1"}, {"b", "P_fillOpt;P_cpy", "2;a"}}},
+      {"flow", {{"f", "P_fillOpt", "3"}}},
+  });
+  fpnt::ExecutionPlan plan;
+  plan.build(G_LVS, out_maps, loader, makeConfig());
+
+  REQUIRE(plan.size() == 3);
+  const fpnt::GranularityPlan& pkt = plan["pkt"];
+  CHECK(pkt.level == 0);
+  CHECK(pkt.genKey != nullptr);
+  REQUIRE(pkt.columns.size() == 2);
+  std::string field = "b";
+  CHECK(pkt.columns[0].field == "a");
+  CHECK(pkt.columns[1].slot == out_maps["pkt"][field]);
+  CHECK(pkt.columns[0].type == fpnt::ValueType::TEXT);
+
+  // the steps of a column keep the order of preprocess_fns with their options
+  const std::vector<fpnt::PlanStep>& steps = pkt.columns[1].steps;
+  REQUIRE(steps.size() == 2);
+  CHECK(steps[0].name == "P_fillOpt");
+  CHECK(steps[0].option == "2");
+  CHECK(steps[0].fn != nullptr);
+  CHECK(steps[1].name == "P_cpy");
+  CHECK(steps[1].option == "a");
+  CHECK(steps[1].fn != nullptr);
+  CHECK(steps[1].threadsafe);
+  CHECK(pkt.threadsafe);
+
+  CHECK(plan["flow"].columns.size() == 1);
+  CHECK(plan["flowset"].columns.empty());
+}
+
+TEST_CASE("ExecutionPlan orders the columns by their references") {
+  fpnt::Loader loader(FPNT_PLUGINS_PATH);
+  auto out_maps = makeMaps({
+      {"pkt", {{"x", "P_max_d", "y"}, {"y", "P_fillOpt", "1"}, {"z", "P_fillOpt", "3"}}},
+      {"flow", {{"f", "P_fillOpt", "4"}}},
+      {"flowset", {{"s", "P_iat_cbseq", "f"}}},
+  });
+  fpnt::ExecutionPlan plan;
+  plan.build(G_LVS, out_maps, loader, makeConfig());
+
+  // x reads y, which is computed first; z keeps its position
+  CHECK(plan["pkt"].order == std::vector<size_t>{1, 0, 2});
+  CHECK(plan["flow"].order == std::vector<size_t>{0});
+  CHECK(plan["flowset"].order == std::vector<size_t>{0});
+  CHECK(plan["pkt"].threadsafe);
+  CHECK_FALSE(plan["pkt"].opaque);
+
+  // pkt and flow do not read each other; flowset reads flow
+  REQUIRE(plan.getWaves().size() == 2);
+  CHECK(plan.getWaves()[0] == std::vector<size_t>{0, 1});
+  CHECK(plan.getWaves()[1] == std::vector<size_t>{2});
+}
+
+TEST_CASE("ExecutionPlan computes only the columns needed by the written granularities") {
+  fpnt::Loader loader(FPNT_PLUGINS_PATH);
+  auto out_maps = makeMaps({
+      {"pkt", {{"p", "P_fillOpt", "1"}}},
+      {"flow", {{"f", "P_fillOpt", "2"}, {"g", "P_fillOpt", "3"}}},
+      {"flowset", {{"s", "P_iat_cbseq", "f"}}},
+  });
+  nlohmann::json config = makeConfig();
+  config["output_granularities"] = "flowset";
+  fpnt::ExecutionPlan plan;
+  plan.build(G_LVS, out_maps, loader, config);
+
+  CHECK(plan["pkt"].order.empty());
+  CHECK(plan["flow"].order == std::vector<size_t>{0});
+  CHECK_FALSE(plan["flow"].written);
+  REQUIRE(plan.getWaves().size() == 2);
+  CHECK(plan.getWaves()[0] == std::vector<size_t>{1});
+  CHECK(plan.getWaves()[1] == std::vector<size_t>{2});
+
+  // an empty list writes every granularity, as without the key
+  config["output_granularities"] = "";
+  plan.build(G_LVS, out_maps, loader, config);
+  CHECK(plan["pkt"].written);
+  CHECK(plan["pkt"].order == std::vector<size_t>{0});
+  CHECK(plan["flow"].order == std::vector<size_t>{0, 1});
+}
+
+TEST_CASE("ExecutionPlan batches only the runs of batch columns with an opaque column") {
+  fpnt::Loader loader(FPNT_PLUGINS_PATH);
+  auto out_maps = makeMaps({
+      {"pkt", {{"a", "P_fillOpt", "1"}, {"b", "P_cpy", "a"}, {"c", "P_cpy", "b"}}},
+      {"flow",
+       {{"a", "P_fillOpt", "1"},
+        {"b", "P_cpy", "a"},
+        {"c", "P_cpy", "b"},
+        {"d", "P_debug", ""},
+        {"e", "P_cpy", "a"}}},
+  });
+  fpnt::ExecutionPlan plan;
+  plan.build(G_LVS, out_maps, loader, makeConfig());
+
+  // without an opaque column, the granularity is a single batched run
+  const fpnt::GranularityPlan& pkt = plan["pkt"];
+  CHECK(pkt.batched);
+  REQUIRE(pkt.runs.size() == 1);
+  CHECK(pkt.runs[0].begin == 0);
+  CHECK(pkt.runs[0].end == 3);
+  CHECK(pkt.runs[0].batched);
+
+  // d is opaque; b and c, and e are batched, the others are processed record by record
+  const fpnt::GranularityPlan& flow = plan["flow"];
+  CHECK(flow.opaque);
+  CHECK(flow.batched);
+  REQUIRE(flow.runs.size() == 4);
+  const std::vector<std::pair<size_t, size_t>> bounds = {{0, 1}, {1, 3}, {3, 4}, {4, 5}};
+  for (size_t r = 0; r < bounds.size(); r++) {
+    CHECK(flow.runs[r].begin == bounds[r].first);
+    CHECK(flow.runs[r].end == bounds[r].second);
+    CHECK(flow.runs[r].batched == (r % 2 == 1));
+  }
+
+  CHECK_FALSE(plan["flowset"].batched);
+  CHECK(plan["flowset"].runs.empty());
+}
+
+TEST_CASE("ExecutionPlan stops at a cyclic field reference") {
+  // the plan exits, so it is built in a child process; the child flushes the buffered output of
+  // the parent when it exits, so the output is flushed first
+  std::fflush(nullptr);
+  const pid_t pid = fork();
+  REQUIRE(pid >= 0);
+  if (pid == 0) {
+    fpnt::Loader loader(FPNT_PLUGINS_PATH);
+    auto out_maps = makeMaps({{"pkt", {{"x", "P_max_d", "y"}, {"y", "P_min_d", "x"}}}});
+    fpnt::ExecutionPlan plan;
+    plan.build(G_LVS, out_maps, loader, makeConfig());
+    _exit(0);
+  }
+  int status = 0;
+  REQUIRE(waitpid(pid, &status, 0) == pid);
+  CHECK(WIFEXITED(status));
+  CHECK(WEXITSTATUS(status) == 1);
+}
+
+#endif
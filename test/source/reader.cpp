@@ -0,0 +1,82 @@
+#include <doctest/doctest.h>
+#include <fpnt/reader.h>
+
+#include <string>
+#include <vector>
+
+// the capture files of the tests (see test/CMakeLists.txt)
+#ifdef FPNT_TEST_DATA_DIR
+
+namespace {
+  // native.pcap (Ethernet, microseconds) has four frames:
+  //   1. 1000.000000 IPv4 TCP 192.168.0.1:12345 -> 10.0.0.2:80 with 4 bytes of payload
+  //   2. 1000.250000 VLAN 100, IPv4 UDP 10.0.0.2:53 -> 192.168.0.1:5353 with 3 bytes of payload
+  //   3. 1001.000000 IPv6 TCP [2001:db8::1]:443 -> [2001:db8::2]:50000 without payload
+  //   4. 1001.500000 ARP request
+  const std::string NATIVE_PCAP = std::string(FPNT_TEST_DATA_DIR) + "/native.pcap";
+
+  fpnt::TSharkMapper makeMap(const std::vector<std::string>& fields) {
+    fpnt::TSharkMapper map;
+    for (auto& field : fields) map.addField(field, field);
+    return map;
+  }
+
+  nlohmann::json makeConfig(const std::string& displayfilter) {
+    nlohmann::json config;
+    config["tshark_displayfilter"] = displayfilter;
+    config["early_stop_pkts"] = -1;
+    return config;
+  }
+
+  // the column of field as strings
+  std::vector<std::string> column(const fpnt::PacketTable& table, const std::string& field) {
+    std::vector<std::string> values;
+    for (size_t row = 0; row < table.size(); row++) values.push_back(table.str(row, field));
+    return values;
+  }
+}  // namespace
+
+TEST_CASE("NativePcapReader decodes the frame, link, network and transport fields") {
+  const std::vector<std::string> fields
+      = {"frame.number", "frame.time_relative", "frame.len", "eth.type", "vlan.id",
+         "ip.src",       "ip.ttl",              "ipv6.dst",  "tcp.srcport", "tcp.len",
+         "udp.dstport",  "udp.length",          "_ws.col.def_src"};
+  fpnt::TSharkMapper map = makeMap(fields);
+  fpnt::PacketTable in_pkts;
+  fpnt::NativePcapReader reader(makeConfig(""), map, in_pkts, NATIVE_PCAP, 0);
+  reader.read();
+
+  REQUIRE(in_pkts.size() == 4);
+  REQUIRE(in_pkts.getFields() == fields);
+  CHECK(column(in_pkts, "frame.number") == std::vector<std::string>{"1", "2", "3", "4"});
+  CHECK(column(in_pkts, "frame.time_relative")
+        == std::vector<std::string>{"0.000000000", "0.250000000", "1.000000000", "1.500000000"});
+  CHECK(column(in_pkts, "frame.len") == std::vector<std::string>{"58", "49", "74", "42"});
+  CHECK(column(in_pkts, "eth.type")
+        == std::vector<std::string>{"0x0800", "0x8100", "0x86dd", "0x0806"});
+  CHECK(column(in_pkts, "vlan.id") == std::vector<std::string>{"", "100", "", ""});
+  CHECK(column(in_pkts, "ip.src") == std::vector<std::string>{"192.168.0.1", "10.0.0.2", "", ""});
+  CHECK(column(in_pkts, "ip.ttl") == std::vector<std::string>{"64", "128", "", ""});
+  CHECK(column(in_pkts, "ipv6.dst") == std::vector<std::string>{"", "", "2001:db8::2", ""});
+  CHECK(column(in_pkts, "tcp.srcport") == std::vector<std::string>{"12345", "", "443", ""});
+  CHECK(column(in_pkts, "tcp.len") == std::vector<std::string>{"4", "", "0", ""});
+  CHECK(column(in_pkts, "udp.dstport") == std::vector<std::string>{"", "5353", "", ""});
+  CHECK(column(in_pkts, "udp.length") == std::vector<std::string>{"", "11", "", ""});
+  CHECK(column(in_pkts, "_ws.col.def_src")
+        == std::vector<std::string>{"192.168.0.1", "10.0.0.2", "2001:db8::1",
+                                    "02:00:00:00:00:01"});
+}
+
+TEST_CASE("NativePcapReader applies a protocol display filter") {
+  fpnt::TSharkMapper map = makeMap({"frame.number", "tcp.dstport", "udp.srcport"});
+  fpnt::PacketTable in_pkts;
+  fpnt::NativePcapReader reader(makeConfig("tcp || udp"), map, in_pkts, NATIVE_PCAP, 0);
+  reader.read();
+
+  // the ARP frame is dropped, and frame.number keeps the numbers of the capture file
+  CHECK(column(in_pkts, "frame.number") == std::vector<std::string>{"1", "2", "3"});
+  CHECK(column(in_pkts, "tcp.dstport") == std::vector<std::string>{"80", "", "50000"});
+  CHECK(column(in_pkts, "udp.srcport") == std::vector<std::string>{"", "53", ""});
+}
+
+#endif
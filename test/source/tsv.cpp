@@ -0,0 +1,80 @@
+#include <doctest/doctest.h>
+#include <fpnt/tsv.h>
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+  std::vector<uint32_t> scanNaive(const std::string& data) {
+    std::vector<uint32_t> result;
+    for (size_t i = 0; i < data.size(); i++) {
+      if (data[i] == '\t' || data[i] == '\n') result.push_back(i);
+    }
+    return result;
+  }
+
+  // every line read by TsvReader from data with the given block size
+  std::vector<std::vector<std::string>> readAll(const std::string& data, size_t block_size) {
+    FILE* file = tmpfile();
+    REQUIRE(file != nullptr);
+    REQUIRE(fwrite(data.data(), 1, data.size(), file) == data.size());
+    fflush(file);
+    rewind(file);
+
+    fpnt::TsvReader reader(fileno(file), block_size);
+    std::vector<std::string_view> fields;
+    std::vector<std::vector<std::string>> lines;
+    while (reader.next(fields)) lines.emplace_back(fields.begin(), fields.end());
+    CHECK(reader.bytesRead() == data.size());
+    fclose(file);
+    return lines;
+  }
+}  // namespace
+
+TEST_CASE("scanTsvDelimiters finds every tab and newline") {
+  std::mt19937 rng(7);
+  const char alphabet[] = {'a', '\t', '\n', '"', '\\', '\r', ',', 'z'};
+  // lengths around the vector widths and across several scan windows
+  for (size_t len : {0, 1, 15, 16, 17, 31, 32, 33, 1000, 64 * 1024 + 5, 200000}) {
+    std::string data(len, 'x');
+    for (auto& c : data) c = alphabet[rng() % sizeof(alphabet)];
+
+    std::vector<uint32_t> delims;
+    const size_t n = fpnt::scanTsvDelimiters(data.data(), data.size(), delims);
+    delims.resize(n);
+    CHECK(delims == scanNaive(data));
+  }
+}
+
+TEST_CASE("TsvReader keeps quotes and escapes and drops CR before a newline") {
+  const std::string data
+      = "1\t\"quoted\"\tC:\\\\dir\r\n"
+        "2\t\"a,b\"\tline\\nbreak\\ttab\r\n"
+        "\n"
+        "3\t\t\"\r\n"
+        "4\tlast";  // without a newline
+  const std::vector<std::vector<std::string>> expected = {
+      {"1", "\"quoted\"", "C:\\\\dir"},
+      {"2", "\"a,b\"", "line\\nbreak\\ttab"},
+      {"3", "", "\""},
+      {"4", "last"},
+  };
+  for (size_t block_size : {1, 2, 3, 7, 16, 1 << 20}) CHECK(readAll(data, block_size) == expected);
+}
+
+TEST_CASE("TsvReader reads fields across block boundaries") {
+  std::string data;
+  std::vector<std::vector<std::string>> expected;
+  for (size_t i = 0; i < 3000; i++) {
+    std::vector<std::string> line
+        = {std::to_string(i), std::string(i % 97, 'v'), "0x" + std::to_string(i)};
+    data += line[0] + "\t" + line[1] + "\t" + line[2] + (i % 2 ? "\n" : "\r\n");
+    expected.push_back(std::move(line));
+  }
+  for (size_t block_size : {5, 64, 4096, 4099}) CHECK(readAll(data, block_size) == expected);
+
+  CHECK(readAll("", 16).empty());
+  CHECK(readAll("\n\r\n", 16).empty());  // empty lines
+}